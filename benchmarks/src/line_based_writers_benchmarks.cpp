@@ -1,15 +1,293 @@
 #include <benchmark/benchmark.h>
-#include <sstream>
+#include "line_based_writers.h"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
 
-static void BM_BenchMark(benchmark::State& state) {
-    // Perform setup here
-    std::stringstream ss;
+namespace lbw = crosscode::line_based_writers;
+namespace fs = std::filesystem;
+
+namespace {
+
+    /// bench_dir is the directory the file benchmarks write to. It is created on a tmpfs (/dev/shm) when available, so
+    /// the benchmarks measure the writers and not the disk. Set LINE_BASED_WRITERS_BENCHMARK_DIR to use another
+    /// directory. The directory is removed when the benchmarks finish.
+    class bench_dir {
+        fs::path path_;
+    public:
+        bench_dir() {
+            fs::path base = fs::exists("/dev/shm") ? fs::path{"/dev/shm"} : fs::temp_directory_path();
+            if (auto env = std::getenv("LINE_BASED_WRITERS_BENCHMARK_DIR")) {
+                base = env;
+            }
+            path_ = base / ("line_based_writers_benchmarks-" + std::to_string(std::random_device{}()));
+            fs::create_directories(path_);
+        }
+        bench_dir(const bench_dir&) = delete;
+        bench_dir& operator=(const bench_dir&) = delete;
+
+        ~bench_dir() {
+            std::error_code ec;
+            fs::remove_all(path_, ec);
+        }
+
+        /// file returns the path of a file in the benchmark directory.
+        [[nodiscard]] std::string file(const std::string& name) const {
+            return (path_ / name).string();
+        }
+    };
+
+    const bench_dir& directory() {
+        static bench_dir dir;
+        return dir;
+    }
+
+    /// null_sink is a line based iterator sink that only counts lines. It is used to measure the overhead of the line
+    /// buffers without I/O.
+    struct null_sink {
+        std::size_t lines_{};
+
+        template<typename Iter>
+        void write(Iter b, Iter e) {
+            for (; b != e; ++b) {
+                benchmark::DoNotOptimize(*b);
+                lines_++;
+            }
+        }
+    };
+
+    std::string make_line(std::int64_t length) {
+        std::string line(static_cast<std::size_t>(length), 'x');
+        if (!line.empty()) line.front() = 'm';
+        return line;
+    }
+
+    /// report adds the lines/s and bytes/s counters. Each iteration writes group lines; bytes include the line
+    /// separator. For multi threaded benchmarks the counters of all threads are summed.
+    void report(benchmark::State& state, std::size_t line_length, std::size_t group = 1) {
+        auto lines = static_cast<double>(state.iterations()) * static_cast<double>(group);
+        state.counters["lines/s"] = benchmark::Counter(lines, benchmark::Counter::kIsRate);
+        state.counters["bytes/s"] = benchmark::Counter(lines * static_cast<double>(line_length + 1), benchmark::Counter::kIsRate, benchmark::Counter::kIs1024);
+    }
+
+    int max_threads() {
+        return static_cast<int>(std::max(2u, std::thread::hardware_concurrency()));
+    }
+
+    void line_length_args(benchmark::internal::Benchmark* b) {
+        b->ArgName("line");
+        for (auto line : {16, 128, 1024}) {
+            b->Arg(line);
+        }
+    }
+
+    void line_length_and_batch_args(benchmark::internal::Benchmark* b) {
+        b->ArgNames({"line", "batch"});
+        for (auto line : {16, 128, 1024}) {
+            for (auto batch : {100, 1000, 10000}) {
+                b->Args({line, batch});
+            }
+        }
+    }
+
+    /// threaded_args uses a single line length and batch size, the thread count is the parameter.
+    void threaded_args(benchmark::internal::Benchmark* b) {
+        b->ArgNames({"line", "batch"})->Args({128, 1000})->ThreadRange(1, max_threads())->UseRealTime();
+    }
+
+}
+
+/// stream_writer writing to a file on tmpfs. The file is rewound periodically to bound its size.
+static void BM_stream_writer(benchmark::State& state) {
+    auto line = make_line(state.range(0));
+    lbw::stream_writer<std::ofstream> writer{directory().file("stream_writer.txt"), std::ios::trunc | std::ios::binary};
+    std::size_t lines{};
+    for (auto _ : state) {
+        writer.write(line);
+        if (++lines % (1u << 20u) == 0) writer.sink().seekp(0);
+    }
+    report(state, std::size(line));
+}
+BENCHMARK(BM_stream_writer)->Apply(line_length_args);
+
+/// line_buffer without I/O, measuring the cost of buffering a line.
+template <typename Tstorage>
+static void BM_line_buffer(benchmark::State& state) {
+    auto line = make_line(state.range(0));
+    lbw::line_buffer<null_sink, Tstorage> lb{static_cast<std::size_t>(state.range(1))};
+    for (auto _ : state) {
+        lb.write(line);
+    }
+    report(state, std::size(line));
+}
+BENCHMARK_TEMPLATE(BM_line_buffer, std::vector<std::string>)->Apply(line_length_and_batch_args);
+BENCHMARK_TEMPLATE(BM_line_buffer, lbw::line_arena)->Apply(line_length_and_batch_args);
+
+/// Thread safe line buffers without I/O, shared by all benchmark threads. Measures the cost of synchronisation.
+template <typename Tline_buffer>
+static void BM_threaded_line_buffer(benchmark::State& state, Tline_buffer* (*make)(std::size_t)) {
+    static std::unique_ptr<Tline_buffer> lb;
+    if (state.thread_index() == 0) {
+        lb.reset(make(static_cast<std::size_t>(state.range(1))));
+    }
+    auto line = make_line(state.range(0));
+    for (auto _ : state) {
+        lb->write(line);
+    }
+    if (state.thread_index() == 0) {
+        lb.reset();
+    }
+    report(state, std::size(line));
+}
+
+BENCHMARK_CAPTURE(BM_threaded_line_buffer, line_buffer_ts, +[](std::size_t batch) {
+    return new lbw::line_buffer_ts<null_sink>{batch};
+})->Apply(threaded_args);
+BENCHMARK_CAPTURE(BM_threaded_line_buffer, line_buffer_ts_arena, +[](std::size_t batch) {
+    return new lbw::line_buffer_ts<null_sink, lbw::line_arena>{batch};
+})->Apply(threaded_args);
+BENCHMARK_CAPTURE(BM_threaded_line_buffer, line_buffer_ts_arena_traced, +[](std::size_t batch) {
+    auto lb = new lbw::line_buffer_ts<null_sink, lbw::line_arena, lbw::line_count_policy, lbw::ring_tracer>{batch};
+    lb->tracer(lbw::ring_tracer{lbw::ring_options{4096, std::chrono::microseconds{1}}});
+    return lb;
+})->Apply(threaded_args);
+BENCHMARK_CAPTURE(BM_threaded_line_buffer, sharded_line_buffer, +[](std::size_t batch) {
+    return new lbw::sharded_line_buffer<null_sink, lbw::line_arena>{batch, std::max(1u, std::thread::hardware_concurrency())};
+})->Apply(threaded_args);
+BENCHMARK_CAPTURE(BM_threaded_line_buffer, async_line_buffer, +[](std::size_t batch) {
+    return new lbw::async_line_buffer<null_sink, lbw::line_arena>{batch, 4};
+})->Apply(threaded_args);
+BENCHMARK_CAPTURE(BM_threaded_line_buffer, mpsc_ring_line_buffer, +[](std::size_t batch) {
+    return new lbw::mpsc_ring_line_buffer<null_sink>{batch, batch * 4, 256};
+})->Apply(threaded_args);
+
+/// Thread safe line buffers without I/O, written in groups of 100 lines with a single call to write.
+template <typename Tline_buffer>
+static void BM_threaded_line_buffer_group(benchmark::State& state, Tline_buffer* (*make)(std::size_t)) {
+    static std::unique_ptr<Tline_buffer> lb;
+    if (state.thread_index() == 0) {
+        lb.reset(make(static_cast<std::size_t>(state.range(1))));
+    }
+    std::vector<std::string> group(100, make_line(state.range(0)));
+    for (auto _ : state) {
+        lb->write(std::begin(group), std::end(group));
+    }
+    if (state.thread_index() == 0) {
+        lb.reset();
+    }
+    report(state, static_cast<std::size_t>(state.range(0)), std::size(group));
+}
+
+BENCHMARK_CAPTURE(BM_threaded_line_buffer_group, line_buffer_ts_arena, +[](std::size_t batch) {
+    return new lbw::line_buffer_ts<null_sink, lbw::line_arena>{batch};
+})->Apply(threaded_args);
+BENCHMARK_CAPTURE(BM_threaded_line_buffer_group, mpsc_ring_line_buffer, +[](std::size_t batch) {
+    return new lbw::mpsc_ring_line_buffer<null_sink>{batch, batch * 4, 256};
+})->Apply(threaded_args);
+
+/// A line_buffer writing segments through batch_stream_writer with the factory Tfactory to tmpfs. Every segment
+/// overwrites the same file, so the size of the benchmark directory stays bounded.
+/// \param name The name of the file to write.
+/// \tparam Tmetrics_policy The metrics policy of the batch_stream_writer.
+/// \param args The arguments passed to the factory before the filename template.
+template <typename Tfactory, typename Tmetrics_policy = lbw::null_metrics, typename ...Args>
+static void run_segmented_writer(benchmark::State& state, const std::string& name, Args&&... args) {
+    auto line = make_line(state.range(0));
+    lbw::line_buffer<lbw::batch_stream_writer<Tfactory, Tmetrics_policy>, lbw::line_arena> writer{static_cast<std::size_t>(state.range(1)), std::forward<Args>(args)..., directory().file(name)};
     for (auto _ : state) {
-        // Tested code here
-        ss << "Test" << "\n";
+        writer.write(line);
     }
+    report(state, std::size(line));
+}
+
+static void BM_file_stream_factory(benchmark::State& state) {
+    run_segmented_writer<lbw::file_stream_factory>(state, "file_stream_factory.txt");
 }
-// Register the function as a benchmark
-BENCHMARK(BM_BenchMark);
-// Run the benchmark
-BENCHMARK_MAIN();
\ No newline at end of file
+BENCHMARK(BM_file_stream_factory)->Apply(line_length_and_batch_args);
+
+static void BM_rotating_file_stream_factory(benchmark::State& state) {
+    run_segmented_writer<lbw::rotating_file_stream_factory>(state, "rotating_file_stream_factory.txt", lbw::file_rotation{64u << 20u, {}});
+}
+BENCHMARK(BM_rotating_file_stream_factory)->Apply(line_length_and_batch_args);
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+static void BM_fd_file_factory(benchmark::State& state) {
+    run_segmented_writer<lbw::fd_file_factory>(state, "fd_file_factory.txt");
+}
+BENCHMARK(BM_fd_file_factory)->Apply(line_length_and_batch_args);
+
+/// fd_file_factory recording writer_metrics, to compare with BM_fd_file_factory.
+static void BM_fd_file_factory_measured(benchmark::State& state) {
+    run_segmented_writer<lbw::fd_file_factory, lbw::writer_metrics>(state, "fd_file_factory_measured.txt");
+}
+BENCHMARK(BM_fd_file_factory_measured)->Apply(line_length_and_batch_args);
+
+static void BM_fd_file_factory_preallocated(benchmark::State& state) {
+    run_segmented_writer<lbw::fd_file_factory_preallocated>(state, "fd_file_factory_preallocated.txt");
+}
+BENCHMARK(BM_fd_file_factory_preallocated)->Apply(line_length_and_batch_args);
+
+/// The mapping is sized for the largest segment of the benchmark, so it does not grow.
+static void BM_mmap_file_factory(benchmark::State& state) {
+    lbw::mmap_options options;
+    options.segment_size = static_cast<std::size_t>((state.range(0) + 1) * state.range(1));
+    run_segmented_writer<lbw::mmap_file_factory>(state, "mmap_file_factory.txt", options);
+}
+BENCHMARK(BM_mmap_file_factory)->Apply(line_length_and_batch_args);
+
+static void BM_direct_file_factory(benchmark::State& state) {
+    run_segmented_writer<lbw::direct_file_factory>(state, "direct_file_factory.txt", lbw::direct_io_options{});
+}
+BENCHMARK(BM_direct_file_factory)->Apply(line_length_and_batch_args);
+
+static void BM_fd_file_factory_uncached(benchmark::State& state) {
+    run_segmented_writer<lbw::fd_file_factory_uncached>(state, "fd_file_factory_uncached.txt");
+}
+BENCHMARK(BM_fd_file_factory_uncached)->Apply(line_length_and_batch_args);
+#endif
+
+#ifdef LINE_BASED_WRITERS_HAS_IO_URING
+static void BM_io_uring_file_factory(benchmark::State& state) {
+    run_segmented_writer<lbw::io_uring_file_factory>(state, "io_uring_file_factory.txt", lbw::io_uring_options{});
+}
+BENCHMARK(BM_io_uring_file_factory)->Apply(line_length_and_batch_args);
+#endif
+
+/// segmented_line_based_file_writer_ts shared by all benchmark threads, writing to tmpfs.
+static void BM_segmented_line_based_file_writer_ts(benchmark::State& state) {
+    static std::unique_ptr<lbw::segmented_line_based_file_writer_ts> writer;
+    if (state.thread_index() == 0) {
+        writer = std::make_unique<lbw::segmented_line_based_file_writer_ts>(static_cast<std::size_t>(state.range(1)), directory().file("segmented_line_based_file_writer_ts.txt"));
+    }
+    auto line = make_line(state.range(0));
+    for (auto _ : state) {
+        writer->write(line);
+    }
+    if (state.thread_index() == 0) {
+        writer.reset();
+    }
+    report(state, std::size(line));
+}
+BENCHMARK(BM_segmented_line_based_file_writer_ts)->Apply(threaded_args);
+
+/// file_name_generator rendering a template with all supported macros.
+static void BM_file_name_generator(benchmark::State& state) {
+    lbw::file_name_generator generator{"/var/log/app/%YEAR%-%MONTH%-%DAY%/%HOUR%-%MINUTE%-%SECOND%-%NUM:8%.txt"};
+    std::size_t bytes{};
+    for (auto _ : state) {
+        auto name = generator.generate();
+        bytes += std::size(name);
+        benchmark::DoNotOptimize(name);
+    }
+    state.counters["names/s"] = benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+    state.counters["bytes/s"] = benchmark::Counter(static_cast<double>(bytes), benchmark::Counter::kIsRate, benchmark::Counter::kIs1024);
+}
+BENCHMARK(BM_file_name_generator);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,14 @@
+# zstd is optional. When it is found, the library links it and zstd_file_stream_factory is available.
+# Otherwise LINE_BASED_WRITERS_NO_ZSTD is defined, so a zstd.h without the library does not cause link errors.
+if (${PROJECT_NAME_UPPER}_WITH_ZSTD)
+    find_path(ZSTD_INCLUDE_DIR zstd.h)
+    find_library(ZSTD_LIBRARY NAMES zstd)
+endif()
+
+if (ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+    message(STATUS "Found zstd: ${ZSTD_LIBRARY}")
+    target_include_directories(${PROJECT_NAME} INTERFACE $<BUILD_INTERFACE:${ZSTD_INCLUDE_DIR}>)
+    target_link_libraries(${PROJECT_NAME} ${ZSTD_LIBRARY})
+else()
+    target_compile_definitions(${PROJECT_NAME} PUBLIC LINE_BASED_WRITERS_NO_ZSTD)
+endif()
@@ -3,10 +3,27 @@
 
 #include "line_based_writers/version.h"
 #include "line_based_writers/file_stream_factory.h"
+#include "line_based_writers/fd_file_factory.h"
+#include "line_based_writers/mmap_file_factory.h"
+#include "line_based_writers/direct_file_factory.h"
+#include "line_based_writers/io_uring_file_factory.h"
+#include "line_based_writers/compressing_file_factory.h"
+#include "line_based_writers/parallel_batch_writer.h"
+#include "line_based_writers/line_arena.h"
+#include "line_based_writers/segment_policy.h"
+#include "line_based_writers/async_line_buffer.h"
+#include "line_based_writers/mpsc_ring_line_buffer.h"
+#include "line_based_writers/flush_timer.h"
+#include "line_based_writers/writer_metrics.h"
+#include "line_based_writers/tracing.h"
+#include "line_based_writers/retention_manager.h"
+#include "line_based_writers/thread_index.h"
 #include <vector>
 #include <algorithm>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <thread>
 
 /// crosscode::line_based_writers namespace provides line based writers for use with exporters for
 /// https://github.com/crosscode-nl/simple_instruments like https://github.com/crosscode-nl/influxdblpexporter
@@ -40,69 +57,142 @@ namespace crosscode::line_based_writers {
     /// batch_stream_writer writes batches of data to a stream.
     /// \tparam Tline_writer_factory An implementation of a line_writer_factory. file_stream_factory is the
     /// implementation we provide.
-    template<typename Tline_writer_factory>
+    /// \tparam Tmetrics_policy Records the lines, bytes and latencies of every written batch. See writer_metrics.h.
+    /// The default policy records nothing.
+    template<typename Tline_writer_factory, typename Tmetrics_policy = null_metrics>
     class batch_stream_writer {
     public:
         using line_writer_factory = Tline_writer_factory;
+        using metrics_policy_type = Tmetrics_policy;
     private:
         line_writer_factory line_writer_factory_;
+        metrics_policy_type metrics_;
     public:
         template <typename ...Args>
         explicit batch_stream_writer(Args&&... args) : line_writer_factory_{std::forward<Args>(args)...} {}
         batch_stream_writer() = default;
-        batch_stream_writer(batch_stream_writer<line_writer_factory>&& rhs) noexcept : line_writer_factory_{std::move(rhs.line_writer_factory_)} {}
-        batch_stream_writer(const batch_stream_writer<line_writer_factory>&) = delete;
-        batch_stream_writer<line_writer_factory>&operator=(const batch_stream_writer<line_writer_factory>&) = delete;
+        batch_stream_writer(batch_stream_writer<line_writer_factory,metrics_policy_type>&& rhs) noexcept : line_writer_factory_{std::move(rhs.line_writer_factory_)}, metrics_{std::move(rhs.metrics_)} {}
+        batch_stream_writer(const batch_stream_writer<line_writer_factory,metrics_policy_type>&) = delete;
+        batch_stream_writer<line_writer_factory,metrics_policy_type>&operator=(const batch_stream_writer<line_writer_factory,metrics_policy_type>&) = delete;
 
+        /// write writes the lines from b up to e to a new file of the factory. Lines of a line_arena are passed to the
+        /// factory as one contiguous text when it supports it. See write_lines.
         template<typename Iter>
         void write(Iter b,Iter e) {
-            line_writer_factory_.begin();
-            auto write_line_to_stream = [this](const auto& item) {
-                line_writer_factory_.write(std::forward<decltype(item)>(item));
-            };
-            std::for_each(b,e,write_line_to_stream);
-
-            line_writer_factory_.commit();
+            measured_write(metrics_,line_writer_factory_,b,e);
         }
 
         line_writer_factory& factory() { return line_writer_factory_; }
+
+        metrics_policy_type& metrics() { return metrics_; }
     };
 
     /// A line_buffer that can be used by https://github.com/crosscode-nl/influxdblpexporter
     /// This is used to buffer writes to a stream.
+    /// Lifetime of lines: write copies the line into the storage, so the caller may reuse the memory of the line as soon
+    /// as write returns. Lines can be passed as anything convertible to std::string_view, byte buffers with line_view.
+    /// The lines passed to the sink are only valid until the write of the sink returns. With line_arena storage a line
+    /// is copied exactly once, into the arena, and factories providing write_text write the arena without copying it.
     /// \tparam Tline_based_iterator_sink The sink to write to when the buffer is emitted.
-    template<typename Tline_based_iterator_sink>
+    /// \tparam Tstorage The container used to store the buffered lines. Use line_arena to store all lines in one
+    /// reusable contiguous buffer and pass std::string_view instances to the sink. The storage must own the bytes of
+    /// its lines, see owns_lines.
+    /// \tparam Tsegment_policy Decides when the buffered lines are written to the sink. See segment_policy.h.
+    /// The default policy writes the buffer when it contains a number of lines.
+    /// \tparam Ttrace_policy Receives the time each segment spent in the buffer. See tracing.h. The tracer is shared with
+    /// a batch_stream_writer sink using the same policy as metrics policy. The default policy traces nothing.
+    template<typename Tline_based_iterator_sink, typename Tstorage = std::vector<std::string>, typename Tsegment_policy = line_count_policy, typename Ttrace_policy = null_tracer>
     class line_buffer {
     public:
         using sink_type = Tline_based_iterator_sink;
+        using storage_type = Tstorage;
+        using segment_policy_type = Tsegment_policy;
+        using trace_policy_type = Ttrace_policy;
+        static_assert(owns_lines<storage_type>::value,"line_buffer storage must own the bytes of its lines, use line_arena instead of a container of std::string_view");
     private:
-        std::size_t buffer_size_;
+        segment_policy_type segment_policy_;
         sink_type sink_;
-        std::vector<std::string> buffer_;
+        storage_type buffer_;
+        trace_policy_type tracer_;
+        std::chrono::steady_clock::time_point first_line_{};
+
+        /// share_tracer passes the tracer to the sink when the sink traces with the same policy.
+        void share_tracer() {
+            if constexpr (traced_by<sink_type,trace_policy_type>::value) {
+                sink_.metrics() = tracer_;
+            }
+        }
+
+        template<typename Tline>
+        void append(Tline &&line) {
+            if constexpr (trace_policy_type::enabled) {
+                if (buffer_.empty()) {
+                    first_line_ = tracer_.clock();
+                }
+            }
+            segment_policy_.add(line);
+            buffer_.emplace_back(std::forward<Tline>(line));
+            if (segment_policy_.full()) {
+                emit();
+            }
+        }
     public:
         template <typename ...Args>
-        explicit line_buffer(std::size_t buffer_size, Args&&... args) : buffer_size_{buffer_size}, sink_{std::forward<Args>(args)...} {}
-        explicit line_buffer(std::size_t buffer_size) : buffer_size_{buffer_size} {}
-        line_buffer(line_buffer<sink_type>&& rhs) noexcept : buffer_size_{rhs.buffer_size_}, sink_{std::move(rhs.sink_)}, buffer_{std::move(rhs.buffer_)} {}
-        line_buffer(const line_buffer<sink_type>&) = delete;
-        line_buffer<sink_type>&operator=(const line_buffer<sink_type>&) = delete;
+        explicit line_buffer(segment_policy_type segment_policy, Args&&... args) : segment_policy_{std::move(segment_policy)}, sink_{std::forward<Args>(args)...} { share_tracer(); }
+        explicit line_buffer(segment_policy_type segment_policy) : segment_policy_{std::move(segment_policy)} { share_tracer(); }
+        line_buffer(line_buffer<sink_type,storage_type,segment_policy_type,trace_policy_type>&& rhs) noexcept : segment_policy_{std::move(rhs.segment_policy_)}, sink_{std::move(rhs.sink_)}, buffer_{std::move(rhs.buffer_)}, tracer_{std::move(rhs.tracer_)}, first_line_{rhs.first_line_} {}
+        line_buffer(const line_buffer<sink_type,storage_type,segment_policy_type,trace_policy_type>&) = delete;
+        line_buffer<sink_type,storage_type,segment_policy_type,trace_policy_type>&operator=(const line_buffer<sink_type,storage_type,segment_policy_type,trace_policy_type>&) = delete;
 
+        /// write appends a line, or every line of a range of lines, see is_line_range.
         template<typename Tline>
         void write(Tline &&line) {
-            buffer_.emplace_back(std::forward<Tline>(line));
-            if (buffer_.size()==buffer_size_) {
-                sink_.write(begin(buffer_),end(buffer_));
-                buffer_.clear();
+            if constexpr (is_line_range<std::decay_t<Tline>>::value) {
+                write(std::begin(line),std::end(line));
+            } else {
+                append(std::forward<Tline>(line));
+            }
+        }
+
+        /// write appends the lines from first up to last. The segment policy is evaluated after every line, so a group
+        /// crossing a segment boundary is split exactly where separate writes would have been split.
+        template<typename Iter>
+        void write(Iter first, Iter last) {
+            for (;first!=last;++first) {
+                append(*first);
             }
         }
 
         void emit() {
-            sink_.write(begin(buffer_),end(buffer_));
+            if constexpr (trace_policy_type::enabled) {
+                if (!buffer_.empty()) {
+                    tracer_.record(trace_span{trace_stage::buffer,first_line_,tracer_.clock()-first_line_,std::size(buffer_)});
+                }
+            }
+            sink_.write(std::begin(buffer_),std::end(buffer_));
             buffer_.clear();
+            segment_policy_.reset();
+        }
+
+        /// poll writes the buffered lines to the sink when the segment policy is full. This allows time based segment
+        /// policies to roll a segment when no lines are written. See flush_timer.
+        void poll() {
+            if (!buffer_.empty() && segment_policy_.full()) {
+                emit();
+            }
         }
 
         sink_type& sink() { return sink_; }
 
+        /// tracer returns the trace policy. Copies of a tracer share what they record.
+        trace_policy_type& tracer() { return tracer_; }
+
+        /// tracer replaces the trace policy, and the trace policy of the sink when it is shared with the sink.
+        void tracer(trace_policy_type tracer) {
+            tracer_ = std::move(tracer);
+            share_tracer();
+        }
+
         ~line_buffer() {
             emit();
         }
@@ -110,39 +200,206 @@ namespace crosscode::line_based_writers {
 
     /// line_buffer_ts is a thread safe wrapper around line_buffer
     /// \tparam Tline_based_iterator_sink The sink to write to when the buffer is emitted.
-    template<typename Tline_based_iterator_sink>
+    /// \tparam Tstorage The container used to store the buffered lines. See line_buffer.
+    /// \tparam Tsegment_policy Decides when the buffered lines are written to the sink. See line_buffer.
+    /// \tparam Ttrace_policy Receives the time writes waited for the mutex and the spans of line_buffer. See tracing.h.
+    template<typename Tline_based_iterator_sink, typename Tstorage = std::vector<std::string>, typename Tsegment_policy = line_count_policy, typename Ttrace_policy = null_tracer>
     class line_buffer_ts {
     public:
         using sink_type = Tline_based_iterator_sink;
+        using storage_type = Tstorage;
+        using segment_policy_type = Tsegment_policy;
+        using trace_policy_type = Ttrace_policy;
     private:
-        line_buffer<Tline_based_iterator_sink> lb_;
+        line_buffer<Tline_based_iterator_sink,Tstorage,Tsegment_policy,Ttrace_policy> lb_;
         std::unique_ptr<std::mutex> mutex_;
+
+        /// lock locks the mutex and traces the time it took.
+        /// \param lines The amount of lines of the write.
+        std::unique_lock<std::mutex> lock([[maybe_unused]] std::size_t lines) {
+            if constexpr (trace_policy_type::enabled) {
+                auto start = trace_policy_type::clock();
+                std::unique_lock lock{*mutex_};
+                lb_.tracer().record(trace_span{trace_stage::lock_wait,start,trace_policy_type::clock()-start,lines});
+                return lock;
+            } else {
+                return std::unique_lock{*mutex_};
+            }
+        }
     public:
         template <typename ...Args>
-        explicit line_buffer_ts(std::size_t buffer_size, Args&&... args) : lb_{buffer_size, std::forward<Args>(args)...}, mutex_{std::make_unique<std::mutex>()} {}
-        explicit line_buffer_ts(std::size_t buffer_size) : lb_{buffer_size}, mutex_{std::make_unique<std::mutex>()} {}
-        line_buffer_ts(line_buffer_ts<sink_type>&& rhs) noexcept : lb_{std::move(rhs.lb_)}, mutex_{std::move(rhs.mutex_)} {}
-        line_buffer_ts(const line_buffer_ts<sink_type>&) = delete;
-        line_buffer_ts<sink_type>&operator=(const line_buffer<sink_type>&) = delete;
+        explicit line_buffer_ts(segment_policy_type segment_policy, Args&&... args) : lb_{std::move(segment_policy), std::forward<Args>(args)...}, mutex_{std::make_unique<std::mutex>()} {}
+        explicit line_buffer_ts(segment_policy_type segment_policy) : lb_{std::move(segment_policy)}, mutex_{std::make_unique<std::mutex>()} {}
+        line_buffer_ts(line_buffer_ts<sink_type,storage_type,segment_policy_type,trace_policy_type>&& rhs) noexcept : lb_{std::move(rhs.lb_)}, mutex_{std::move(rhs.mutex_)} {}
+        line_buffer_ts(const line_buffer_ts<sink_type,storage_type,segment_policy_type,trace_policy_type>&) = delete;
+        line_buffer_ts<sink_type,storage_type,segment_policy_type,trace_policy_type>&operator=(const line_buffer<sink_type,storage_type,segment_policy_type,trace_policy_type>&) = delete;
 
+        /// write appends a line, or every line of a range of lines while holding the lock once.
         template<typename Tline>
         void write(Tline &&line) {
-            std::scoped_lock lock{*mutex_};
+            std::size_t lines{1};
+            if constexpr (trace_policy_type::enabled && is_line_range<std::decay_t<Tline>>::value) {
+                lines = static_cast<std::size_t>(std::distance(std::begin(line),std::end(line)));
+            }
+            auto locked = lock(lines);
             lb_.write(line);
         }
 
+        /// write appends the lines from first up to last while holding the lock once. The lines are contiguous in the
+        /// written segments. See line_buffer::write.
+        template<typename Iter>
+        void write(Iter first, Iter last) {
+            std::size_t lines{};
+            if constexpr (trace_policy_type::enabled) {
+                lines = static_cast<std::size_t>(std::distance(first,last));
+            }
+            auto locked = lock(lines);
+            lb_.write(first,last);
+        }
+
         void emit() {
             std::scoped_lock lock{*mutex_};
             lb_.emit();
         }
 
+        void poll() {
+            std::scoped_lock lock{*mutex_};
+            lb_.poll();
+        }
+
         sink_type& sink() { return lb_.sink(); }
 
+        /// tracer returns the trace policy. Copies of a tracer share what they record.
+        trace_policy_type& tracer() { return lb_.tracer(); }
+
+        /// tracer replaces the trace policy. See line_buffer::tracer.
+        void tracer(trace_policy_type tracer) {
+            std::scoped_lock lock{*mutex_};
+            lb_.tracer(std::move(tracer));
+        }
+
         ~line_buffer_ts() {
             emit();
         }
     };
 
+    /// sharded_line_buffer is a thread safe line buffer that gives each writing thread its own line_buffer shard.
+    /// Threads are assigned to shards with thread_index, which reuses the indices of exited threads. When there are at
+    /// least as many shards as live writing threads, every thread appends to its own shard and the shard mutex is never
+    /// contended. Only a full shard
+    /// takes the sink mutex to write its lines to the sink as a segment. emit writes the lines of every shard.
+    /// Ordering guarantees: lines written by one thread are written to the sink in the order they were written. There
+    /// is no ordering between lines written by different threads. A segment only contains lines of threads that share
+    /// a shard. Empty shards are not written to the sink.
+    /// \tparam Tline_based_iterator_sink The sink to write to when a shard is emitted.
+    /// \tparam Tstorage The container used to store the buffered lines of a shard. See line_buffer.
+    /// \tparam Tsegment_policy Decides when the lines of a shard are written to the sink. Every shard has its own copy.
+    template<typename Tline_based_iterator_sink, typename Tstorage = std::vector<std::string>, typename Tsegment_policy = line_count_policy>
+    class sharded_line_buffer {
+    public:
+        using sink_type = Tline_based_iterator_sink;
+        using storage_type = Tstorage;
+        using segment_policy_type = Tsegment_policy;
+    private:
+        /// shared_sink is the sink that is shared by all shards.
+        struct shared_sink {
+            sink_type sink_;
+            std::mutex mutex_;
+
+            template <typename ...Args>
+            explicit shared_sink(Args&&... args) : sink_{std::forward<Args>(args)...} {}
+        };
+
+        /// locked_sink is the sink of a shard. It serializes writes to the shared sink.
+        class locked_sink {
+            shared_sink* shared_;
+        public:
+            explicit locked_sink(shared_sink* shared) : shared_{shared} {}
+
+            template<typename Iter>
+            void write(Iter b, Iter e) {
+                if (b==e) return;
+                std::scoped_lock lock{shared_->mutex_};
+                shared_->sink_.write(b,e);
+            }
+        };
+
+        /// shard is aligned to a cache line so shards used by different threads do not share cache lines.
+        struct alignas(64) shard {
+            std::mutex mutex_;
+            line_buffer<locked_sink,storage_type,segment_policy_type> lb_;
+
+            shard(const segment_policy_type& segment_policy, shared_sink* shared) : lb_{segment_policy,shared} {}
+        };
+
+        std::unique_ptr<shared_sink> sink_;
+        std::vector<std::unique_ptr<shard>> shards_;
+
+        void init(const segment_policy_type& segment_policy, std::size_t shards) {
+            if (shards==0) {
+                shards = std::max(std::size_t{std::thread::hardware_concurrency()},std::size_t{1});
+            }
+            shards_.reserve(shards);
+            for (std::size_t i=0;i<shards;i++) {
+                shards_.push_back(std::make_unique<shard>(segment_policy,sink_.get()));
+            }
+        }
+    public:
+        /// sharded_line_buffer constructor
+        /// \param segment_policy The segment policy of each shard, for the default policy the amount of lines in a shard
+        /// before it is written to the sink.
+        /// \param shards The amount of shards. When 0 the amount of hardware threads is used.
+        /// \param args The arguments passed to the sink constructor.
+        template <typename ...Args>
+        sharded_line_buffer(segment_policy_type segment_policy, std::size_t shards, Args&&... args) : sink_{std::make_unique<shared_sink>(std::forward<Args>(args)...)} {
+            init(segment_policy,shards);
+        }
+        sharded_line_buffer(sharded_line_buffer<sink_type,storage_type,segment_policy_type>&& rhs) noexcept : sink_{std::move(rhs.sink_)}, shards_{std::move(rhs.shards_)} {}
+        sharded_line_buffer(const sharded_line_buffer<sink_type,storage_type,segment_policy_type>&) = delete;
+        sharded_line_buffer<sink_type,storage_type,segment_policy_type>&operator=(const sharded_line_buffer<sink_type,storage_type,segment_policy_type>&) = delete;
+
+        /// write appends a line, or every line of a range of lines while holding the shard lock once.
+        template<typename Tline>
+        void write(Tline &&line) {
+            auto& s = *shards_[thread_index() % std::size(shards_)];
+            std::scoped_lock lock{s.mutex_};
+            s.lb_.write(std::forward<Tline>(line));
+        }
+
+        /// write appends the lines from first up to last to the shard of the calling thread while holding the shard
+        /// lock once.
+        template<typename Iter>
+        void write(Iter first, Iter last) {
+            auto& s = *shards_[thread_index() % std::size(shards_)];
+            std::scoped_lock lock{s.mutex_};
+            s.lb_.write(first,last);
+        }
+
+        void emit() {
+            for (auto& s : shards_) {
+                std::scoped_lock lock{s->mutex_};
+                s->lb_.emit();
+            }
+        }
+
+        void poll() {
+            for (auto& s : shards_) {
+                std::scoped_lock lock{s->mutex_};
+                s->lb_.poll();
+            }
+        }
+
+        /// sink returns the shared sink. Only access it while no other thread writes.
+        sink_type& sink() { return sink_->sink_; }
+
+        /// shards returns the amount of shards.
+        [[nodiscard]] std::size_t shards() const { return std::size(shards_); }
+
+        ~sharded_line_buffer() {
+            emit();
+        }
+    };
+
     /// segmented_line_based_file_writer is class of type line_buffer<batch_stream_writer<file_stream_factory>>
     /// The first constructor parameter contains the buffer size of type std::size_t
     /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
@@ -153,6 +410,209 @@ namespace crosscode::line_based_writers {
     /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
     using segmented_line_based_file_writer_ts = line_buffer_ts<batch_stream_writer<file_stream_factory>>;
 
+    /// segmented_line_based_file_writer_arena is a segmented_line_based_file_writer that stores the buffered lines
+    /// in a line_arena. Steady state writing and flushing of segments does not allocate memory for each line.
+    /// The constructor parameters are the same as for segmented_line_based_file_writer.
+    using segmented_line_based_file_writer_arena = line_buffer<batch_stream_writer<file_stream_factory>,line_arena>;
+
+    /// segmented_line_based_file_writer_arena_ts is a thread safe version of segmented_line_based_file_writer_arena.
+    /// The constructor parameters are the same as for segmented_line_based_file_writer.
+    using segmented_line_based_file_writer_arena_ts = line_buffer_ts<batch_stream_writer<file_stream_factory>,line_arena>;
+
+    /// segmented_line_based_file_writer_sized is a segmented_line_based_file_writer_arena that rolls a segment when
+    /// either a number of lines or a number of bytes is buffered, whichever comes first.
+    /// The first constructor parameter is a line_count_or_byte_size_policy{max_lines, max_bytes}
+    /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_sized = line_buffer<batch_stream_writer<file_stream_factory>,line_arena,line_count_or_byte_size_policy>;
+
+    /// segmented_line_based_file_writer_sized_ts is a thread safe version of segmented_line_based_file_writer_sized.
+    /// The constructor parameters are the same as for segmented_line_based_file_writer_sized.
+    using segmented_line_based_file_writer_sized_ts = line_buffer_ts<batch_stream_writer<file_stream_factory>,line_arena,line_count_or_byte_size_policy>;
+
+    /// segmented_line_based_file_writer_timed_ts is a thread safe segmented_line_based_file_writer that rolls a
+    /// segment when either a number of lines is buffered or the oldest line reaches a maximum age. Use a flush_timer to
+    /// roll segments during periods without writes.
+    /// The first constructor parameter is a line_count_or_max_age_policy{max_lines, max_age}
+    /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_timed_ts = line_buffer_ts<batch_stream_writer<file_stream_factory>,line_arena,line_count_or_max_age_policy>;
+
+    /// segmented_line_based_file_writer_atomic is class of type line_buffer<batch_stream_writer<file_stream_factory_atomic>,line_arena>
+    /// It writes each segment to a hidden temporary file and renames it to its name when the segment is complete, so
+    /// readers never see partially written segments.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_atomic = line_buffer<batch_stream_writer<file_stream_factory_atomic>,line_arena>;
+
+    /// segmented_line_based_file_writer_atomic_ts is a thread safe version of segmented_line_based_file_writer_atomic.
+    /// The constructor parameters are the same as for segmented_line_based_file_writer_atomic.
+    using segmented_line_based_file_writer_atomic_ts = line_buffer_ts<batch_stream_writer<file_stream_factory_atomic>,line_arena>;
+
+    /// segmented_line_based_file_writer_spilling_ts is class of type line_buffer_ts<batch_stream_writer<file_stream_factory_spilling>,line_arena>
+    /// It publishes segments like segmented_line_based_file_writer_atomic_ts. Segments that cannot be written, for
+    /// example because the disk is full, are kept in memory and retried with exponential backoff by later segments.
+    /// Use sink().factory().spill().metrics() to read the spill counters.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter is optional, a memory_spill with the spill_options of type memory_spill.
+    /// The last constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_spilling_ts = line_buffer_ts<batch_stream_writer<file_stream_factory_spilling>,line_arena>;
+
+    /// segmented_line_based_file_writer_retained_ts is class of type line_buffer_ts<batch_stream_writer<retained_factory<file_stream_factory_atomic>>,line_arena>
+    /// It publishes segments like segmented_line_based_file_writer_atomic_ts and adds every segment to a
+    /// retention_manager, which deletes the oldest segments when the total size or amount of segments is exceeded.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter is the retention_manager of type retention_manager&, which must outlive the writer.
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_retained_ts = line_buffer_ts<batch_stream_writer<retained_factory<file_stream_factory_atomic>>,line_arena>;
+
+    /// segmented_line_based_file_writer_measured_ts is class of type line_buffer_ts<batch_stream_writer<file_stream_factory,writer_metrics>,line_arena>
+    /// It counts the written segments, lines and bytes and records the latency of writing each segment. Use
+    /// sink().metrics().snapshot() to read the metrics.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_measured_ts = line_buffer_ts<batch_stream_writer<file_stream_factory,writer_metrics>,line_arena>;
+
+    /// segmented_line_based_file_writer_traced_ts is class of type line_buffer_ts<batch_stream_writer<file_stream_factory,ring_tracer>,line_arena,line_count_policy,ring_tracer>
+    /// It records the time lines spend in the buffer, waiting for the mutex, and in begin, write and commit of the
+    /// factory in a ring_tracer. Use tracer().spans() to read the most recent spans.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_traced_ts = line_buffer_ts<batch_stream_writer<file_stream_factory,ring_tracer>,line_arena,line_count_policy,ring_tracer>;
+
+    /// rotating_line_based_file_writer is class of type line_buffer<batch_stream_writer<rotating_file_stream_factory>,line_arena>
+    /// It appends segments to the same file and only creates a new file when the file reaches the size or age thresholds.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the rotation thresholds of type file_rotation
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using rotating_line_based_file_writer = line_buffer<batch_stream_writer<rotating_file_stream_factory>,line_arena>;
+
+    /// rotating_line_based_file_writer_ts is a thread safe version of rotating_line_based_file_writer.
+    /// The constructor parameters are the same as for rotating_line_based_file_writer.
+    using rotating_line_based_file_writer_ts = line_buffer_ts<batch_stream_writer<rotating_file_stream_factory>,line_arena>;
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+    /// segmented_line_based_fd_writer is class of type line_buffer<batch_stream_writer<fd_file_factory>,line_arena>
+    /// It writes each segment to a new file with a single writev based gather write. Only available on POSIX systems.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_fd_writer = line_buffer<batch_stream_writer<fd_file_factory>,line_arena>;
+
+    /// segmented_line_based_fd_writer_ts is a thread safe version of segmented_line_based_fd_writer.
+    /// The constructor parameters are the same as for segmented_line_based_fd_writer.
+    using segmented_line_based_fd_writer_ts = line_buffer_ts<batch_stream_writer<fd_file_factory>,line_arena>;
+
+    /// segmented_line_based_fd_writer_atomic_ts is class of type line_buffer_ts<batch_stream_writer<fd_file_factory_atomic>,line_arena>
+    /// It is thread safe, syncs every segment with fdatasync and renames it to its name when it is durable, so readers
+    /// only see complete and durable segments.
+    /// The constructor parameters are the same as for segmented_line_based_fd_writer.
+    using segmented_line_based_fd_writer_atomic_ts = line_buffer_ts<batch_stream_writer<fd_file_factory_atomic>,line_arena>;
+
+    /// segmented_line_based_fd_writer_sized_ts is class of type line_buffer_ts<batch_stream_writer<fd_file_factory_preallocated>,line_arena,line_count_or_byte_size_policy>
+    /// It is thread safe, rolls a segment when either a number of lines or a number of bytes is buffered and reserves
+    /// the space of every segment with fallocate before writing it.
+    /// The first constructor parameter is a line_count_or_byte_size_policy{max_lines, max_bytes}
+    /// The second constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_fd_writer_sized_ts = line_buffer_ts<batch_stream_writer<fd_file_factory_preallocated>,line_arena,line_count_or_byte_size_policy>;
+
+    /// segmented_line_based_group_commit_writer_ts is class of type line_buffer_ts<batch_stream_writer<fd_file_factory_group_commit>,line_arena>
+    /// It is thread safe and syncs the written segments in groups on a background thread. Call
+    /// sink().factory().wait_durable() after emit to wait until the written segments are durable.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the durability policy of type group_commit_durability
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_group_commit_writer_ts = line_buffer_ts<batch_stream_writer<fd_file_factory_group_commit>,line_arena>;
+
+    /// segmented_line_based_mmap_writer is class of type line_buffer<batch_stream_writer<mmap_file_factory>,line_arena>
+    /// It copies each segment into a memory mapped file that is allocated with the expected segment size. Only
+    /// available on POSIX systems.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the mapping options of type mmap_options
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_mmap_writer = line_buffer<batch_stream_writer<mmap_file_factory>,line_arena>;
+
+    /// segmented_line_based_mmap_writer_ts is a thread safe version of segmented_line_based_mmap_writer.
+    /// The constructor parameters are the same as for segmented_line_based_mmap_writer.
+    using segmented_line_based_mmap_writer_ts = line_buffer_ts<batch_stream_writer<mmap_file_factory>,line_arena>;
+
+    /// segmented_line_based_direct_writer is class of type line_buffer<batch_stream_writer<direct_file_factory>,line_arena>
+    /// It writes each segment with O_DIRECT from an aligned buffer, so segments do not fill the page cache. Only
+    /// available on POSIX systems.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the buffer options of type direct_io_options
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_direct_writer = line_buffer<batch_stream_writer<direct_file_factory>,line_arena>;
+
+    /// segmented_line_based_direct_writer_ts is a thread safe version of segmented_line_based_direct_writer.
+    /// The constructor parameters are the same as for segmented_line_based_direct_writer.
+    using segmented_line_based_direct_writer_ts = line_buffer_ts<batch_stream_writer<direct_file_factory>,line_arena>;
+#endif
+
+#ifdef LINE_BASED_WRITERS_HAS_IO_URING
+    /// segmented_line_based_io_uring_writer is class of type line_buffer<batch_stream_writer<io_uring_file_factory>,line_arena>
+    /// It writes segments asynchronously with io_uring and falls back to synchronous writes when io_uring is not
+    /// available. Only available on Linux.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the io_uring options of type io_uring_options
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_io_uring_writer = line_buffer<batch_stream_writer<io_uring_file_factory>,line_arena>;
+
+    /// segmented_line_based_io_uring_writer_ts is a thread safe version of segmented_line_based_io_uring_writer.
+    /// The constructor parameters are the same as for segmented_line_based_io_uring_writer.
+    using segmented_line_based_io_uring_writer_ts = line_buffer_ts<batch_stream_writer<io_uring_file_factory>,line_arena>;
+#endif
+
+#ifdef LINE_BASED_WRITERS_HAS_ZSTD
+    /// segmented_line_based_zstd_writer is class of type line_buffer<batch_stream_writer<zstd_file_stream_factory>,line_arena>
+    /// It writes each segment to a new zstd compressed file, compressing while the segment is written. Only available
+    /// when zstd is found.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the compression options of type compression_options
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_zstd_writer = line_buffer<batch_stream_writer<zstd_file_stream_factory>,line_arena>;
+
+    /// segmented_line_based_zstd_writer_ts is a thread safe version of segmented_line_based_zstd_writer.
+    /// The constructor parameters are the same as for segmented_line_based_zstd_writer.
+    using segmented_line_based_zstd_writer_ts = line_buffer_ts<batch_stream_writer<zstd_file_stream_factory>,line_arena>;
+
+    /// parallel_zstd_batch_writer is a parallel_batch_stream_writer whose workers write zstd compressed files.
+    using parallel_zstd_batch_writer = parallel_batch_stream_writer<compressing_file_stream_factory_template<file_name_reference,std::ofstream,zstd_encoder>>;
+
+    /// segmented_line_based_parallel_zstd_writer_ts is class of type line_buffer_ts<parallel_zstd_batch_writer,line_arena>
+    /// It is thread safe and compresses segments with a pool of workers. Filenames follow the order of the segments.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the amount of workers and queue depth of type parallel_options
+    /// The third constructor parameter contains the filename generator of type file_name_generator<>
+    /// The fourth constructor parameter contains the compression options of type compression_options
+    using segmented_line_based_parallel_zstd_writer_ts = line_buffer_ts<parallel_zstd_batch_writer,line_arena>;
+#endif
+
+    /// segmented_line_based_file_writer_async is class of type async_line_buffer<batch_stream_writer<file_stream_factory>,line_arena>
+    /// It is thread safe and writes the segments on a dedicated I/O thread.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the maximum amount of full buffers waiting to be written of type std::size_t
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_async = async_line_buffer<batch_stream_writer<file_stream_factory>,line_arena>;
+
+    /// segmented_line_based_file_writer_async_drop_oldest is class of type async_line_buffer<batch_stream_writer<file_stream_factory>,line_arena,line_count_policy,drop_oldest_backpressure>
+    /// It never blocks writers: when the disk cannot keep up, the oldest buffer waiting to be written is dropped. Use
+    /// backpressure() to read the drop counters.
+    /// The constructor parameters are the same as for segmented_line_based_file_writer_async.
+    using segmented_line_based_file_writer_async_drop_oldest = async_line_buffer<batch_stream_writer<file_stream_factory>,line_arena,line_count_policy,drop_oldest_backpressure>;
+
+    /// segmented_line_based_file_writer_sharded is class of type sharded_line_buffer<batch_stream_writer<file_stream_factory>,line_arena>
+    /// It is thread safe and gives each writing thread its own buffer. See sharded_line_buffer for the ordering guarantees.
+    /// The first constructor parameter contains the buffer size of each shard of type std::size_t
+    /// The second constructor parameter contains the amount of shards of type std::size_t, 0 uses the amount of hardware threads.
+    /// The third constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_sharded = sharded_line_buffer<batch_stream_writer<file_stream_factory>,line_arena>;
+
+    /// segmented_line_based_file_writer_ring is class of type mpsc_ring_line_buffer<batch_stream_writer<file_stream_factory>>
+    /// It is thread safe and writers do not take a mutex. See mpsc_ring_line_buffer.
+    /// The first constructor parameter contains the buffer size of type std::size_t
+    /// The second constructor parameter contains the amount of slots in the ring of type std::size_t
+    /// The third constructor parameter contains the amount of bytes reserved for each line of type std::size_t
+    /// The fourth constructor parameter filename_tpl of type std::string_view, containing the path and filename template to write the output to.
+    using segmented_line_based_file_writer_ring = mpsc_ring_line_buffer<batch_stream_writer<file_stream_factory>>;
+
 }
 
 #endif //LINE_BASED_WRITERS_LINE_BASED_WRITERS_H
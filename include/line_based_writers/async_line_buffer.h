@@ -0,0 +1,288 @@
+#ifndef LINE_BASED_WRITERS_ASYNC_LINE_BUFFER_H
+#define LINE_BASED_WRITERS_ASYNC_LINE_BUFFER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <iterator>
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <utility>
+#include "segment_policy.h"
+#include "backpressure_policy.h"
+#include "line_arena.h"
+
+namespace crosscode::line_based_writers {
+
+    /// async_line_buffer is a thread safe line buffer that writes full buffers to the sink on a dedicated I/O thread.
+    /// When the buffer is full it is swapped with a fresh buffer and queued for the I/O thread, so the writing thread
+    /// only pays for appending the line to the buffer. The queue is bounded; when the current buffer is full and
+    /// queue_depth buffers are waiting to be written, the backpressure policy decides whether a write blocks, drops its
+    /// line or drops the oldest waiting buffer.
+    /// emit queues the lines that are buffered and waits until all queued buffers are written. The destructor calls
+    /// emit and stops the I/O thread. Unlike line_buffer, emit does not write empty buffers to the sink.
+    /// An exception thrown by the sink is caught on the I/O thread, the lines of that buffer are lost and the I/O thread
+    /// continues with the next buffer. The exception is rethrown by the next call to write or emit. An exception that
+    /// is not rethrown before the destructor runs is ignored.
+    /// \tparam Tline_based_iterator_sink The sink to write to when the buffer is emitted. Only used from the I/O thread.
+    /// \tparam Tstorage The container used to store the buffered lines. Written buffers are reused, so line_arena
+    /// storage does not allocate in steady state.
+    /// \tparam Tsegment_policy Decides when the buffer is handed to the I/O thread. See segment_policy.h.
+    /// \tparam Tbackpressure_policy Decides what a write does when the sink cannot keep up. See backpressure_policy.h.
+    /// The default policy blocks writers until the I/O thread takes a buffer.
+    template<typename Tline_based_iterator_sink, typename Tstorage = std::vector<std::string>, typename Tsegment_policy = line_count_policy, typename Tbackpressure_policy = blocking_backpressure>
+    class async_line_buffer {
+    public:
+        using sink_type = Tline_based_iterator_sink;
+        using storage_type = Tstorage;
+        using segment_policy_type = Tsegment_policy;
+        using backpressure_policy_type = Tbackpressure_policy;
+        static_assert(owns_lines<storage_type>::value,"async_line_buffer storage must own the bytes of its lines, use line_arena instead of a container of std::string_view");
+    private:
+        /// state contains everything shared with the I/O thread. It lives on the heap so async_line_buffer is movable.
+        struct state {
+            backpressure_policy_type backpressure_;
+            segment_policy_type segment_policy_;
+            std::size_t queue_depth_;
+            sink_type sink_;
+            std::mutex mutex_;
+            std::condition_variable queued_;
+            std::condition_variable written_; // signalled when queue space is freed or a buffer is written
+            storage_type current_;
+            std::deque<storage_type> queue_;
+            std::vector<storage_type> free_;
+            bool busy_{false};
+            bool stop_{false};
+            std::exception_ptr error_; // thrown by the sink, rethrown by the next write or emit
+            std::thread thread_;
+
+            template <typename ...Args>
+            state(backpressure_policy_type backpressure, segment_policy_type segment_policy, std::size_t queue_depth, Args&&... args) : backpressure_{std::move(backpressure)}, segment_policy_{std::move(segment_policy)}, queue_depth_{std::max(queue_depth,std::size_t{1})}, sink_{std::forward<Args>(args)...} {}
+
+            [[nodiscard]] bool queue_full() const {
+                return std::size(queue_) >= queue_depth_;
+            }
+        };
+
+        std::unique_ptr<state> state_;
+
+        /// rethrow rethrows the exception thrown by the sink on the I/O thread, if any, and clears it.
+        void rethrow() {
+            auto& s = *state_;
+            if (s.error_) std::rethrow_exception(std::exchange(s.error_,nullptr));
+        }
+
+        /// enqueue moves the current buffer to the queue and replaces it with a free buffer.
+        /// Blocks while the queue is full. Other writers can append to or enqueue the current buffer while this one
+        /// waits, so the buffer is only enqueued when it still has to be after waiting.
+        /// \param lock The lock on the state mutex.
+        /// \param partial When true a buffer that is not full is enqueued as well.
+        void enqueue(std::unique_lock<std::mutex>& lock, bool partial) {
+            auto& s = *state_;
+            s.written_.wait(lock,[&s]{ return !s.queue_full(); });
+            if (s.current_.empty() || (!partial && !s.segment_policy_.full())) return;
+            push();
+        }
+
+        /// push moves the current buffer to the queue and replaces it with a free buffer. The queue must not be full.
+        void push() {
+            auto& s = *state_;
+            s.queue_.push_back(std::move(s.current_));
+            s.segment_policy_.reset();
+            if (s.free_.empty()) {
+                s.current_ = storage_type{};
+            } else {
+                s.current_ = std::move(s.free_.back());
+                s.free_.pop_back();
+            }
+            s.queued_.notify_one();
+        }
+
+        /// make_room prepares the current buffer for a line. A full current buffer is queued when the queue has space,
+        /// otherwise the buffer is saturated and the backpressure policy decides: wait for queue space, drop the line,
+        /// or drop the oldest queued buffer.
+        /// \param lock The lock on the state mutex.
+        /// \return false when the line must be dropped.
+        bool make_room(std::unique_lock<std::mutex>& lock) {
+            auto& s = *state_;
+            auto full = [&s]{ return !s.current_.empty() && s.segment_policy_.full(); };
+            if (!full()) return true;
+            if (s.queue_full()) {
+                switch (s.backpressure_.saturated()) {
+                    case backpressure_action::wait: {
+                        // Other writers can queue the current buffer while this one waits.
+                        auto ready = [&s,&full]{ return !s.queue_full() || !full(); };
+                        auto timeout = s.backpressure_.timeout();
+                        if (timeout==std::chrono::steady_clock::duration::max()) {
+                            s.written_.wait(lock,ready);
+                        } else if (!s.written_.wait_for(lock,timeout,ready)) {
+                            s.backpressure_.timed_out();
+                            s.backpressure_.dropped(1);
+                            return false;
+                        }
+                        if (!full()) return true;
+                        break;
+                    }
+                    case backpressure_action::drop_newest:
+                        s.backpressure_.dropped(1);
+                        return false;
+                    case backpressure_action::drop_oldest: {
+                        auto oldest = std::move(s.queue_.front());
+                        s.queue_.pop_front();
+                        s.backpressure_.dropped(std::size(oldest));
+                        oldest.clear();
+                        s.free_.push_back(std::move(oldest));
+                        break;
+                    }
+                }
+            }
+            push();
+            return true;
+        }
+
+        /// append appends a line to the current buffer and queues the buffer when it is full and the queue has space.
+        template<typename Tline>
+        void append(std::unique_lock<std::mutex>& lock, Tline &&line) {
+            auto& s = *state_;
+            if (!make_room(lock)) return;
+            s.segment_policy_.add(line);
+            s.current_.emplace_back(std::forward<Tline>(line));
+            if (s.segment_policy_.full() && !s.queue_full()) {
+                push();
+            }
+        }
+
+        /// run is the I/O thread. It writes queued buffers to the sink until it is stopped and the queue is empty.
+        static void run(state& s) {
+            std::unique_lock lock{s.mutex_};
+            for (;;) {
+                s.queued_.wait(lock,[&s]{ return s.stop_ || !s.queue_.empty(); });
+                if (s.queue_.empty()) return;
+                auto batch = std::move(s.queue_.front());
+                s.queue_.pop_front();
+                s.busy_ = true;
+                s.written_.notify_all();
+                lock.unlock();
+                std::exception_ptr error;
+                try {
+                    s.sink_.write(std::begin(batch),std::end(batch));
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                batch.clear();
+                lock.lock();
+                if (error && !s.error_) s.error_ = std::move(error);
+                if (std::size(s.free_) < s.queue_depth_) {
+                    s.free_.push_back(std::move(batch));
+                }
+                s.busy_ = false;
+                s.written_.notify_all();
+            }
+        }
+
+        void start() {
+            state_->thread_ = std::thread{run,std::ref(*state_)};
+        }
+
+    public:
+        /// async_line_buffer constructor
+        /// \param segment_policy Decides when a buffer is handed to the I/O thread. For the default policy this is the
+        /// amount of lines in a buffer.
+        /// \param queue_depth The maximum amount of full buffers waiting for the I/O thread. Minimum is 1.
+        /// \param args The arguments passed to the sink constructor.
+        template <typename ...Args>
+        async_line_buffer(segment_policy_type segment_policy, std::size_t queue_depth, Args&&... args) : state_{std::make_unique<state>(backpressure_policy_type{}, std::move(segment_policy), queue_depth, std::forward<Args>(args)...)} {
+            start();
+        }
+
+        /// async_line_buffer constructor for backpressure policies that need arguments.
+        /// \param backpressure The backpressure policy.
+        /// \param segment_policy Decides when a buffer is handed to the I/O thread.
+        /// \param queue_depth The maximum amount of full buffers waiting for the I/O thread. Minimum is 1.
+        /// \param args The arguments passed to the sink constructor.
+        template <typename ...Args>
+        async_line_buffer(backpressure_policy_type backpressure, segment_policy_type segment_policy, std::size_t queue_depth, Args&&... args) : state_{std::make_unique<state>(std::move(backpressure), std::move(segment_policy), queue_depth, std::forward<Args>(args)...)} {
+            start();
+        }
+        async_line_buffer(async_line_buffer<sink_type,storage_type,segment_policy_type,backpressure_policy_type>&& rhs) noexcept : state_{std::move(rhs.state_)} {}
+        async_line_buffer(const async_line_buffer<sink_type,storage_type,segment_policy_type,backpressure_policy_type>&) = delete;
+        async_line_buffer<sink_type,storage_type,segment_policy_type,backpressure_policy_type>&operator=(const async_line_buffer<sink_type,storage_type,segment_policy_type,backpressure_policy_type>&) = delete;
+
+        /// write appends a line, or every line of a range of lines, see is_line_range.
+        /// Rethrows an exception thrown by the sink since the last write or emit without appending the line.
+        template<typename Tline>
+        void write(Tline &&line) {
+            if constexpr (is_line_range<std::decay_t<Tline>>::value) {
+                write(std::begin(line),std::end(line));
+            } else {
+                std::unique_lock lock{state_->mutex_};
+                rethrow();
+                append(lock,std::forward<Tline>(line));
+            }
+        }
+
+        /// write appends the lines from first up to last while taking the lock once. The segment policy is evaluated
+        /// after every line, so the group is split across buffers like separate writes. The backpressure policy is
+        /// applied to every line. When it waits the lock is released, so lines of other writers can follow the lines
+        /// written up to then.
+        template<typename Iter>
+        void write(Iter first, Iter last) {
+            std::unique_lock lock{state_->mutex_};
+            rethrow();
+            for (;first!=last;++first) {
+                append(lock,*first);
+            }
+        }
+
+        /// emit queues the buffered lines and blocks until every queued buffer has been written to the sink.
+        /// Rethrows an exception thrown by the sink since the last write or emit.
+        void emit() {
+            auto& s = *state_;
+            std::unique_lock lock{s.mutex_};
+            enqueue(lock,true);
+            s.written_.wait(lock,[&s]{ return s.queue_.empty() && !s.busy_; });
+            rethrow();
+        }
+
+        /// poll queues the buffered lines when the segment policy is full. See line_buffer::poll.
+        void poll() {
+            std::unique_lock lock{state_->mutex_};
+            if (state_->segment_policy_.full()) {
+                enqueue(lock,false);
+            }
+        }
+
+        /// backpressure returns the counters of the backpressure policy.
+        [[nodiscard]] backpressure_metrics backpressure() const {
+            std::scoped_lock lock{state_->mutex_};
+            return state_->backpressure_.metrics();
+        }
+
+        /// sink returns the sink. The sink is used by the I/O thread, only access it after calling emit and while no
+        /// other thread writes.
+        sink_type& sink() { return state_->sink_; }
+
+        ~async_line_buffer() {
+            if (!state_) return;
+            try {
+                emit();
+            } catch (...) {
+                // A destructor does not throw, the exception of the sink is ignored.
+            }
+            {
+                std::scoped_lock lock{state_->mutex_};
+                state_->stop_ = true;
+            }
+            state_->queued_.notify_one();
+            state_->thread_.join();
+        }
+    };
+
+}
+
+#endif //LINE_BASED_WRITERS_ASYNC_LINE_BUFFER_H
@@ -0,0 +1,144 @@
+#ifndef LINE_BASED_WRITERS_BACKPRESSURE_POLICY_H
+#define LINE_BASED_WRITERS_BACKPRESSURE_POLICY_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+namespace crosscode::line_based_writers {
+
+    /// Backpressure policies decide what a write of async_line_buffer does when the buffer is saturated: the current
+    /// buffer is full and queue_depth buffers are waiting for the I/O thread, because the sink cannot keep up.
+    /// A backpressure policy provides the following members, which are called while the lock of the buffer is held:
+    /// - backpressure_action saturated() is called for every line written while the buffer is saturated.
+    /// - std::chrono::steady_clock::duration timeout() const is the maximum time a wait action waits for queue space.
+    ///   When it expires, timed_out is called and the line is dropped. duration::max() waits without a limit.
+    /// - void timed_out() is called when a wait expired.
+    /// - void dropped(std::size_t lines) is called with the amount of lines that were discarded.
+    /// - backpressure_metrics metrics() const returns the counters of the policy.
+
+    /// backpressure_action is the decision of a backpressure policy for a line written while the buffer is saturated.
+    enum class backpressure_action {
+        /// Wait for the I/O thread to take a buffer, at most timeout.
+        wait,
+        /// Discard the written line.
+        drop_newest,
+        /// Discard the oldest buffer waiting for the I/O thread to make room for the written line.
+        drop_oldest
+    };
+
+    /// backpressure_metrics contains the counters of a backpressure policy.
+    struct backpressure_metrics {
+        /// The amount of lines written while the buffer was saturated.
+        std::uint64_t saturated{};
+        /// The amount of waits that expired.
+        std::uint64_t timeouts{};
+        /// The amount of lines that were discarded.
+        std::uint64_t dropped_lines{};
+        /// The amount of queued buffers that were discarded.
+        std::uint64_t dropped_buffers{};
+    };
+
+    /// backpressure_counters implements the counters shared by the backpressure policies.
+    class backpressure_counters {
+    protected:
+        backpressure_metrics metrics_;
+    public:
+        void timed_out() {
+            metrics_.timeouts++;
+        }
+
+        void dropped(std::size_t lines) {
+            metrics_.dropped_lines += lines;
+        }
+
+        [[nodiscard]] backpressure_metrics metrics() const { return metrics_; }
+    };
+
+    /// blocking_backpressure blocks writers until the I/O thread takes a buffer. Lines are never dropped, but a slow
+    /// sink stalls every writer without a limit. This is the default policy.
+    class blocking_backpressure : public backpressure_counters {
+    public:
+        backpressure_action saturated() {
+            metrics_.saturated++;
+            return backpressure_action::wait;
+        }
+
+        [[nodiscard]] std::chrono::steady_clock::duration timeout() const {
+            return std::chrono::steady_clock::duration::max();
+        }
+    };
+
+    /// timeout_backpressure blocks writers until the I/O thread takes a buffer, at most timeout per line. Lines that
+    /// cannot be buffered within the timeout are dropped.
+    class timeout_backpressure : public backpressure_counters {
+        std::chrono::steady_clock::duration timeout_;
+    public:
+        /// timeout_backpressure constructor
+        /// \param timeout The maximum time a write waits for the I/O thread.
+        explicit timeout_backpressure(std::chrono::steady_clock::duration timeout) : timeout_{timeout} {}
+
+        backpressure_action saturated() {
+            metrics_.saturated++;
+            return backpressure_action::wait;
+        }
+
+        [[nodiscard]] std::chrono::steady_clock::duration timeout() const {
+            return timeout_;
+        }
+    };
+
+    /// drop_newest_backpressure never blocks writers. Lines written while the buffer is saturated are dropped, so the
+    /// written segments contain the lines from before the sink fell behind.
+    class drop_newest_backpressure : public backpressure_counters {
+    public:
+        backpressure_action saturated() {
+            metrics_.saturated++;
+            return backpressure_action::drop_newest;
+        }
+
+        [[nodiscard]] std::chrono::steady_clock::duration timeout() const {
+            return {};
+        }
+    };
+
+    /// drop_oldest_backpressure never blocks writers. When the buffer is saturated, the oldest buffer waiting for the
+    /// I/O thread is dropped to make room, so the written segments contain the most recent lines.
+    class drop_oldest_backpressure : public backpressure_counters {
+    public:
+        backpressure_action saturated() {
+            metrics_.saturated++;
+            metrics_.dropped_buffers++;
+            return backpressure_action::drop_oldest;
+        }
+
+        [[nodiscard]] std::chrono::steady_clock::duration timeout() const {
+            return {};
+        }
+    };
+
+    /// sampling_backpressure keeps one of every n lines written while the buffer is saturated. The kept lines wait for
+    /// the I/O thread at most timeout, the other lines are dropped. Writers are only delayed by the kept lines, and
+    /// the written segments keep a sample of the lines written while the sink fell behind.
+    class sampling_backpressure : public backpressure_counters {
+        std::size_t every_;
+        std::chrono::steady_clock::duration timeout_;
+    public:
+        /// sampling_backpressure constructor
+        /// \param every Keep one of every this many lines. Minimum is 1, which keeps every line.
+        /// \param timeout The maximum time a kept line waits for the I/O thread.
+        sampling_backpressure(std::size_t every, std::chrono::steady_clock::duration timeout) : every_{std::max(every,std::size_t{1})}, timeout_{timeout} {}
+
+        backpressure_action saturated() {
+            return metrics_.saturated++ % every_==0 ? backpressure_action::wait : backpressure_action::drop_newest;
+        }
+
+        [[nodiscard]] std::chrono::steady_clock::duration timeout() const {
+            return timeout_;
+        }
+    };
+
+}
+
+#endif //LINE_BASED_WRITERS_BACKPRESSURE_POLICY_H
@@ -0,0 +1,254 @@
+#ifndef LINE_BASED_WRITERS_COMPRESSING_FILE_FACTORY_H
+#define LINE_BASED_WRITERS_COMPRESSING_FILE_FACTORY_H
+
+#include "file_stream_factory.h"
+#include <string>
+#include <string_view>
+#include <memory>
+#include <algorithm>
+#include <cerrno>
+
+#if !defined(LINE_BASED_WRITERS_NO_ZSTD) && __has_include(<zstd.h>)
+#define LINE_BASED_WRITERS_HAS_ZSTD 1
+#include <zstd.h>
+#endif
+
+namespace crosscode::line_based_writers {
+
+    /// compression_options configures the encoder of a compressing_file_stream_factory_template.
+    struct compression_options {
+        /// The compression level passed to the encoder. 0 selects the default level of the encoder.
+        int level{};
+        /// The dictionary to compress with. Empty disables the dictionary.
+        std::string dictionary{};
+        /// The amount of uncompressed bytes collected before they are passed to the encoder. Minimum is 1.
+        std::size_t chunk_size{128*1024};
+        /// When true the extension of the encoder, for example .zst, is appended to the generated filename.
+        bool append_extension{true};
+    };
+
+    /// Encoders compress the segments written by compressing_file_stream_factory_template. An encoder provides:
+    /// - A constructor taking const compression_options&.
+    /// - static constexpr std::string_view extension, the filename extension of the compressed format.
+    /// - bool begin() starts a new compressed stream for a new file.
+    /// - bool compress(std::string_view input, std::string& output) compresses input and appends the compressed bytes
+    ///   that are available to output. The encoder may buffer input internally.
+    /// - bool end(std::string& output) appends the remaining compressed bytes and ends the compressed stream.
+    /// All functions return false when compression failed.
+
+#ifdef LINE_BASED_WRITERS_HAS_ZSTD
+    /// zstd_encoder compresses segments to the zstd frame format with the streaming zstd API. Every file is a single
+    /// zstd frame. Only available when zstd.h is found. Link with libzstd when it is used.
+    class zstd_encoder {
+        struct context_deleter {
+            void operator()(ZSTD_CCtx* context) const { ZSTD_freeCCtx(context); }
+        };
+
+        std::unique_ptr<ZSTD_CCtx,context_deleter> context_;
+        bool valid_;
+
+        /// stream passes input to zstd and appends the produced output until zstd consumed the input, or until the
+        /// frame is complete when mode is ZSTD_e_end.
+        bool stream(std::string_view input, std::string& output, ZSTD_EndDirective mode) {
+            ZSTD_inBuffer in{std::data(input),std::size(input),0};
+            for (;;) {
+                auto offset = std::size(output);
+                auto capacity = ZSTD_CStreamOutSize();
+                output.resize(offset+capacity);
+                ZSTD_outBuffer out{std::data(output)+offset,capacity,0};
+                auto remaining = ZSTD_compressStream2(context_.get(),&out,&in,mode);
+                output.resize(offset+out.pos);
+                if (ZSTD_isError(remaining)) return false;
+                if (mode==ZSTD_e_end ? remaining==0 : in.pos==in.size) return true;
+            }
+        }
+    public:
+        static constexpr std::string_view extension{".zst"};
+
+        /// zstd_encoder constructor
+        /// \param options The level and dictionary are used. The dictionary is loaded once and used for every file.
+        explicit zstd_encoder(const compression_options& options) : context_{ZSTD_createCCtx()} {
+            valid_ = context_ && !ZSTD_isError(ZSTD_CCtx_setParameter(context_.get(),ZSTD_c_compressionLevel,options.level));
+            if (valid_ && !options.dictionary.empty()) {
+                valid_ = !ZSTD_isError(ZSTD_CCtx_loadDictionary(context_.get(),std::data(options.dictionary),std::size(options.dictionary)));
+            }
+        }
+
+        bool begin() {
+            return valid_ && !ZSTD_isError(ZSTD_CCtx_reset(context_.get(),ZSTD_reset_session_only));
+        }
+
+        bool compress(std::string_view input, std::string& output) {
+            return stream(input,output,ZSTD_e_continue);
+        }
+
+        bool end(std::string& output) {
+            return stream({},output,ZSTD_e_end);
+        }
+    };
+#endif
+
+    /// compressing_file_stream_factory_template is a template for writing compressed batches to files.
+    /// It is used with batch_stream_writer as an alternative for file_stream_factory_template and creates a new file
+    /// for each batch. Lines are collected in a chunk of compression_options::chunk_size bytes, which is compressed
+    /// with the encoder and written to the file as soon as it is full, so compression happens while the batch is
+    /// written. commit compresses the last chunk, ends the compressed stream and closes the file.
+    /// When the encoder fails or the stream is in a failed state, the remainder of the batch is discarded and
+    /// last_error returns EIO.
+    /// \tparam Tfile_name_generator The filename generator to use generating filenames.
+    /// \tparam Tstream The stream type to be used. In production it is ofstream but it is replaced with a fake
+    /// in the unit tests.
+    /// \tparam Tencoder The encoder compressing the data. See zstd_encoder.
+    template <typename Tfile_name_generator, typename Tstream, typename Tencoder>
+    class compressing_file_stream_factory_template {
+    public:
+        using file_name_generator_type = Tfile_name_generator;
+        using stream_type = Tstream;
+        using encoder_type = Tencoder;
+    private:
+        std::size_t chunk_size_;
+        bool append_extension_;
+        encoder_type encoder_;
+        file_name_generator_type file_name_generator_;
+        stream_type stream_;
+        std::string input_;
+        std::string output_;
+        bool open_{false};
+        int last_error_{};
+
+        void close() {
+            stream_.close();
+            stream_.clear();
+            input_.clear();
+            output_.clear();
+            open_ = false;
+        }
+
+        void fail() {
+            last_error_ = EIO;
+            close();
+        }
+
+        /// write_output writes the compressed bytes to the stream.
+        void write_output() {
+            stream_.write(std::data(output_),static_cast<std::streamsize>(std::size(output_)));
+            output_.clear();
+            if (!stream_) fail();
+        }
+
+        /// compress_input compresses the collected chunk and writes the compressed bytes to the stream.
+        void compress_input() {
+            if (!encoder_.compress(input_,output_)) {
+                fail();
+                return;
+            }
+            input_.clear();
+            write_output();
+        }
+    public:
+
+        /// compressing_file_stream_factory_template constructor initializes the
+        /// compressing_file_stream_factory_template using a forwarding reference. It will pass all arguments after
+        /// options to the Tfile_name_generator constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param options The options of the compression. Passed to the encoder constructor.
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit compressing_file_stream_factory_template(const compression_options& options, Args&&... args) : chunk_size_{std::max(options.chunk_size,std::size_t{1})}, append_extension_{options.append_extension}, encoder_{options}, file_name_generator_{std::forward<Args>(args)...} {
+            input_.reserve(chunk_size_);
+        }
+        compressing_file_stream_factory_template(compressing_file_stream_factory_template<file_name_generator_type,stream_type,encoder_type>&& rhs) noexcept : chunk_size_{rhs.chunk_size_}, append_extension_{rhs.append_extension_}, encoder_{std::move(rhs.encoder_)}, file_name_generator_{std::move(rhs.file_name_generator_)}, stream_(std::move(rhs.stream_)), input_{std::move(rhs.input_)}, output_{std::move(rhs.output_)}, open_{rhs.open_}, last_error_{rhs.last_error_} { rhs.open_ = false; }
+        compressing_file_stream_factory_template(const compressing_file_stream_factory_template<file_name_generator_type,stream_type,encoder_type>&) = delete;
+        compressing_file_stream_factory_template<file_name_generator_type,stream_type,encoder_type>&operator=(const compressing_file_stream_factory_template<file_name_generator_type,stream_type,encoder_type>&) = delete;
+
+        /// begin is called when a new file should be created. It opens the file and starts a compressed stream.
+        void begin() {
+            auto file_name = file_name_generator_.generate();
+            if (append_extension_) file_name += encoder_type::extension;
+            stream_.open(file_name,std::ios::trunc|std::ios::binary|std::ios_base::out);
+            open_ = true;
+            if (!encoder_.begin()) fail();
+        }
+
+        /// write adds a line to the chunk and compresses the chunk when it is full.
+        /// \tparam Tline The type of the line to write
+        /// \param line The line to write
+        template<typename Tline>
+        void write(Tline &&line) {
+            if (!open_) return;
+            input_.append(std::string_view{line});
+            input_.push_back('\n');
+            if (std::size(input_)>=chunk_size_) {
+                compress_input();
+            }
+        }
+
+        /// write_text compresses complete lines that are each followed by a line separator in chunks. Full chunks are
+        /// passed to the encoder without copying them.
+        /// \param text The lines to write.
+        void write_text(std::string_view text) {
+            while (open_ && !text.empty()) {
+                if (input_.empty() && std::size(text)>=chunk_size_) {
+                    if (!encoder_.compress(text.substr(0,chunk_size_),output_)) {
+                        fail();
+                        return;
+                    }
+                    text.remove_prefix(chunk_size_);
+                    write_output();
+                    continue;
+                }
+                auto n = std::min(std::size(text),chunk_size_-std::size(input_));
+                input_.append(text.substr(0,n));
+                text.remove_prefix(n);
+                if (std::size(input_)>=chunk_size_) {
+                    compress_input();
+                }
+            }
+        }
+
+        /// commit compresses the remaining lines, ends the compressed stream and closes the file.
+        void commit() {
+            if (!open_) return;
+            compress_input();
+            if (!open_) return;
+            if (!encoder_.end(output_)) {
+                fail();
+                return;
+            }
+            write_output();
+            if (!open_) return;
+            stream_.flush();
+            close();
+        }
+
+        /// last_error returns EIO when compressing or writing a batch failed, or 0 when no batch failed.
+        [[nodiscard]] int last_error() const {
+            return last_error_;
+        }
+
+        /// encoder returns the encoder.
+        encoder_type& encoder() { return encoder_; }
+
+#ifdef CROSSCODE_ACCESS_TO_UNIT_TEST
+        /// returns the underlying stream. It is used for unit tests only.
+        const stream_type& underlying_stream() const {
+            return stream_;
+        }
+#endif
+    };
+
+    /// This type is a compressing_file_stream_factory_template using our file_name_generator. This type is used for
+    /// unit tests.
+    template <typename Tstream, typename Tencoder>
+    using compressing_file_stream_factory_no_stream = compressing_file_stream_factory_template<file_name_generator<>,Tstream,Tencoder>;
+    /// This type is a compressing_file_stream_factory using our file_name_generator and ofstream as underlying_stream.
+    template <typename Tencoder>
+    using compressing_file_stream_factory = compressing_file_stream_factory_no_stream<std::ofstream,Tencoder>;
+
+#ifdef LINE_BASED_WRITERS_HAS_ZSTD
+    /// This type is a compressing_file_stream_factory writing zstd compressed files.
+    using zstd_file_stream_factory = compressing_file_stream_factory<zstd_encoder>;
+#endif
+}
+
+#endif //LINE_BASED_WRITERS_COMPRESSING_FILE_FACTORY_H
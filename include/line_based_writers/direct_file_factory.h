@@ -0,0 +1,246 @@
+#ifndef LINE_BASED_WRITERS_DIRECT_FILE_FACTORY_H
+#define LINE_BASED_WRITERS_DIRECT_FILE_FACTORY_H
+
+#include "posix_io.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include "file_stream_factory.h"
+#include <string>
+#include <string_view>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+
+namespace crosscode::line_based_writers {
+
+    /// direct_io_options configures a direct_file_factory_template.
+    struct direct_io_options {
+        /// The size of the aligned buffer lines are collected in. A full buffer is written with one write call.
+        /// Rounded up to a multiple of alignment.
+        std::size_t buffer_size{1024*1024};
+        /// The alignment of the buffer, the file offsets and the write sizes required by O_DIRECT. Must be a power of
+        /// two. 4096 satisfies the logical block size of common devices.
+        std::size_t alignment{4096};
+    };
+
+    /// direct_file_factory_template is a template for writing batches to files without filling the page cache. It is
+    /// used with batch_stream_writer as a replacement for file_stream_factory_template and creates a new file for each
+    /// batch. Files are opened with O_DIRECT, or F_NOCACHE on macOS. Lines are copied into an aligned buffer, which is
+    /// allocated once and reused for every file, and full buffers are written directly to the device. commit pads the
+    /// last block with zeros, writes it and truncates the file to the size of the lines.
+    /// When the filesystem does not support O_DIRECT, the file is written through the page cache and removed from it
+    /// with posix_io::write_back and posix_io::drop_cache in commit.
+    /// When opening, writing or closing fails, the remainder of the batch is discarded, the file is removed, also with
+    /// publish_in_place, and last_error returns the errno value.
+    /// \tparam Tfile_name_generator The filename generator to use generating filenames.
+    /// \tparam Tpublish_policy Decides under which name the file is written and how it is published in commit.
+    template <typename Tfile_name_generator, typename Tpublish_policy = publish_in_place>
+    class direct_file_factory_template {
+    public:
+        using file_name_generator_type = Tfile_name_generator;
+        using publish_policy_type = Tpublish_policy;
+    private:
+        struct aligned_deleter {
+            void operator()(char* buffer) const { std::free(buffer); }
+        };
+
+        direct_io_options options_;
+        publish_policy_type publish_policy_;
+        file_name_generator_type file_name_generator_;
+        std::unique_ptr<char,aligned_deleter> buffer_;
+        std::string file_name_;
+        std::string temporary_name_;
+        int fd_{-1};
+        bool direct_{false};
+        std::size_t used_{};
+        std::size_t size_{};
+        int last_error_{};
+
+        /// open opens the file for direct I/O. Falls back to buffered I/O when the filesystem does not support it.
+        int open(const std::string& file_name) {
+            constexpr int flags = O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC;
+#ifdef O_DIRECT
+            auto fd = ::open(file_name.c_str(),flags|O_DIRECT,0666);
+            direct_ = fd>=0;
+            if (fd<0 && errno==EINVAL) {
+                fd = ::open(file_name.c_str(),flags,0666);
+            }
+#else
+            auto fd = ::open(file_name.c_str(),flags,0666);
+#ifdef F_NOCACHE
+            direct_ = fd>=0 && ::fcntl(fd,F_NOCACHE,1)==0;
+#endif
+#endif
+            return fd;
+        }
+
+        /// write_buffer writes size bytes of the buffer to the file. size is a multiple of the alignment.
+        int write_buffer(std::size_t size) {
+            iovec iov{buffer_.get(),size};
+            return posix_io::write_all(fd_,&iov,1);
+        }
+
+        /// append copies bytes into the buffer and writes the buffer when it is full.
+        /// \return 0 on success, otherwise the errno value of the failed write.
+        int append(const char* data, std::size_t size) {
+            while (size>0) {
+                auto n = std::min(size,options_.buffer_size-used_);
+                std::memcpy(buffer_.get()+used_,data,n);
+                used_ += n;
+                size_ += n;
+                data += n;
+                size -= n;
+                if (used_==options_.buffer_size) {
+                    if (auto error = write_buffer(used_); error!=0) return error;
+                    used_ = 0;
+                }
+            }
+            return 0;
+        }
+
+        /// finish writes the padded last block, truncates the file to the size of the lines and closes it.
+        /// \return The errno value of the first failed call, or 0.
+        int finish() {
+            int error{};
+            if (used_>0) {
+                auto padded = (used_+options_.alignment-1)/options_.alignment*options_.alignment;
+                std::memset(buffer_.get()+used_,0,padded-used_);
+                error = write_buffer(padded);
+            }
+            if (error==0) {
+                error = posix_io::truncate(fd_,size_);
+            }
+            if (error==0 && !direct_) {
+                error = posix_io::write_back(fd_);
+                if (error==0) {
+                    error = posix_io::drop_cache(fd_);
+                }
+            }
+            if (auto close_error = posix_io::close_fd(fd_); error==0) {
+                error = close_error;
+            }
+            fd_ = -1;
+            used_ = 0;
+            return error;
+        }
+
+        /// fail discards the remainder of the batch. The file is closed and removed, so a truncated batch is never
+        /// found under its name.
+        void fail(int error) {
+            last_error_ = error;
+            posix_io::close_fd(fd_);
+            fd_ = -1;
+            used_ = 0;
+            ::unlink(temporary_name_.c_str());
+        }
+    public:
+
+        /// direct_file_factory_template constructor initializes the direct_file_factory_template using a forwarding
+        /// reference. It will pass all arguments after options to the Tfile_name_generator constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param options The size and alignment of the buffer.
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit direct_file_factory_template(const direct_io_options& options, Args&&... args) : options_{options}, file_name_generator_{std::forward<Args>(args)...} {
+            options_.alignment = std::max(options_.alignment,sizeof(void*));
+            options_.buffer_size = std::max((options_.buffer_size+options_.alignment-1)/options_.alignment,std::size_t{1})*options_.alignment;
+            void* buffer{};
+            if (::posix_memalign(&buffer,options_.alignment,options_.buffer_size)==0) {
+                buffer_.reset(static_cast<char*>(buffer));
+            }
+        }
+        direct_file_factory_template(direct_file_factory_template<file_name_generator_type,publish_policy_type>&& rhs) noexcept : options_{rhs.options_}, publish_policy_{std::move(rhs.publish_policy_)}, file_name_generator_{std::move(rhs.file_name_generator_)}, buffer_{std::move(rhs.buffer_)}, file_name_{std::move(rhs.file_name_)}, temporary_name_{std::move(rhs.temporary_name_)}, fd_{rhs.fd_}, direct_{rhs.direct_}, used_{rhs.used_}, size_{rhs.size_}, last_error_{rhs.last_error_} { rhs.fd_ = -1; }
+        direct_file_factory_template(const direct_file_factory_template<file_name_generator_type,publish_policy_type>&) = delete;
+        direct_file_factory_template<file_name_generator_type,publish_policy_type>&operator=(const direct_file_factory_template<file_name_generator_type,publish_policy_type>&) = delete;
+
+        ~direct_file_factory_template() {
+            if (fd_>=0) {
+                posix_io::close_fd(fd_);
+            }
+        }
+
+        /// begin is called when a new file should be created. Fails with ENOMEM when the aligned buffer could not be
+        /// allocated, for example because the alignment is not a power of two.
+        void begin() {
+            used_ = 0;
+            size_ = 0;
+            file_name_ = file_name_generator_.generate();
+            temporary_name_ = publish_policy_.temporary_name(file_name_);
+            if (!buffer_) {
+                last_error_ = ENOMEM;
+                return;
+            }
+            fd_ = open(temporary_name_);
+            if (fd_<0) {
+                last_error_ = errno;
+            }
+        }
+
+        /// write copies a line and the line separator into the buffer.
+        /// \tparam Tline The type of the line to write
+        /// \param line The line to write
+        template<typename Tline>
+        void write(Tline &&line) {
+            if (fd_<0) return;
+            std::string_view bytes{line};
+            auto error = append(std::data(bytes),std::size(bytes));
+            if (error==0) {
+                error = append("\n",1);
+            }
+            if (error!=0) {
+                fail(error);
+            }
+        }
+
+        /// write_text copies complete lines that are each followed by a line separator into the buffer.
+        /// \param text The lines to write.
+        void write_text(std::string_view text) {
+            if (fd_<0) return;
+            if (auto error = append(std::data(text),std::size(text)); error!=0) {
+                fail(error);
+            }
+        }
+
+        /// commit writes the remaining lines, truncates and closes the file and publishes it. The file is removed when
+        /// this fails.
+        void commit() {
+            if (fd_<0) return;
+            auto error = finish();
+            if (error==0) {
+                error = publish_policy_.publish(temporary_name_,file_name_);
+            } else {
+                ::unlink(temporary_name_.c_str());
+            }
+            if (error!=0) {
+                last_error_ = error;
+            }
+        }
+
+        /// file_name returns the name of the file of the current or last batch.
+        [[nodiscard]] const std::string& file_name() const {
+            return file_name_;
+        }
+
+        /// last_error returns the errno value of the last failed operation, or 0 when no operation failed.
+        [[nodiscard]] int last_error() const {
+            return last_error_;
+        }
+
+        /// direct returns true when the current or last file was opened for direct I/O, false when it was written
+        /// through the page cache.
+        [[nodiscard]] bool direct() const {
+            return direct_;
+        }
+    };
+
+    /// This type is a direct_file_factory_template using our file_name_generator.
+    using direct_file_factory = direct_file_factory_template<file_name_generator<>>;
+}
+
+#endif
+
+#endif //LINE_BASED_WRITERS_DIRECT_FILE_FACTORY_H
@@ -0,0 +1,317 @@
+#ifndef LINE_BASED_WRITERS_DURABILITY_POLICY_H
+#define LINE_BASED_WRITERS_DURABILITY_POLICY_H
+
+#include "posix_io.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+
+namespace crosscode::line_based_writers {
+
+    /// Durability policies decide when the data of a written segment is flushed to stable storage. They are used by
+    /// fd_file_factory_template. A durability policy provides the following members:
+    /// - int commit(int fd) takes ownership of the file descriptor of a completely written segment and closes it,
+    ///   either immediately or after syncing. Returns the errno value of a failed sync or close, or 0.
+    /// - int published(const std::string& file_name) is called after the committed segment was published under
+    ///   file_name, by creating it in place or renaming it. Policies making segments durable sync the directory
+    ///   containing the segment, because syncing the data of a file does not persist its directory entry.
+    ///   Returns the errno value of a failed sync, or 0.
+    /// - int wait() blocks until every committed segment is durable. Returns the errno value of a failed sync since
+    ///   the previous wait, or 0.
+    /// - durability_metrics metrics() returns the metrics of the policy.
+
+    /// latency_stats accumulates latencies.
+    struct latency_stats {
+        std::uint64_t count{};
+        std::chrono::nanoseconds total{};
+        std::chrono::nanoseconds max{};
+
+        void add(std::chrono::nanoseconds latency) {
+            count++;
+            total += latency;
+            max = std::max(max,latency);
+        }
+
+        /// mean returns the mean latency, or zero when no latency was added.
+        [[nodiscard]] std::chrono::nanoseconds mean() const {
+            return count==0 ? std::chrono::nanoseconds{} : total/static_cast<std::chrono::nanoseconds::rep>(count);
+        }
+    };
+
+    /// durability_metrics contains the metrics of a durability policy.
+    struct durability_metrics {
+        /// The amount of committed segments.
+        std::uint64_t segments{};
+        /// The latency of each sync call or group commit pass.
+        latency_stats sync_latency{};
+        /// The time from the commit of a segment until it is durable.
+        latency_stats durable_latency{};
+    };
+
+    /// no_durability closes segments without syncing. The data reaches stable storage when the operating system
+    /// writes it back. This is the behaviour of the other file factories and the default.
+    class no_durability {
+        durability_metrics metrics_;
+    public:
+        int commit(int fd) {
+            metrics_.segments++;
+            return posix_io::close_fd(fd);
+        }
+
+        int published(const std::string&) { return 0; }
+
+        int wait() { return 0; }
+
+        [[nodiscard]] durability_metrics metrics() const { return metrics_; }
+    };
+
+    /// fdatasync_durability syncs every segment with fdatasync before it is closed, and the directory containing it
+    /// after it is published, so a segment is durable when the commit of the file factory returns. Every segment pays
+    /// the latency of two syncs.
+    /// \tparam now The function to use for retrieving the current time. Replaceable to enable unit tests.
+    template <auto now=std::chrono::steady_clock::now>
+    class fdatasync_durability_template {
+        durability_metrics metrics_;
+    public:
+        int commit(int fd) {
+            metrics_.segments++;
+            auto start = now();
+            auto error = posix_io::sync_data(fd);
+            auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now()-start);
+            metrics_.sync_latency.add(latency);
+            metrics_.durable_latency.add(latency);
+            auto close_error = posix_io::close_fd(fd);
+            return error!=0 ? error : close_error;
+        }
+
+        int published(const std::string& file_name) {
+            return posix_io::sync_directory(posix_io::parent_directory(file_name));
+        }
+
+        int wait() { return 0; }
+
+        [[nodiscard]] durability_metrics metrics() const { return metrics_; }
+    };
+
+    using fdatasync_durability = fdatasync_durability_template<>;
+
+    /// drop_page_cache writes every segment back to the device and removes its pages from the page cache before it is
+    /// closed, so segments that are not read again do not take memory from other processes on the host. The segment
+    /// is written to the device, but not durable: on Linux the disk cache and the file metadata are not flushed.
+    /// The time to write back a segment is reported as sync latency.
+    class drop_page_cache {
+        durability_metrics metrics_;
+    public:
+        int commit(int fd) {
+            metrics_.segments++;
+            auto start = std::chrono::steady_clock::now();
+            auto error = posix_io::write_back(fd);
+            if (error==0) {
+                error = posix_io::drop_cache(fd);
+            }
+            metrics_.sync_latency.add(std::chrono::steady_clock::now()-start);
+            auto close_error = posix_io::close_fd(fd);
+            return error!=0 ? error : close_error;
+        }
+
+        int published(const std::string&) { return 0; }
+
+        int wait() { return 0; }
+
+        [[nodiscard]] durability_metrics metrics() const { return metrics_; }
+    };
+
+    /// group_commit_options configures group_commit_durability.
+    struct group_commit_options {
+        /// sync_mode selects how a group of segments is synced.
+        enum class sync_mode {
+            /// One syncfs call for the whole group. Syncs all dirty data of the filesystem. Only available on Linux,
+            /// fdatasync is used on other systems.
+            syncfs,
+            /// One fdatasync call for each segment in the group.
+            fdatasync
+        };
+        /// The maximum time a committed segment waits for the next group commit.
+        std::chrono::steady_clock::duration max_delay{std::chrono::milliseconds{10}};
+        /// The amount of committed segments that starts a group commit without waiting for max_delay.
+        std::size_t max_segments{64};
+        sync_mode mode{sync_mode::fdatasync};
+    };
+
+    /// group_commit_durability syncs committed segments in groups on a background thread. commit hands the file
+    /// descriptor to the thread and returns immediately, published hands it the directory of the segment. The thread
+    /// syncs and closes the pending segments when max_segments segments are pending, when the oldest pending segment
+    /// waited max_delay, or when wait is called. Each directory of a group is synced once, after the segments.
+    /// Every segment is durable within max_delay plus the duration of a sync.
+    /// Errors of the background thread are returned by wait.
+    class group_commit_durability {
+        /// pending is a committed segment that is not durable yet, or the directory of a published segment when fd_
+        /// is -1.
+        struct pending {
+            int fd_;
+            std::string directory_;
+            std::chrono::steady_clock::time_point committed_at_;
+        };
+
+        /// state contains everything shared with the sync thread. It lives on the heap so the policy is movable.
+        struct state {
+            group_commit_options options_;
+            std::mutex mutex_;
+            std::condition_variable pending_cv_;
+            std::condition_variable durable_cv_;
+            std::vector<pending> pending_;
+            std::size_t pending_segments_{};
+            std::uint64_t committed_{};
+            std::uint64_t durable_{};
+            std::uint64_t requested_{};
+            int error_{};
+            bool stop_{false};
+            durability_metrics metrics_;
+            std::thread thread_;
+
+            explicit state(const group_commit_options& options) : options_{options} {}
+        };
+
+        std::unique_ptr<state> state_;
+
+        /// sync syncs and closes a group of segments and syncs their directories.
+        /// \return The errno value of the first failed call, or 0.
+        static int sync(const group_commit_options& options, const std::vector<pending>& group) {
+            int error{};
+            auto keep_first = [&error](int e) { if (error==0) error = e; };
+            auto segment = std::find_if(std::begin(group),std::end(group),[](const pending& p) { return p.fd_>=0; });
+#ifdef __linux__
+            if (options.mode==group_commit_options::sync_mode::syncfs) {
+                if (segment!=std::end(group)) {
+                    keep_first(posix_io::sync_filesystem(segment->fd_));
+                }
+            } else
+#endif
+            {
+                for (const auto& p : group) {
+                    if (p.fd_>=0) keep_first(posix_io::sync_data(p.fd_));
+                }
+            }
+            std::vector<const std::string*> directories;
+            for (const auto& p : group) {
+                if (p.fd_>=0) {
+                    keep_first(posix_io::close_fd(p.fd_));
+                } else if (std::none_of(std::begin(directories),std::end(directories),[&p](const std::string* d) { return *d==p.directory_; })) {
+                    directories.push_back(&p.directory_);
+                    keep_first(posix_io::sync_directory(p.directory_));
+                }
+            }
+            return error;
+        }
+
+        /// run is the sync thread.
+        static void run(state& s) {
+            std::unique_lock lock{s.mutex_};
+            std::vector<pending> group;
+            for (;;) {
+                auto due = [&s]{
+                    return s.stop_ || s.pending_segments_>=s.options_.max_segments || (!s.pending_.empty() && s.requested_>s.durable_);
+                };
+                if (s.pending_.empty()) {
+                    if (s.stop_) return;
+                    s.pending_cv_.wait(lock,[&s]{ return s.stop_ || !s.pending_.empty(); });
+                    continue;
+                }
+                s.pending_cv_.wait_until(lock,s.pending_.front().committed_at_+s.options_.max_delay,due);
+                group.swap(s.pending_);
+                s.pending_segments_ = 0;
+                auto target = s.committed_;
+                lock.unlock();
+                auto start = std::chrono::steady_clock::now();
+                auto error = sync(s.options_,group);
+                auto end = std::chrono::steady_clock::now();
+                lock.lock();
+                s.metrics_.sync_latency.add(end-start);
+                for (const auto& p : group) {
+                    if (p.fd_>=0) s.metrics_.durable_latency.add(end-p.committed_at_);
+                }
+                group.clear();
+                if (error!=0) s.error_ = error;
+                s.durable_ = target;
+                s.durable_cv_.notify_all();
+            }
+        }
+
+    public:
+        /// group_commit_durability constructor
+        /// \param options The group commit options.
+        explicit group_commit_durability(const group_commit_options& options = {}) : state_{std::make_unique<state>(options)} {
+            state_->thread_ = std::thread{run,std::ref(*state_)};
+        }
+        group_commit_durability(group_commit_durability&& rhs) noexcept : state_{std::move(rhs.state_)} {}
+        group_commit_durability(const group_commit_durability&) = delete;
+        group_commit_durability& operator=(const group_commit_durability&) = delete;
+
+        int commit(int fd) {
+            auto& s = *state_;
+            std::scoped_lock lock{s.mutex_};
+            s.pending_.push_back(pending{fd,{},std::chrono::steady_clock::now()});
+            s.pending_segments_++;
+            s.committed_++;
+            s.metrics_.segments++;
+            if (std::size(s.pending_)==1 || s.pending_segments_>=s.options_.max_segments) {
+                s.pending_cv_.notify_one();
+            }
+            return 0;
+        }
+
+        /// published adds the directory of a segment to the next group commit.
+        int published(const std::string& file_name) {
+            auto& s = *state_;
+            std::scoped_lock lock{s.mutex_};
+            s.pending_.push_back(pending{-1,posix_io::parent_directory(file_name),std::chrono::steady_clock::now()});
+            s.committed_++;
+            if (std::size(s.pending_)==1) {
+                s.pending_cv_.notify_one();
+            }
+            return 0;
+        }
+
+        /// wait starts a group commit of the pending segments and blocks until they are durable.
+        int wait() {
+            auto& s = *state_;
+            std::unique_lock lock{s.mutex_};
+            auto target = s.committed_;
+            s.requested_ = std::max(s.requested_,target);
+            s.pending_cv_.notify_one();
+            s.durable_cv_.wait(lock,[&s,target]{ return s.durable_>=target; });
+            return std::exchange(s.error_,0);
+        }
+
+        [[nodiscard]] durability_metrics metrics() const {
+            std::scoped_lock lock{state_->mutex_};
+            return state_->metrics_;
+        }
+
+        ~group_commit_durability() {
+            if (!state_) return;
+            wait();
+            {
+                std::scoped_lock lock{state_->mutex_};
+                state_->stop_ = true;
+            }
+            state_->pending_cv_.notify_one();
+            state_->thread_.join();
+        }
+    };
+
+}
+
+#endif
+
+#endif //LINE_BASED_WRITERS_DURABILITY_POLICY_H
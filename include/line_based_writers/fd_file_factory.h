@@ -0,0 +1,205 @@
+#ifndef LINE_BASED_WRITERS_FD_FILE_FACTORY_H
+#define LINE_BASED_WRITERS_FD_FILE_FACTORY_H
+
+#include "posix_io.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include "file_stream_factory.h"
+#include "durability_policy.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cerrno>
+#include <fcntl.h>
+
+namespace crosscode::line_based_writers {
+
+    /// Allocation policies decide whether fd_file_factory_template reserves the disk space of a batch before writing
+    /// it. An allocation policy provides the following member:
+    /// - int allocate(int fd, std::size_t size) is called in commit with the size of the batch before the batch is
+    ///   written. Returns 0 on success, otherwise an errno value, which discards the batch.
+
+    /// no_preallocation lets the filesystem allocate space while the batch is written. This is the default.
+    struct no_preallocation {
+        int allocate(int, std::size_t) const {
+            return 0;
+        }
+    };
+
+    /// preallocate_batch reserves the exact size of the batch with posix_io::preallocate before it is written. This
+    /// reduces extent fragmentation and metadata updates when many large segments are written concurrently, and a
+    /// full disk is detected before any line of the batch is written.
+    struct preallocate_batch {
+        int allocate(int fd, std::size_t size) const {
+            return posix_io::preallocate(fd,size);
+        }
+    };
+
+    /// fd_file_factory_template is a template for writing batches to files with POSIX file descriptors.
+    /// It is used with batch_stream_writer as an alternative for file_stream_factory_template. It creates a new file
+    /// for each batch. Instead of formatting lines into a stream buffer, it collects an iovec for each line and each
+    /// line separator and writes the whole batch with writev in commit. The line data is not copied.
+    /// Lines passed to write must stay valid until commit. This is the case for lines written by batch_stream_writer,
+    /// because they point into the buffer of the line buffer that is being emitted.
+    /// When opening, writing or closing fails, the remainder of the batch is discarded and last_error returns the
+    /// errno value.
+    /// After a batch is written, the file is handed to the durability policy, which decides when the file is synced to
+    /// stable storage and closed. See durability_policy.h. Then the file is published with the publish policy and
+    /// the durability policy is told about its name, so it can sync the directory entry. A file that could not be
+    /// written completely is not published; its temporary file is removed.
+    /// With publish_by_rename and fdatasync_durability the data of a file is durable before it is renamed, and the
+    /// rename is durable when commit returns, because the durability policy syncs the directory.
+    /// publish_by_durable_rename is not needed. With group_commit_durability the rename happens before the group is
+    /// synced, and the directory is synced with the group.
+    /// \tparam Tfile_name_generator The filename generator to use generating filenames.
+    /// \tparam Tdurability_policy The durability policy. The default does not sync.
+    /// \tparam Tpublish_policy Decides under which name the file is written and how it is published in commit.
+    /// \tparam Tallocation_policy Decides whether the space of a batch is reserved before it is written.
+    template <typename Tfile_name_generator, typename Tdurability_policy = no_durability, typename Tpublish_policy = publish_in_place, typename Tallocation_policy = no_preallocation>
+    class fd_file_factory_template {
+    public:
+        using file_name_generator_type = Tfile_name_generator;
+        using durability_policy_type = Tdurability_policy;
+        using publish_policy_type = Tpublish_policy;
+        using allocation_policy_type = Tallocation_policy;
+    private:
+        static constexpr char newline_ = '\n';
+
+        durability_policy_type durability_;
+        publish_policy_type publish_policy_;
+        allocation_policy_type allocation_policy_;
+        file_name_generator_type file_name_generator_;
+        std::string file_name_;
+        std::string temporary_name_;
+        int fd_{-1};
+        std::vector<iovec> iov_;
+        std::size_t size_{};
+        int last_error_{};
+    public:
+
+        /// fd_file_factory_template constructor initializes the fd_file_factory_template using a forwarding
+        /// reference. It will pass all arguments to the Tfile_name_generator constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit fd_file_factory_template(Args&&... args) : file_name_generator_{std::forward<Args>(args)...} {}
+
+        /// fd_file_factory_template constructor initializes the durability policy with durability and passes all
+        /// other arguments to the Tfile_name_generator constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param durability The durability policy.
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit fd_file_factory_template(durability_policy_type durability, Args&&... args) : durability_{std::move(durability)}, file_name_generator_{std::forward<Args>(args)...} {}
+        fd_file_factory_template(fd_file_factory_template<file_name_generator_type,durability_policy_type,publish_policy_type,allocation_policy_type>&& rhs) noexcept : durability_{std::move(rhs.durability_)}, publish_policy_{std::move(rhs.publish_policy_)}, allocation_policy_{std::move(rhs.allocation_policy_)}, file_name_generator_{std::move(rhs.file_name_generator_)}, file_name_{std::move(rhs.file_name_)}, temporary_name_{std::move(rhs.temporary_name_)}, fd_{rhs.fd_}, iov_{std::move(rhs.iov_)}, size_{rhs.size_}, last_error_{rhs.last_error_} { rhs.fd_ = -1; }
+        fd_file_factory_template(const fd_file_factory_template<file_name_generator_type,durability_policy_type,publish_policy_type,allocation_policy_type>&) = delete;
+        fd_file_factory_template<file_name_generator_type,durability_policy_type,publish_policy_type,allocation_policy_type>&operator=(const fd_file_factory_template<file_name_generator_type,durability_policy_type,publish_policy_type,allocation_policy_type>&) = delete;
+
+        ~fd_file_factory_template() {
+            if (fd_>=0) {
+                posix_io::close_fd(fd_);
+            }
+        }
+
+        /// begin is called when a new file should be created.
+        void begin() {
+            iov_.clear();
+            size_ = 0;
+            file_name_ = file_name_generator_.generate();
+            temporary_name_ = publish_policy_.temporary_name(file_name_);
+            fd_ = ::open(temporary_name_.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0666);
+            if (fd_<0) {
+                last_error_ = errno;
+            }
+        }
+
+        /// write adds a line to the batch. The line is written in commit.
+        /// \tparam Tline The type of the line to write
+        /// \param line The line to write. Must stay valid until commit.
+        template<typename Tline>
+        void write(Tline &&line) {
+            std::string_view bytes{line};
+            iov_.push_back(iovec{const_cast<char*>(std::data(bytes)),std::size(bytes)});
+            iov_.push_back(iovec{const_cast<char*>(&newline_),1});
+            size_ += std::size(bytes)+1;
+        }
+
+        /// write_text adds complete lines that are each followed by a line separator to the batch as a single buffer.
+        /// \param text The lines to write. Must stay valid until commit.
+        void write_text(std::string_view text) {
+            iov_.push_back(iovec{const_cast<char*>(std::data(text)),std::size(text)});
+            size_ += std::size(text);
+        }
+
+        /// commit reserves the space of the batch with the allocation policy, writes the batch to the file, hands the
+        /// file to the durability policy, publishes it and hands its name to the durability policy.
+        void commit() {
+            if (fd_>=0) {
+                auto error = allocation_policy_.allocate(fd_,size_);
+                if (error==0) {
+                    error = posix_io::write_all(fd_,std::data(iov_),std::size(iov_));
+                }
+                if (auto commit_error = durability_.commit(fd_); error==0) {
+                    error = commit_error;
+                }
+                fd_ = -1;
+                if (error==0) {
+                    error = publish_policy_.publish(temporary_name_,file_name_);
+                    if (error==0) {
+                        error = durability_.published(file_name_);
+                    }
+                } else if (temporary_name_!=file_name_) {
+                    ::unlink(temporary_name_.c_str());
+                }
+                if (error!=0) {
+                    last_error_ = error;
+                }
+            }
+            iov_.clear();
+            size_ = 0;
+        }
+
+        /// wait_durable blocks until every committed batch is durable according to the durability policy.
+        /// \return 0 when the batches are durable, otherwise the errno value of a failed sync.
+        int wait_durable() {
+            auto error = durability_.wait();
+            if (error!=0) {
+                last_error_ = error;
+            }
+            return error;
+        }
+
+        /// file_name returns the name of the file of the current or last batch.
+        [[nodiscard]] const std::string& file_name() const {
+            return file_name_;
+        }
+
+        /// last_error returns the errno value of the last failed operation, or 0 when no operation failed.
+        [[nodiscard]] int last_error() const {
+            return last_error_;
+        }
+
+        /// durability returns the durability policy, for example to retrieve its metrics.
+        durability_policy_type& durability() { return durability_; }
+    };
+
+    /// This type is a fd_file_factory_template using our file_name_generator.
+    using fd_file_factory = fd_file_factory_template<file_name_generator<>>;
+    /// This type is a fd_file_factory syncing every file with fdatasync in commit.
+    using fd_file_factory_fdatasync = fd_file_factory_template<file_name_generator<>,fdatasync_durability>;
+    /// This type is a fd_file_factory syncing files in groups with group_commit_durability. Pass a
+    /// group_commit_durability as first constructor argument to configure it.
+    using fd_file_factory_group_commit = fd_file_factory_template<file_name_generator<>,group_commit_durability>;
+    /// This type is a fd_file_factory removing every file from the page cache after it is written.
+    using fd_file_factory_uncached = fd_file_factory_template<file_name_generator<>,drop_page_cache>;
+    /// This type is a fd_file_factory syncing every file with fdatasync, renaming it to its name when it is durable and
+    /// syncing the directory, so the file is durable under its name when commit returns.
+    using fd_file_factory_atomic = fd_file_factory_template<file_name_generator<>,fdatasync_durability,publish_by_rename>;
+    /// This type is a fd_file_factory reserving the space of every batch with preallocate_batch before writing it.
+    using fd_file_factory_preallocated = fd_file_factory_template<file_name_generator<>,no_durability,publish_in_place,preallocate_batch>;
+}
+
+#endif
+
+#endif //LINE_BASED_WRITERS_FD_FILE_FACTORY_H
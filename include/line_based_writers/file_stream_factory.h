@@ -3,12 +3,30 @@
 
 #include <fstream>
 #include "macro_tool.h"
+#include "spill_policy.h"
+#include "posix_io.h"
 #include <chrono>
 #include <charconv>
 #include <ctime>
+#include <string_view>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <cerrno>
 
 namespace crosscode::line_based_writers {
 
+    /// to_utc converts time to broken down UTC time with the thread safe variant of std::gmtime.
+    inline void to_utc(std::time_t time, std::tm& tm) {
+#ifdef _WIN32
+        gmtime_s(&tm,&time);
+#else
+        gmtime_r(&time,&tm);
+#endif
+    }
+
     /// macro_handler contains logic for handling macros encountered during filename rendering.
     /// \tparam now The function to use for retrieving the current time. Replaceable to enable unit tests.
     template <auto now=std::chrono::system_clock::now>
@@ -16,6 +34,7 @@ namespace crosscode::line_based_writers {
         std::size_t counter_;
         std::chrono::system_clock::time_point current_time_point_;
         std::time_t time_;
+        std::tm tm_{};
 
         /// number_to_string converts a numeric type to a string
         /// \tparam T the type of the input parameter
@@ -60,20 +79,23 @@ namespace crosscode::line_based_writers {
         [[nodiscard]]
         std::string handle_date(const std::string& format) const {
             char buf[16]{};
-            strftime(buf,16,format.c_str(),std::gmtime(&time_));
+            strftime(buf,16,format.c_str(),&tm_);
             return buf;
         }
 
         public:
         /// macro_handler constructor Constructs a macro handler. The counter parameter determines the initial value of the counter.
         /// \param counter
-        explicit macro_handler(std::size_t counter) : counter_{counter}, current_time_point_{now()}, time_{std::chrono::system_clock::to_time_t(current_time_point_)} {}
+        explicit macro_handler(std::size_t counter) : counter_{counter}, current_time_point_{now()}, time_{std::chrono::system_clock::to_time_t(current_time_point_)} {
+            to_utc(time_,tm_);
+        }
 
         /// begin_render is called before a macro rendition of a string
         /// Can be used to fix values like date time or create resources.
         void begin_render() {
             current_time_point_ = now();
             time_ = std::chrono::system_clock::to_time_t(current_time_point_);
+            to_utc(time_,tm_);
         }
 
         /// done_render is called after a macro rendition of a string
@@ -104,39 +126,254 @@ namespace crosscode::line_based_writers {
 
     };
 
+    /// file_name_op is a single step of a compiled filename template.
+    struct file_name_op {
+        /// kind is the type of the step.
+        enum class kind { literal, counter, year, month, day, hour, minute, second };
+        kind kind_;
+        /// The text of a literal step.
+        std::string text_;
+        /// The minimum amount of digits of a numeric step.
+        std::size_t min_digits_{};
+    };
+
+    /// file_name_compiler is a macro handler that compiles a filename template into file_name_ops instead of
+    /// rendering it. Every macro is rendered as a NUL character marker and recorded as an op, so the literal text
+    /// between the markers in the rendered string are the literal steps. Filenames cannot contain NUL characters.
+    class file_name_compiler {
+        std::vector<file_name_op>* ops_;
+    public:
+        static constexpr char marker = '\0';
+
+        /// file_name_compiler constructor
+        /// \param ops The vector receiving an op for each macro, in order of appearance.
+        explicit file_name_compiler(std::vector<file_name_op>* ops) : ops_{ops} {}
+
+        void begin_render() {}
+        void done_render() {}
+
+        /// handle records an op for a macro. Unknown macros are not recorded and render empty, like macro_handler.
+        /// \param macro_name The name of the macro
+        /// \param macro_param The parameter of the macro
+        /// \return A marker when the macro is known, otherwise an empty string.
+        [[nodiscard]] std::string handle(std::string_view macro_name, std::string_view macro_param) const {
+            using kind = file_name_op::kind;
+            file_name_op op{kind::literal,{},2};
+            if (macro_name=="COUNTER" || macro_name=="NUM") {
+                op.kind_ = kind::counter;
+                op.min_digits_ = 1;
+                if (!macro_param.empty()) {
+                    std::size_t min_digits;
+                    auto[p, ec] = std::from_chars(std::data(macro_param), std::data(macro_param) + std::size(macro_param), min_digits);
+                    if (ec == std::errc()) {
+                        op.min_digits_ = min_digits;
+                    }
+                }
+            }
+            else if (macro_name=="YEAR") { op.kind_ = kind::year; op.min_digits_ = 1; }
+            else if (macro_name=="MONTH") op.kind_ = kind::month;
+            else if (macro_name=="DAY") op.kind_ = kind::day;
+            else if (macro_name=="HOUR") op.kind_ = kind::hour;
+            else if (macro_name=="MINUTE") op.kind_ = kind::minute;
+            else if (macro_name=="SECOND") op.kind_ = kind::second;
+            else return {};
+            ops_->push_back(std::move(op));
+            return std::string(1,marker);
+        }
+    };
+
     /// file_name_generator generates filenames based on templates.
+    /// The template is compiled once in the constructor into a sequence of file_name_ops, so generating a filename
+    /// does not look up macros by name. The broken down UTC time used by the date macros is cached and only
+    /// recalculated when the second changes. The supported macros are the same as those of macro_handler.
     /// \tparam now The function to use for retrieving the current time. Replaceable to enable unit tests.
     template <auto now=std::chrono::system_clock::now>
     class file_name_generator {
     public:
         using macro_handler_type = macro_handler<now>;
     private:
-        macro_tool::macro_render_engine<macro_handler_type> macro_generator_;
+        std::vector<file_name_op> ops_;
+        std::size_t counter_;
+        std::size_t size_hint_{};
+        bool uses_time_{false};
+        std::time_t time_{-1};
+        std::tm tm_{};
+
+        /// compile compiles the filename template into ops_.
+        void compile(std::string_view filename_tpl) {
+            std::vector<file_name_op> macros;
+            macro_tool::macro_render_engine<file_name_compiler> compiler{macro_tool::macro_lexer(filename_tpl),&macros};
+            auto rendered = compiler.render();
+            std::size_t pos{};
+            for (auto& macro : macros) {
+                auto marker = rendered.find(file_name_compiler::marker,pos);
+                if (marker>pos) ops_.push_back(file_name_op{file_name_op::kind::literal,rendered.substr(pos,marker-pos)});
+                uses_time_ = uses_time_ || macro.kind_!=file_name_op::kind::counter;
+                ops_.push_back(std::move(macro));
+                pos = marker+1;
+            }
+            if (pos<std::size(rendered)) ops_.push_back(file_name_op{file_name_op::kind::literal,rendered.substr(pos)});
+            for (const auto& op : ops_) {
+                size_hint_ += op.kind_==file_name_op::kind::literal ? std::size(op.text_) : std::max(op.min_digits_,std::size_t{4});
+            }
+        }
+
+        /// update_time refreshes the cached broken down time when the second changed since the last render.
+        void update_time() {
+            auto time = std::chrono::system_clock::to_time_t(now());
+            if (time==time_) return;
+            time_ = time;
+            to_utc(time_,tm_);
+        }
+
+        /// append_number appends a number to result, prefixed with zeros up to min_digits digits.
+        template <typename T>
+        static void append_number(std::string& result, T value, std::size_t min_digits) {
+            char buf[24];
+            auto[p, ec] = std::to_chars(std::begin(buf),std::end(buf),value);
+            auto digits = static_cast<std::size_t>(p-std::begin(buf));
+            if (min_digits>digits) result.append(min_digits-digits,'0');
+            result.append(std::begin(buf),digits);
+        }
     public:
         ///  file_name_generator constructs a filename generator based on a template provided with filename_tpl
         /// \param filename_tpl The filename template to use. See macro_handler for supported macros.
         /// \param counter The initial counter value to use with the macro_handler.
-        explicit file_name_generator(std::string_view filename_tpl,std::size_t counter=0) : macro_generator_{macro_tool::macro_lexer(filename_tpl),counter} {}
+        explicit file_name_generator(std::string_view filename_tpl,std::size_t counter=0) : counter_{counter} {
+            compile(filename_tpl);
+        }
 
         /// generate generates a filename
         std::string generate() {
-            return macro_generator_.render();
+            using kind = file_name_op::kind;
+            if (uses_time_) update_time();
+            std::string result;
+            result.reserve(size_hint_);
+            for (const auto& op : ops_) {
+                switch (op.kind_) {
+                    case kind::literal: result += op.text_; break;
+                    case kind::counter: append_number(result,counter_,op.min_digits_); break;
+                    case kind::year: append_number(result,tm_.tm_year+1900,op.min_digits_); break;
+                    case kind::month: append_number(result,tm_.tm_mon+1,op.min_digits_); break;
+                    case kind::day: append_number(result,tm_.tm_mday,op.min_digits_); break;
+                    case kind::hour: append_number(result,tm_.tm_hour,op.min_digits_); break;
+                    case kind::minute: append_number(result,tm_.tm_min,op.min_digits_); break;
+                    case kind::second: append_number(result,tm_.tm_sec,op.min_digits_); break;
+                }
+            }
+            counter_++;
+            return result;
         }
     };
 
+    /// Publish policies decide under which name a file is written and how it is published when it is complete.
+    /// A publish policy provides the following members:
+    /// - std::string temporary_name(const std::string& file_name) returns the name to write the file to.
+    /// - int publish(const std::string& temporary_name, const std::string& file_name) is called after the file is
+    ///   closed. Returns 0 on success, otherwise an errno value.
+
+    /// publish_in_place writes files under their final name. Readers can see a file while it is written. This is the
+    /// default.
+    struct publish_in_place {
+        [[nodiscard]] std::string temporary_name(const std::string& file_name) const {
+            return file_name;
+        }
+
+        int publish(const std::string&, const std::string&) const {
+            return 0;
+        }
+    };
+
+    /// publish_by_rename_template writes a file to a hidden temporary file in the same directory, named
+    /// .<filename>.tmp, and renames it to its final name when it is complete. The rename is atomic, so readers
+    /// watching the directory, for example with inotify, only see complete files under the final name.
+    /// \tparam sync_directory When true the directory is synced with posix_io::sync_directory after the rename, so the
+    /// rename survives a crash. Use it with factories syncing the data of a file before it is published. Ignored
+    /// where POSIX I/O is not available.
+    template <bool sync_directory>
+    struct publish_by_rename_template {
+        [[nodiscard]] std::string temporary_name(const std::string& file_name) const {
+            auto pos = file_name.find_last_of('/');
+            auto base = pos==std::string::npos ? 0 : pos+1;
+            return file_name.substr(0,base)+"."+file_name.substr(base)+".tmp";
+        }
+
+        int publish(const std::string& temporary_name, const std::string& file_name) const {
+            if (std::rename(temporary_name.c_str(),file_name.c_str())!=0) return errno;
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+            if constexpr (sync_directory) {
+                return posix_io::sync_directory(posix_io::parent_directory(file_name));
+            }
+#endif
+            return 0;
+        }
+    };
+
+    /// publish_by_rename renames complete files without syncing the directory.
+    using publish_by_rename = publish_by_rename_template<false>;
+    /// publish_by_durable_rename renames complete files and syncs the directory after the rename.
+    using publish_by_durable_rename = publish_by_rename_template<true>;
+
     /// file_stream_factory_template is a template for generating file streams.
     /// It is used with batch_stream_writer to generate a new stream for each batch to write.
     /// \tparam Tfile_name_generator The filename generator to use generating filenames.
     /// \tparam Tstream The stream type to be used. In production it is ofstream but it is replaced with a fake
     /// in the unit tests.
-    template <typename Tfile_name_generator, typename Tstream>
+    /// \tparam Tpublish_policy Decides under which name the file is written and how it is published in commit.
+    /// \tparam Tspill_policy Decides what happens with a batch that could not be written. With no_spill the lines are
+    /// written to the stream directly and a failed batch is lost. With memory_spill the lines of a batch are collected
+    /// in memory, written in commit and kept for a retry when the file could not be written.
+    template <typename Tfile_name_generator, typename Tstream, typename Tpublish_policy = publish_in_place, typename Tspill_policy = no_spill>
     class file_stream_factory_template {
     public:
         using file_name_generator_type = Tfile_name_generator;
         using stream_type = Tstream;
+        using publish_policy_type = Tpublish_policy;
+        using spill_policy_type = Tspill_policy;
     private:
         file_name_generator_type file_name_generator_;
         stream_type stream_;
+        publish_policy_type publish_policy_;
+        spill_policy_type spill_;
+        std::string file_name_;
+        std::string temporary_name_;
+        std::string batch_;
+        int open_error_{};
+        int last_error_{};
+
+        /// open opens the stream and returns the errno value when the file could not be opened, or 0.
+        int open(const std::string& file_name) {
+            errno = 0;
+            stream_.open(file_name,std::ios::trunc|std::ios::binary|std::ios_base::out);
+            if (stream_) return 0;
+            auto error = errno!=0 ? errno : EIO;
+            stream_.close();
+            stream_.clear();
+            return error;
+        }
+
+        /// write_file writes text to a file and publishes it. Used by spill policies, so a file is either written
+        /// completely or not published.
+        /// \return The errno value when the file could not be written or published, or 0.
+        int write_file(const std::string& file_name, std::string_view text) {
+            auto temporary_name = publish_policy_.temporary_name(file_name);
+            if (auto error = open(temporary_name); error!=0) return error;
+            errno = 0;
+            stream_.write(std::data(text),static_cast<std::streamsize>(std::size(text)));
+            stream_.flush();
+            auto error = !stream_ ? (errno!=0 ? errno : EIO) : 0;
+            stream_.close();
+            stream_.clear();
+            if (error!=0) {
+                if (temporary_name!=file_name) std::remove(temporary_name.c_str());
+                return error;
+            }
+            return publish_policy_.publish(temporary_name,file_name);
+        }
+
+        auto file_writer() {
+            return [this](const std::string& file_name, std::string_view text) { return write_file(file_name,text); };
+        }
     public:
 
         /// file_stream_factory_template constructor initializes the file_stream_factory_template using a forwarding
@@ -145,14 +382,33 @@ namespace crosscode::line_based_writers {
         /// \param args Expanded parameter pack arguments
         template <typename ...Args>
         explicit file_stream_factory_template(Args&&... args) : file_name_generator_{std::forward<Args>(args)...} {}
+        /// file_stream_factory_template constructor initializes the spill policy with spill and passes all other
+        /// arguments to the Tfile_name_generator constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param spill The spill policy.
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit file_stream_factory_template(spill_policy_type spill, Args&&... args) : file_name_generator_{std::forward<Args>(args)...}, spill_{std::move(spill)} {}
         file_stream_factory_template() = default;
-        file_stream_factory_template(file_stream_factory_template<file_name_generator_type,stream_type>&& rhs) noexcept : file_name_generator_{std::move(rhs.file_name_generator_)}, stream_(std::move(rhs.stream_)) { }
-        file_stream_factory_template(const file_stream_factory_template<file_name_generator_type,stream_type>&) = delete;
-        file_stream_factory_template<file_name_generator_type,stream_type>&operator=(const file_stream_factory_template<file_name_generator_type,stream_type>&) = delete;
+        file_stream_factory_template(file_stream_factory_template<file_name_generator_type,stream_type,publish_policy_type,spill_policy_type>&& rhs) noexcept : file_name_generator_{std::move(rhs.file_name_generator_)}, stream_(std::move(rhs.stream_)), publish_policy_{std::move(rhs.publish_policy_)}, spill_{std::move(rhs.spill_)}, file_name_{std::move(rhs.file_name_)}, temporary_name_{std::move(rhs.temporary_name_)}, batch_{std::move(rhs.batch_)}, open_error_{rhs.open_error_}, last_error_{rhs.last_error_} { }
+        file_stream_factory_template(const file_stream_factory_template<file_name_generator_type,stream_type,publish_policy_type,spill_policy_type>&) = delete;
+        file_stream_factory_template<file_name_generator_type,stream_type,publish_policy_type,spill_policy_type>&operator=(const file_stream_factory_template<file_name_generator_type,stream_type,publish_policy_type,spill_policy_type>&) = delete;
+        /// The destructor makes a last attempt to write the spilled batches.
+        ~file_stream_factory_template() {
+            if constexpr (spill_policy_type::enabled) {
+                spill_.flush(file_writer());
+            }
+        }
 
         /// begin is called when a new stream should be created.
         void begin() {
-            stream_.open(file_name_generator_.generate(),std::ios::trunc|std::ios::binary|std::ios_base::out);
+            file_name_ = file_name_generator_.generate();
+            if constexpr (spill_policy_type::enabled) {
+                batch_.clear();
+            } else {
+                temporary_name_ = publish_policy_.temporary_name(file_name_);
+                open_error_ = open(temporary_name_);
+            }
         }
 
         /// write write a line to the currently open stream
@@ -160,14 +416,208 @@ namespace crosscode::line_based_writers {
         /// \param line The line to write
         template<typename Tline>
         void write(Tline &&line) {
-            stream_ << line << "\n";
+            if constexpr (spill_policy_type::enabled) {
+                batch_ += std::string_view{line};
+                batch_ += '\n';
+            } else {
+                stream_ << line << "\n";
+            }
+        }
+
+        /// write_text writes complete lines that are each followed by a line separator.
+        /// \param text The lines to write.
+        void write_text(std::string_view text) {
+            if constexpr (spill_policy_type::enabled) {
+                batch_ += text;
+            } else {
+                stream_.write(std::data(text),static_cast<std::streamsize>(std::size(text)));
+            }
         }
 
-        /// commit is called when writing to the stream has been completed
+        /// commit is called when writing to the stream has been completed. It closes the stream and publishes the file.
+        /// A file that could not be written completely is not published. When it was written to a temporary file,
+        /// the temporary file is removed. With an enabled spill policy, commit writes the batch and passes it to the
+        /// spill policy when it could not be written.
         void commit() {
+            if constexpr (spill_policy_type::enabled) {
+                if (auto error = spill_.commit(file_name_,batch_,file_writer()); error!=0) {
+                    last_error_ = error;
+                }
+                return;
+            }
             stream_.flush();
+            auto failed = open_error_!=0 || !stream_;
             stream_.close();
             stream_.clear();
+            if (failed) {
+                last_error_ = open_error_!=0 ? open_error_ : EIO;
+                if (temporary_name_!=file_name_) std::remove(temporary_name_.c_str());
+            } else if (auto error = publish_policy_.publish(temporary_name_,file_name_); error!=0) {
+                last_error_ = error;
+            }
+        }
+
+        /// retry writes spilled batches when their retry is due, up to the limit of the spill policy. It is called by
+        /// every commit, call it when no batches are written for a while.
+        /// \return The errno value of a failed retry, or 0.
+        int retry() {
+            if constexpr (spill_policy_type::enabled) {
+                return spill_.retry(file_writer());
+            }
+            return 0;
+        }
+
+        /// file_name returns the name of the file of the current or last batch.
+        [[nodiscard]] const std::string& file_name() const {
+            return file_name_;
+        }
+
+        /// last_error returns the errno value when opening a file failed, EIO when writing a file failed, the errno value
+        /// of a failed publish, or 0 when no file failed.
+        [[nodiscard]] int last_error() const {
+            return last_error_;
+        }
+
+        /// spill returns the spill policy.
+        [[nodiscard]] const spill_policy_type& spill() const {
+            return spill_;
+        }
+
+#ifdef CROSSCODE_ACCESS_TO_UNIT_TEST
+        /// returns the underlying stream. It is used for unit tests only.
+        const stream_type& underlying_stream() const {
+            return stream_;
+        }
+#endif
+    };
+
+    /// file_rotation contains the thresholds for rotating the file of a rotating_file_stream_factory_template.
+    struct file_rotation {
+        /// The size in bytes after which the file is rotated. 0 disables rotating on size.
+        std::size_t max_bytes{};
+        /// The age of the file after which the file is rotated. Zero disables rotating on age.
+        std::chrono::steady_clock::duration max_age{};
+    };
+
+    /// rotating_file_stream_factory_template is a template for file streams that are kept open across batches.
+    /// It is used with batch_stream_writer. Unlike file_stream_factory_template, which creates a file for each batch,
+    /// it appends batches to the same file and only opens a new file when the file reaches the size or age thresholds
+    /// of file_rotation. The file name of a new file is rendered with the file name generator.
+    /// The file is flushed after every batch and closed when the thresholds are reached after a batch, so a file is
+    /// complete once the next file is created.
+    /// When a file cannot be opened, the batch is discarded, last_error returns the errno value and the next batch
+    /// opens a new file. When a batch cannot be written, the file is closed and the next batch opens a new file.
+    /// \tparam Tfile_name_generator The filename generator to use generating filenames.
+    /// \tparam Tstream The stream type to be used. In production it is ofstream but it is replaced with a fake
+    /// in the unit tests.
+    /// \tparam now The function to use for retrieving the current time. Replaceable to enable unit tests.
+    template <typename Tfile_name_generator, typename Tstream, auto now=std::chrono::steady_clock::now>
+    class rotating_file_stream_factory_template {
+    public:
+        using file_name_generator_type = Tfile_name_generator;
+        using stream_type = Tstream;
+    private:
+        file_rotation rotation_;
+        file_name_generator_type file_name_generator_;
+        stream_type stream_;
+        std::string file_name_;
+        bool open_{false};
+        std::size_t bytes_{};
+        decltype(now()) opened_at_{};
+        int last_error_{};
+
+        /// rotation_due returns true when the open file reached one of the rotation thresholds.
+        [[nodiscard]] bool rotation_due() const {
+            if (rotation_.max_bytes!=0 && bytes_>=rotation_.max_bytes) return true;
+            return rotation_.max_age!=decltype(rotation_.max_age){} && now()-opened_at_>=rotation_.max_age;
+        }
+
+        void close() {
+            stream_.close();
+            stream_.clear();
+            open_ = false;
+        }
+    public:
+
+        /// rotating_file_stream_factory_template constructor initializes the rotating_file_stream_factory_template
+        /// using a forwarding reference. It will pass all arguments after rotation to the Tfile_name_generator
+        /// constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param rotation The thresholds for rotating the file.
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit rotating_file_stream_factory_template(file_rotation rotation, Args&&... args) : rotation_{rotation}, file_name_generator_{std::forward<Args>(args)...} {}
+        rotating_file_stream_factory_template(rotating_file_stream_factory_template<file_name_generator_type,stream_type,now>&& rhs) noexcept : rotation_{rhs.rotation_}, file_name_generator_{std::move(rhs.file_name_generator_)}, stream_(std::move(rhs.stream_)), file_name_{std::move(rhs.file_name_)}, open_{rhs.open_}, bytes_{rhs.bytes_}, opened_at_{rhs.opened_at_}, last_error_{rhs.last_error_} { rhs.open_ = false; }
+        rotating_file_stream_factory_template(const rotating_file_stream_factory_template<file_name_generator_type,stream_type,now>&) = delete;
+        rotating_file_stream_factory_template<file_name_generator_type,stream_type,now>&operator=(const rotating_file_stream_factory_template<file_name_generator_type,stream_type,now>&) = delete;
+
+        /// begin is called when a batch is going to be written. It opens a new file when no file is open or when the
+        /// open file is too old.
+        void begin() {
+            if (open_ && rotation_due()) {
+                close();
+            }
+            if (!open_) {
+                file_name_ = file_name_generator_.generate();
+                errno = 0;
+                stream_.open(file_name_,std::ios::trunc|std::ios::binary|std::ios_base::out);
+                if (!stream_) {
+                    last_error_ = errno!=0 ? errno : EIO;
+                    close();
+                    return;
+                }
+                open_ = true;
+                bytes_ = 0;
+                opened_at_ = now();
+            }
+        }
+
+        /// write write a line to the currently open stream
+        /// \tparam Tline The type of the line to write
+        /// \param line The line to write
+        template<typename Tline>
+        void write(Tline &&line) {
+            if (!open_) return;
+            std::string_view bytes{line};
+            stream_ << bytes << "\n";
+            bytes_ += std::size(bytes)+1;
+        }
+
+        /// write_text writes complete lines that are each followed by a line separator.
+        /// \param text The lines to write.
+        void write_text(std::string_view text) {
+            if (!open_) return;
+            stream_.write(std::data(text),static_cast<std::streamsize>(std::size(text)));
+            bytes_ += std::size(text);
+        }
+
+        /// commit is called when a batch has been written. It flushes the stream and closes the file when it reached
+        /// one of the rotation thresholds or when the batch could not be written.
+        void commit() {
+            if (!open_) return;
+            errno = 0;
+            stream_.flush();
+            if (!stream_) {
+                last_error_ = errno!=0 ? errno : EIO;
+                close();
+            } else if (rotation_due()) {
+                close();
+            }
+        }
+
+        /// file_name returns the name of the open file, or of the last file when it was closed.
+        [[nodiscard]] const std::string& file_name() const {
+            return file_name_;
+        }
+
+        /// bytes returns the amount of bytes written to the open file.
+        [[nodiscard]] std::size_t bytes() const {
+            return bytes_;
+        }
+
+        /// last_error returns the errno value of the last failed open or write, or 0 when nothing failed.
+        [[nodiscard]] int last_error() const {
+            return last_error_;
         }
 
 #ifdef CROSSCODE_ACCESS_TO_UNIT_TEST
@@ -183,6 +633,16 @@ namespace crosscode::line_based_writers {
     using file_stream_factory_no_stream = file_stream_factory_template<file_name_generator<>,Tstream>;
     /// This type contains is a file_stream_factory using our file_name_generator and ofstream as underlying_stream.
     using file_stream_factory = file_stream_factory_no_stream<std::ofstream>;
+    /// This type is a file_stream_factory that writes to a temporary file and renames it to its name in commit.
+    using file_stream_factory_atomic = file_stream_factory_template<file_name_generator<>,std::ofstream,publish_by_rename>;
+    /// This type is a file_stream_factory_atomic that keeps batches that could not be written in memory and retries them.
+    using file_stream_factory_spilling = file_stream_factory_template<file_name_generator<>,std::ofstream,publish_by_rename,memory_spill>;
+
+    /// This type is a rotating_file_stream_factory_template using our file_name_generator. This type is used for unit tests.
+    template <typename Tstream, auto now=std::chrono::steady_clock::now>
+    using rotating_file_stream_factory_no_stream = rotating_file_stream_factory_template<file_name_generator<>,Tstream,now>;
+    /// This type is a rotating_file_stream_factory using our file_name_generator and ofstream as underlying_stream.
+    using rotating_file_stream_factory = rotating_file_stream_factory_no_stream<std::ofstream>;
 }
 
 #endif //LINE_BASED_WRITERS_FILE_STREAM_FACTORY_H
@@ -0,0 +1,70 @@
+#ifndef LINE_BASED_WRITERS_FLUSH_TIMER_H
+#define LINE_BASED_WRITERS_FLUSH_TIMER_H
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+namespace crosscode::line_based_writers {
+
+    /// flush_timer periodically calls poll on a thread safe line buffer from a dedicated thread.
+    /// Combined with a time based segment policy like max_age_policy this bounds the time lines stay buffered, also
+    /// when no lines are written.
+    /// The line buffer must outlive the flush_timer and poll must be thread safe, so use it with line_buffer_ts,
+    /// sharded_line_buffer or async_line_buffer.
+    /// \tparam Tline_buffer The type of the line buffer to poll.
+    template<typename Tline_buffer>
+    class flush_timer {
+    public:
+        using line_buffer_type = Tline_buffer;
+        using duration = std::chrono::steady_clock::duration;
+    private:
+        /// state contains everything shared with the timer thread. It lives on the heap so flush_timer is movable.
+        struct state {
+            line_buffer_type& line_buffer_;
+            duration interval_;
+            std::mutex mutex_;
+            std::condition_variable stopped_;
+            bool stop_{false};
+            std::thread thread_;
+
+            state(line_buffer_type& line_buffer, duration interval) : line_buffer_{line_buffer}, interval_{interval} {}
+        };
+
+        std::unique_ptr<state> state_;
+
+        static void run(state& s) {
+            std::unique_lock lock{s.mutex_};
+            while (!s.stopped_.wait_for(lock,s.interval_,[&s]{ return s.stop_; })) {
+                lock.unlock();
+                s.line_buffer_.poll();
+                lock.lock();
+            }
+        }
+    public:
+        /// flush_timer constructor starts the timer thread.
+        /// \param line_buffer The line buffer to poll.
+        /// \param interval The time between two polls. Use a fraction of the maximum age of the segment policy.
+        flush_timer(line_buffer_type& line_buffer, duration interval) : state_{std::make_unique<state>(line_buffer,interval)} {
+            state_->thread_ = std::thread{run,std::ref(*state_)};
+        }
+        flush_timer(flush_timer<line_buffer_type>&& rhs) noexcept : state_{std::move(rhs.state_)} {}
+        flush_timer(const flush_timer<line_buffer_type>&) = delete;
+        flush_timer<line_buffer_type>&operator=(const flush_timer<line_buffer_type>&) = delete;
+
+        ~flush_timer() {
+            if (!state_) return;
+            {
+                std::scoped_lock lock{state_->mutex_};
+                state_->stop_ = true;
+            }
+            state_->stopped_.notify_one();
+            state_->thread_.join();
+        }
+    };
+
+}
+
+#endif //LINE_BASED_WRITERS_FLUSH_TIMER_H
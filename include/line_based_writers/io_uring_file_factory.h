@@ -0,0 +1,539 @@
+#ifndef LINE_BASED_WRITERS_IO_URING_FILE_FACTORY_H
+#define LINE_BASED_WRITERS_IO_URING_FILE_FACTORY_H
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define LINE_BASED_WRITERS_HAS_IO_URING 1
+
+#include "file_stream_factory.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <initializer_list>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+namespace crosscode::line_based_writers {
+
+    /// io_uring_ring is a minimal io_uring submission and completion ring using raw system calls, so no liburing is
+    /// required. It is used by io_uring_file_factory_template.
+    class io_uring_ring {
+        int fd_{-1};
+        void* sq_ptr_{MAP_FAILED};
+        std::size_t sq_size_{};
+        void* cq_ptr_{MAP_FAILED};
+        std::size_t cq_size_{};
+        io_uring_sqe* sqes_{static_cast<io_uring_sqe*>(MAP_FAILED)};
+        std::size_t sqes_size_{};
+        unsigned* sq_head_{};
+        unsigned* sq_tail_{};
+        unsigned* sq_mask_{};
+        unsigned* sq_array_{};
+        unsigned sq_entries_{};
+        unsigned* cq_head_{};
+        unsigned* cq_tail_{};
+        unsigned* cq_mask_{};
+        io_uring_cqe* cqes_{};
+        unsigned pending_{};
+        std::size_t enters_{};
+
+        void release() noexcept {
+            if (sqes_!=MAP_FAILED) ::munmap(sqes_,sqes_size_);
+            if (cq_ptr_!=MAP_FAILED && cq_ptr_!=sq_ptr_) ::munmap(cq_ptr_,cq_size_);
+            if (sq_ptr_!=MAP_FAILED) ::munmap(sq_ptr_,sq_size_);
+            if (fd_>=0) ::close(fd_);
+            fd_ = -1;
+            sq_ptr_ = cq_ptr_ = MAP_FAILED;
+            sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+        }
+
+        template <typename T>
+        static T* at(void* base, unsigned offset) {
+            return reinterpret_cast<T*>(static_cast<char*>(base)+offset);
+        }
+    public:
+        /// io_uring_ring constructor sets up a ring. Check valid to see if io_uring is available.
+        /// \param entries The amount of submission queue entries.
+        explicit io_uring_ring(unsigned entries) {
+            io_uring_params p{};
+            fd_ = static_cast<int>(::syscall(__NR_io_uring_setup,entries,&p));
+            if (fd_<0) return;
+            sq_size_ = p.sq_off.array+p.sq_entries*sizeof(unsigned);
+            cq_size_ = p.cq_off.cqes+p.cq_entries*sizeof(io_uring_cqe);
+            if (p.features & IORING_FEAT_SINGLE_MMAP) {
+                sq_size_ = cq_size_ = std::max(sq_size_,cq_size_);
+            }
+            sq_ptr_ = ::mmap(nullptr,sq_size_,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd_,IORING_OFF_SQ_RING);
+            if (sq_ptr_==MAP_FAILED) { release(); return; }
+            if (p.features & IORING_FEAT_SINGLE_MMAP) {
+                cq_ptr_ = sq_ptr_;
+            } else {
+                cq_ptr_ = ::mmap(nullptr,cq_size_,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd_,IORING_OFF_CQ_RING);
+                if (cq_ptr_==MAP_FAILED) { release(); return; }
+            }
+            sqes_size_ = p.sq_entries*sizeof(io_uring_sqe);
+            sqes_ = static_cast<io_uring_sqe*>(::mmap(nullptr,sqes_size_,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd_,IORING_OFF_SQES));
+            if (sqes_==MAP_FAILED) { release(); return; }
+            sq_head_ = at<unsigned>(sq_ptr_,p.sq_off.head);
+            sq_tail_ = at<unsigned>(sq_ptr_,p.sq_off.tail);
+            sq_mask_ = at<unsigned>(sq_ptr_,p.sq_off.ring_mask);
+            sq_array_ = at<unsigned>(sq_ptr_,p.sq_off.array);
+            sq_entries_ = p.sq_entries;
+            cq_head_ = at<unsigned>(cq_ptr_,p.cq_off.head);
+            cq_tail_ = at<unsigned>(cq_ptr_,p.cq_off.tail);
+            cq_mask_ = at<unsigned>(cq_ptr_,p.cq_off.ring_mask);
+            cqes_ = at<io_uring_cqe>(cq_ptr_,p.cq_off.cqes);
+        }
+        io_uring_ring(io_uring_ring&& rhs) noexcept :
+            fd_{std::exchange(rhs.fd_,-1)}, sq_ptr_{std::exchange(rhs.sq_ptr_,MAP_FAILED)}, sq_size_{rhs.sq_size_},
+            cq_ptr_{std::exchange(rhs.cq_ptr_,MAP_FAILED)}, cq_size_{rhs.cq_size_},
+            sqes_{std::exchange(rhs.sqes_,static_cast<io_uring_sqe*>(MAP_FAILED))}, sqes_size_{rhs.sqes_size_},
+            sq_head_{rhs.sq_head_}, sq_tail_{rhs.sq_tail_}, sq_mask_{rhs.sq_mask_}, sq_array_{rhs.sq_array_},
+            sq_entries_{rhs.sq_entries_}, cq_head_{rhs.cq_head_}, cq_tail_{rhs.cq_tail_}, cq_mask_{rhs.cq_mask_},
+            cqes_{rhs.cqes_}, pending_{rhs.pending_}, enters_{rhs.enters_} {}
+        io_uring_ring& operator=(io_uring_ring&&) = delete;
+        io_uring_ring(const io_uring_ring&) = delete;
+        io_uring_ring& operator=(const io_uring_ring&) = delete;
+
+        ~io_uring_ring() {
+            release();
+        }
+
+        /// valid returns true when the ring was set up successfully.
+        [[nodiscard]] bool valid() const { return fd_>=0; }
+
+        /// supports returns true when the kernel supports all operations. Kernels older than 5.6 cannot be probed and
+        /// are reported as not supporting any operation.
+        /// \param ops The io_uring operation codes to check.
+        [[nodiscard]] bool supports(std::initializer_list<unsigned> ops) const {
+            if (!valid()) return false;
+            constexpr unsigned max_ops = 256;
+            std::vector<char> buffer(sizeof(io_uring_probe)+max_ops*sizeof(io_uring_probe_op));
+            auto* probe = reinterpret_cast<io_uring_probe*>(std::data(buffer));
+            if (::syscall(__NR_io_uring_register,fd_,IORING_REGISTER_PROBE,probe,max_ops)<0) return false;
+            return std::all_of(std::begin(ops),std::end(ops),[probe](unsigned op){
+                return op<=probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+            });
+        }
+
+        /// get_sqe returns a cleared submission queue entry, or nullptr when the submission queue is full.
+        io_uring_sqe* get_sqe() {
+            auto tail = *sq_tail_;
+            if (tail-__atomic_load_n(sq_head_,__ATOMIC_ACQUIRE)>=sq_entries_) return nullptr;
+            auto index = tail & *sq_mask_;
+            auto* sqe = &sqes_[index];
+            std::memset(static_cast<void*>(sqe),0,sizeof(io_uring_sqe));
+            sq_array_[index] = index;
+            __atomic_store_n(sq_tail_,tail+1,__ATOMIC_RELEASE);
+            pending_++;
+            return sqe;
+        }
+
+        /// submit submits all queued entries with a single system call. No system call is made when no entries are
+        /// queued and no completions are awaited.
+        /// \param wait_for The amount of completions to wait for.
+        /// \return 0 on success, otherwise the errno value.
+        int submit(unsigned wait_for = 0) {
+            if (pending_==0 && wait_for==0) return 0;
+            for (;;) {
+                enters_++;
+                auto r = ::syscall(__NR_io_uring_enter,fd_,pending_,wait_for,wait_for>0 ? IORING_ENTER_GETEVENTS : 0u,nullptr,0);
+                if (r>=0) {
+                    pending_ -= std::min(pending_,static_cast<unsigned>(r));
+                    return 0;
+                }
+                if (errno!=EINTR) return errno;
+            }
+        }
+
+        /// space returns the amount of free entries in the submission queue.
+        [[nodiscard]] unsigned space() const {
+            return sq_entries_-(*sq_tail_-__atomic_load_n(sq_head_,__ATOMIC_ACQUIRE));
+        }
+
+        /// pending returns the amount of entries that are queued, but not submitted.
+        [[nodiscard]] unsigned pending() const { return pending_; }
+
+        /// discard removes the queued entries that were not submitted from the submission queue and calls handler
+        /// with the user_data of each, oldest first. The kernel only takes entries from the queue in submit, so this
+        /// is safe after a failed submit.
+        /// \param handler Called with the user_data of each removed entry.
+        template <typename Thandler>
+        void discard(Thandler&& handler) {
+            auto head = __atomic_load_n(sq_head_,__ATOMIC_ACQUIRE);
+            for (auto i=head;i!=*sq_tail_;i++) {
+                handler(sqes_[i & *sq_mask_].user_data);
+            }
+            __atomic_store_n(sq_tail_,head,__ATOMIC_RELEASE);
+            pending_ = 0;
+        }
+
+        /// enters returns the amount of io_uring_enter system calls made by submit.
+        [[nodiscard]] std::size_t enters() const { return enters_; }
+
+        /// reap calls handler for each available completion queue entry.
+        /// \param handler Called with the user_data and result of each completion.
+        template <typename Thandler>
+        void reap(Thandler&& handler) {
+            auto head = *cq_head_;
+            for (;;) {
+                auto tail = __atomic_load_n(cq_tail_,__ATOMIC_ACQUIRE);
+                if (head==tail) break;
+                const auto& cqe = cqes_[head & *cq_mask_];
+                auto user_data = cqe.user_data;
+                auto res = cqe.res;
+                head++;
+                __atomic_store_n(cq_head_,head,__ATOMIC_RELEASE);
+                handler(user_data,res);
+            }
+        }
+    };
+
+    /// io_uring_options configures io_uring_file_factory_template.
+    struct io_uring_options {
+        /// The maximum amount of segments being written at the same time. begin blocks when this is reached.
+        std::size_t max_in_flight{16};
+        /// The amount of committed segments that are submitted together with one system call. With more than one, up
+        /// to submit_batch-1 committed segments are not submitted until the batch is full, wait is called or the
+        /// factory is destroyed.
+        std::size_t submit_batch{1};
+        /// When true every segment is synced to disk with fsync before it is closed.
+        bool fsync{false};
+        /// When false the synchronous fallback is used, even when io_uring is available.
+        bool use_io_uring{true};
+    };
+
+    /// io_uring_file_factory_template is a template for writing batches to files asynchronously with io_uring.
+    /// It is used with batch_stream_writer as an alternative for file_stream_factory_template. Each batch is copied to
+    /// a segment buffer. commit opens the file and queues the write, optional fsync and close of the segment as one
+    /// chain of linked io_uring operations, while the caller continues filling the next line buffer. The chains of
+    /// submit_batch committed segments are submitted together with one system call. Once submitted, the kernel runs
+    /// a chain to completion on its own. With submit_batch 1, the last segment of a writer that stops writing is
+    /// written without further calls; with a larger submit_batch, call wait to submit the remaining segments.
+    /// begin only processes completions without a system call, unless max_in_flight segments are in flight, in which
+    /// case it submits the queued chains and blocks until a segment completes. Segment buffers are reused, so steady
+    /// state writing does not allocate.
+    /// Files are opened synchronously in commit, not with IORING_OP_OPENAT: the operations of a linked chain cannot
+    /// use the descriptor returned by an earlier operation of the chain without registered files, so the open would
+    /// need a system call and a round trip of its own.
+    /// When io_uring is not available, for example because the kernel is too old or it is blocked by a seccomp policy,
+    /// the segments are written synchronously in commit instead. A segment that does not fit in the submission queue,
+    /// or whose operations cannot be submitted, is also written synchronously.
+    /// Errors are reported by last_error, which returns the errno value of the last failed operation.
+    /// \tparam Tfile_name_generator The filename generator to use generating filenames.
+    template <typename Tfile_name_generator>
+    class io_uring_file_factory_template {
+    public:
+        using file_name_generator_type = Tfile_name_generator;
+    private:
+        /// operation identifies the operation of a completion. It is stored in the low bits of the user_data.
+        enum class operation : std::uint64_t { write, sync, close };
+
+        /// segment is a batch that is being written.
+        struct segment {
+            std::string file_name;
+            std::string data;
+            std::size_t written{};
+            std::size_t operations{};
+            int fd{-1};
+            int error{};
+        };
+
+        static constexpr std::size_t max_write = std::size_t{1}<<30u;
+
+        io_uring_options options_;
+        file_name_generator_type file_name_generator_;
+        std::vector<segment> segments_;
+        std::vector<std::size_t> free_;
+        segment fallback_;
+        /// The ring is declared after the segments, so it is closed before the segment buffers are freed.
+        io_uring_ring ring_;
+        bool use_fallback_{false};
+        std::size_t current_{};
+        std::size_t in_flight_{};
+        std::size_t committed_{};
+        int last_error_{};
+
+        segment& current() {
+            return use_fallback_ ? fallback_ : segments_[current_];
+        }
+
+        /// finish closes the file of a segment when it is still open, reports its error and releases it.
+        void finish(segment& s) {
+            if (s.fd>=0) {
+                ::close(s.fd);
+                s.fd = -1;
+            }
+            if (s.error!=0) {
+                last_error_ = s.error;
+            }
+            s.data.clear();
+            s.written = 0;
+            s.error = 0;
+            if (&s==&fallback_) {
+                use_fallback_ = false;
+                return;
+            }
+            in_flight_--;
+            free_.push_back(static_cast<std::size_t>(&s-std::data(segments_)));
+        }
+
+        /// queue_chain queues the remaining writes, the optional fsync and the close of a segment as one chain of
+        /// linked operations.
+        /// \return false when the submission queue has no room for the chain.
+        bool queue_chain(segment& s) {
+            auto writes = (std::size(s.data)-s.written+max_write-1)/max_write;
+            auto count = writes+(options_.fsync ? 2 : 1);
+            if (ring_.space()<count && (ring_.submit(0)!=0 || ring_.space()<count)) return false;
+            auto index = static_cast<std::uint64_t>(&s-std::data(segments_))<<2u;
+            auto add = [this,index](operation op, int fd) {
+                auto* sqe = ring_.get_sqe();
+                sqe->user_data = index|static_cast<std::uint64_t>(op);
+                sqe->fd = fd;
+                sqe->flags = IOSQE_IO_LINK;
+                return sqe;
+            };
+            for (auto offset=s.written;offset<std::size(s.data);offset+=max_write) {
+                auto* sqe = add(operation::write,s.fd);
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->addr = reinterpret_cast<std::uintptr_t>(std::data(s.data)+offset);
+                sqe->len = static_cast<std::uint32_t>(std::min(std::size(s.data)-offset,max_write));
+                sqe->off = offset;
+            }
+            if (options_.fsync) {
+                add(operation::sync,s.fd)->opcode = IORING_OP_FSYNC;
+            }
+            auto* sqe = add(operation::close,s.fd);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->flags = 0;
+            s.operations = count;
+            return true;
+        }
+
+        /// complete processes the completion of an operation of a segment. The segment is released when all operations
+        /// of its chain completed. A short write cancels the rest of the chain, the remainder is queued again.
+        void complete(segment& s, operation op, int res) {
+            s.operations--;
+            if (res<0) {
+                if (res!=-ECANCELED && s.error==0) s.error = -res;
+                if (op==operation::close && res!=-ECANCELED) s.fd = -1;
+            } else if (op==operation::write) {
+                if (res==0 && s.error==0) s.error = EIO;
+                s.written += static_cast<std::size_t>(res);
+            } else if (op==operation::close) {
+                s.fd = -1;
+            }
+            if (s.operations>0) return;
+            if (s.error==0 && s.fd>=0) {
+                if (s.written<std::size(s.data) && queue_chain(s)) return;
+                write_sync(s);
+                return;
+            }
+            finish(s);
+        }
+
+        /// discard processes an operation of a segment that was removed from the submission queue after a failed
+        /// submit. When no other operation of the segment is in flight, the rest of the segment is written
+        /// synchronously.
+        void discard(segment& s) {
+            if (--s.operations>0) return;
+            if (s.error==0 && s.fd>=0) {
+                write_sync(s);
+                return;
+            }
+            finish(s);
+        }
+
+        /// reap processes the available completions without a system call.
+        void reap() {
+            ring_.reap([this](std::uint64_t user_data, int res){
+                complete(segments_[user_data>>2u],static_cast<operation>(user_data & 3u),res);
+            });
+        }
+
+        /// process submits queued operations and processes completions. When the operations cannot be submitted, the
+        /// chains that were not submitted are removed from the submission queue and written synchronously.
+        /// \param wait_for The amount of completions to wait for.
+        /// \return 0 on success, otherwise the errno value of the failed submit.
+        int process(unsigned wait_for) {
+            auto error = ring_.submit(wait_for);
+            if (error!=0) {
+                last_error_ = error;
+                ring_.discard([this](std::uint64_t user_data){ discard(segments_[user_data>>2u]); });
+            }
+            committed_ = 0;
+            reap();
+            return error;
+        }
+
+        /// open opens the file of a segment.
+        /// \return false when the file could not be opened.
+        bool open(segment& s) {
+            s.fd = ::open(s.file_name.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0666);
+            if (s.fd>=0) return true;
+            s.fd = -1;
+            s.error = errno;
+            finish(s);
+            return false;
+        }
+
+        /// write_sync writes the rest of a segment synchronously. Used when io_uring is not available.
+        void write_sync(segment& s) {
+            if (s.fd<0 && !open(s)) return;
+            iovec iov{std::data(s.data)+s.written,std::size(s.data)-s.written};
+            if (auto error = posix_write_all(s.fd,&iov); error!=0) {
+                s.error = error;
+            } else if (options_.fsync && ::fsync(s.fd)!=0) {
+                s.error = errno;
+            }
+            if (::close(s.fd)!=0 && s.error==0) {
+                s.error = errno;
+            }
+            s.fd = -1;
+            finish(s);
+        }
+
+        static int posix_write_all(int fd, iovec* iov) {
+            while (iov->iov_len>0) {
+                auto n = ::write(fd,iov->iov_base,iov->iov_len);
+                if (n<0) {
+                    if (errno==EINTR) continue;
+                    return errno;
+                }
+                iov->iov_base = static_cast<char*>(iov->iov_base)+n;
+                iov->iov_len -= static_cast<std::size_t>(n);
+            }
+            return 0;
+        }
+
+        void init() {
+            if (options_.use_io_uring && !ring_.supports({IORING_OP_WRITE,IORING_OP_FSYNC,IORING_OP_CLOSE})) {
+                options_.use_io_uring = false;
+            }
+            options_.max_in_flight = std::max(options_.max_in_flight,std::size_t{1});
+            options_.submit_batch = std::clamp(options_.submit_batch,std::size_t{1},options_.max_in_flight);
+            segments_.resize(options_.use_io_uring && ring_.valid() ? options_.max_in_flight : 1);
+            for (std::size_t i=std::size(segments_);i>0;i--) {
+                free_.push_back(i-1);
+            }
+        }
+    public:
+
+        /// io_uring_file_factory_template constructor initializes the io_uring_file_factory_template using a
+        /// forwarding reference. It will pass all arguments after options to the Tfile_name_generator constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param options The io_uring options.
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit io_uring_file_factory_template(io_uring_options options, Args&&... args) : options_{options}, file_name_generator_{std::forward<Args>(args)...}, ring_{static_cast<unsigned>(options.use_io_uring ? 4*std::max(options.max_in_flight,std::size_t{1}) : 1)} {
+            init();
+        }
+        io_uring_file_factory_template(io_uring_file_factory_template<file_name_generator_type>&& rhs) noexcept = default;
+        io_uring_file_factory_template(const io_uring_file_factory_template<file_name_generator_type>&) = delete;
+        io_uring_file_factory_template<file_name_generator_type>&operator=(const io_uring_file_factory_template<file_name_generator_type>&) = delete;
+
+        ~io_uring_file_factory_template() {
+            wait();
+        }
+
+        /// begin is called when a new segment should be created. It processes completed operations and blocks while
+        /// max_in_flight segments are in flight. When the operations cannot be submitted, the segment is written
+        /// synchronously instead.
+        void begin() {
+            if (uses_io_uring()) {
+                reap();
+                int error{};
+                while (free_.empty() && error==0) {
+                    error = process(1);
+                }
+                if (free_.empty()) {
+                    use_fallback_ = true;
+                    fallback_.file_name = file_name_generator_.generate();
+                    return;
+                }
+            }
+            current_ = free_.back();
+            free_.pop_back();
+            in_flight_++;
+            auto& s = segments_[current_];
+            s.file_name = file_name_generator_.generate();
+        }
+
+        /// write appends a line to the segment buffer.
+        /// \tparam Tline The type of the line to write
+        /// \param line The line to write
+        template<typename Tline>
+        void write(Tline &&line) {
+            auto& data = current().data;
+            data.append(std::string_view{line});
+            data.push_back('\n');
+        }
+
+        /// write_text adds complete lines that are each followed by a line separator to the segment.
+        /// \param text The lines to write.
+        void write_text(std::string_view text) {
+            current().data.append(text);
+        }
+
+        /// commit opens the file and queues the operations writing the segment. They are submitted when submit_batch
+        /// segments are committed since the last submit.
+        void commit() {
+            auto& s = current();
+            if (!uses_io_uring() || use_fallback_) {
+                write_sync(s);
+                return;
+            }
+            if (!open(s)) return;
+            if (!queue_chain(s)) {
+                write_sync(s);
+                return;
+            }
+            if (++committed_>=options_.submit_batch) {
+                process(0);
+            }
+        }
+
+        /// wait submits all committed segments and blocks until all segments are written and closed. Segments that
+        /// cannot be submitted are written synchronously, and the submitted operations are still awaited. It only
+        /// returns early when waiting for completions fails without anything to submit.
+        void wait() {
+            if (!uses_io_uring()) return;
+            process(0);
+            while (in_flight_>0) {
+                auto pending = ring_.pending();
+                if (process(1)!=0 && pending==0) return;
+            }
+        }
+
+        /// uses_io_uring returns true when segments are written with io_uring, false when the synchronous fallback is used.
+        [[nodiscard]] bool uses_io_uring() const {
+            return options_.use_io_uring && ring_.valid();
+        }
+
+        /// last_error returns the errno value of the last failed operation, or 0 when no operation failed.
+        [[nodiscard]] int last_error() const {
+            return last_error_;
+        }
+
+#ifdef CROSSCODE_ACCESS_TO_UNIT_TEST
+        /// returns the amount of io_uring_enter system calls. It is used for unit tests only.
+        [[nodiscard]] std::size_t enters() const {
+            return ring_.enters();
+        }
+#endif
+    };
+
+    /// This type is a io_uring_file_factory_template using our file_name_generator.
+    using io_uring_file_factory = io_uring_file_factory_template<file_name_generator<>>;
+}
+
+#endif
+
+#endif //LINE_BASED_WRITERS_IO_URING_FILE_FACTORY_H
@@ -0,0 +1,193 @@
+#ifndef LINE_BASED_WRITERS_LINE_ARENA_H
+#define LINE_BASED_WRITERS_LINE_ARENA_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+
+namespace crosscode::line_based_writers {
+
+    /// line_view returns a view on size bytes at data. It allows writing byte buffers as lines without copying them into
+    /// a std::string first.
+    inline std::string_view line_view(const void* data, std::size_t size) {
+        return std::string_view{static_cast<const char*>(data),size};
+    }
+
+    /// line_view returns a view on a contiguous container of bytes, for example std::vector<std::byte> or
+    /// std::array<unsigned char,N>.
+    template <typename Tbytes, typename = std::enable_if_t<sizeof(*std::data(std::declval<const Tbytes&>()))==1>>
+    std::string_view line_view(const Tbytes& bytes) {
+        return line_view(std::data(bytes),std::size(bytes));
+    }
+
+    /// is_line_range is true for ranges of lines that can be written with a single call to write of a line buffer, for
+    /// example std::vector<std::string> or std::array<std::string_view,N>. Types convertible to std::string_view are
+    /// lines, not ranges.
+    template <typename Trange, typename = void>
+    struct is_line_range : std::false_type {};
+
+    template <typename Trange>
+    struct is_line_range<Trange,std::void_t<decltype(std::begin(std::declval<const Trange&>())),decltype(std::end(std::declval<const Trange&>()))>>
+            : std::bool_constant<!std::is_convertible_v<const Trange&,std::string_view> && std::is_convertible_v<decltype(*std::begin(std::declval<const Trange&>())),std::string_view>> {};
+
+    /// line_arena stores lines back to back in a single contiguous byte buffer and keeps an offset/length index.
+    /// It can be used as storage for line_buffer instead of std::vector<std::string>. Clearing the arena keeps the
+    /// allocated capacity, so once the arena has grown to the size of a segment writing and flushing lines does not
+    /// allocate anymore.
+    /// Every line is stored followed by a line separator, so the arena contains the lines exactly as they are written
+    /// to a file. text returns them as one contiguous view, which factories providing write_text write without copying
+    /// the lines again. See write_lines.
+    /// Iterating the arena yields std::string_view instances that point into the arena. These views, and the views
+    /// returned by text, are only valid until the next call to emplace_back or clear.
+    class line_arena {
+        /// entry describes the location of a single line inside the arena.
+        struct entry {
+            std::size_t offset;
+            std::size_t length;
+        };
+
+        std::string bytes_;
+        std::vector<entry> index_;
+    public:
+        using value_type = std::string_view;
+        using size_type = std::size_t;
+
+        /// const_iterator iterates the lines in the arena and yields std::string_view instances.
+        class const_iterator {
+            const line_arena* arena_{};
+            std::size_t pos_{};
+        public:
+            using iterator_category = std::input_iterator_tag;
+            using value_type = std::string_view;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = std::string_view;
+
+            const_iterator() = default;
+            const_iterator(const line_arena* arena, std::size_t pos) : arena_{arena}, pos_{pos} {}
+
+            reference operator*() const {
+                return (*arena_)[pos_];
+            }
+
+            const_iterator& operator++() {
+                ++pos_;
+                return *this;
+            }
+
+            const_iterator operator++(int) {
+                auto result = *this;
+                ++pos_;
+                return result;
+            }
+
+            bool operator==(const const_iterator& rhs) const { return arena_==rhs.arena_ && pos_==rhs.pos_; }
+            bool operator!=(const const_iterator& rhs) const { return !(*this==rhs); }
+
+            /// operator- returns the amount of lines from rhs up to this iterator in constant time.
+            difference_type operator-(const const_iterator& rhs) const {
+                return static_cast<difference_type>(pos_)-static_cast<difference_type>(rhs.pos_);
+            }
+
+            friend class line_arena;
+        };
+
+        line_arena() = default;
+
+        /// line_arena constructor that reserves memory up front.
+        /// \param lines The amount of lines to reserve index space for.
+        /// \param bytes The amount of bytes to reserve for line data.
+        line_arena(std::size_t lines, std::size_t bytes) {
+            reserve(lines,bytes);
+        }
+
+        /// reserve reserves memory for the index and the line data.
+        /// \param lines The amount of lines to reserve index space for.
+        /// \param bytes The amount of bytes to reserve for line data.
+        void reserve(std::size_t lines, std::size_t bytes) {
+            index_.reserve(lines);
+            bytes_.reserve(bytes);
+        }
+
+        /// emplace_back appends a line and a line separator to the arena.
+        /// \param line The line to append. The bytes are copied into the arena.
+        void emplace_back(std::string_view line) {
+            index_.push_back(entry{std::size(bytes_),std::size(line)});
+            bytes_.append(line);
+            bytes_.push_back('\n');
+        }
+
+        /// clear removes all lines from the arena, but keeps the allocated memory.
+        void clear() noexcept {
+            index_.clear();
+            bytes_.clear();
+        }
+
+        /// size returns the amount of lines stored in the arena.
+        [[nodiscard]] std::size_t size() const noexcept { return std::size(index_); }
+
+        /// empty returns true when no lines are stored in the arena.
+        [[nodiscard]] bool empty() const noexcept { return index_.empty(); }
+
+        /// bytes returns the amount of line data stored in the arena, excluding line separators.
+        [[nodiscard]] std::size_t bytes() const noexcept { return std::size(bytes_)-std::size(index_); }
+
+        /// text returns all lines, each followed by a line separator, as one contiguous view.
+        [[nodiscard]] std::string_view text() const noexcept { return bytes_; }
+
+        /// text returns the lines from b up to e, each followed by a line separator, as one contiguous view. Both
+        /// iterators must belong to the same arena.
+        static std::string_view text(const const_iterator& b, const const_iterator& e) {
+            if (b==e) return {};
+            const auto& index = b.arena_->index_;
+            auto first = index[b.pos_].offset;
+            auto last = e.pos_<std::size(index) ? index[e.pos_].offset : std::size(b.arena_->bytes_);
+            return std::string_view{b.arena_->bytes_}.substr(first,last-first);
+        }
+
+        /// operator[] returns a view on the line at position pos.
+        std::string_view operator[](std::size_t pos) const {
+            const auto& e = index_[pos];
+            return std::string_view{bytes_}.substr(e.offset,e.length);
+        }
+
+        [[nodiscard]] const_iterator begin() const { return const_iterator{this,0}; }
+        [[nodiscard]] const_iterator end() const { return const_iterator{this,size()}; }
+    };
+
+    /// owns_lines is true when a storage type of a line buffer owns the bytes of the lines it stores. A line buffer
+    /// returns from write before the line is written to the sink, so it only accepts storage that owns its lines.
+    /// Containers of std::string_view do not, line_arena does.
+    template <typename Tstorage>
+    struct owns_lines : std::bool_constant<!std::is_same_v<typename Tstorage::value_type,std::string_view>> {};
+
+    template <>
+    struct owns_lines<line_arena> : std::true_type {};
+
+    /// has_write_text is true when a line writer factory provides void write_text(std::string_view text), which
+    /// writes complete lines that are each followed by a line separator.
+    template <typename Tfactory, typename = void>
+    struct has_write_text : std::false_type {};
+
+    template <typename Tfactory>
+    struct has_write_text<Tfactory,std::void_t<decltype(std::declval<Tfactory&>().write_text(std::string_view{}))>> : std::true_type {};
+
+    /// write_lines writes the lines from b up to e to a line writer factory. Lines stored in a line_arena are passed
+    /// to write_text as one contiguous view when the factory provides it, otherwise every line is passed to write.
+    template <typename Tfactory, typename Iter>
+    void write_lines(Tfactory& factory, Iter b, Iter e) {
+        if constexpr (std::is_same_v<Iter,line_arena::const_iterator> && has_write_text<Tfactory>::value) {
+            factory.write_text(line_arena::text(b,e));
+        } else {
+            std::for_each(b,e,[&factory](const auto& line) { factory.write(line); });
+        }
+    }
+
+}
+
+#endif //LINE_BASED_WRITERS_LINE_ARENA_H
@@ -0,0 +1,236 @@
+#ifndef LINE_BASED_WRITERS_MMAP_FILE_FACTORY_H
+#define LINE_BASED_WRITERS_MMAP_FILE_FACTORY_H
+
+#include "posix_io.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include "file_stream_factory.h"
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+namespace crosscode::line_based_writers {
+
+    /// mmap_options configures a mmap_file_factory_template.
+    struct mmap_options {
+        /// The size a file is allocated and mapped with in begin. When a segment gets larger, the file and the mapping
+        /// grow to twice their size. Use the expected size of a segment, for example the max_bytes of the segment
+        /// policy. At least one page is mapped.
+        std::size_t segment_size{16*1024*1024};
+        /// When true the mapping is advised with madvise(MADV_SEQUENTIAL).
+        bool sequential{true};
+        /// When true commit syncs the mapping with msync(MS_SYNC) and the file size with fdatasync, so the data of a
+        /// segment is durable when commit returns. Use mmap_file_factory_durable to make its name durable as well.
+        bool sync{false};
+    };
+
+    /// mmap_file_factory_template is a template for writing batches to memory mapped files. It is used with
+    /// batch_stream_writer as a replacement for file_stream_factory_template and creates a new file for each batch.
+    /// begin allocates the file with segment_size bytes and maps it. write copies the line and the line separator into
+    /// the mapping, so writing a batch needs no system calls unless the batch is larger than the mapping. commit
+    /// unmaps the file, truncates it to the written size, closes it and publishes it with the publish policy.
+    /// The space of the file is allocated with posix_io::allocate, so writing to the mapping does not fail for lack of
+    /// space. On filesystems that cannot allocate space a full disk raises SIGBUS while writing to the mapping.
+    /// When allocating, mapping or closing fails, the remainder of the batch is discarded, the file is removed, also
+    /// with publish_in_place, and last_error returns the errno value.
+    /// \tparam Tfile_name_generator The filename generator to use generating filenames.
+    /// \tparam Tpublish_policy Decides under which name the file is written and how it is published in commit.
+    template <typename Tfile_name_generator, typename Tpublish_policy = publish_in_place>
+    class mmap_file_factory_template {
+    public:
+        using file_name_generator_type = Tfile_name_generator;
+        using publish_policy_type = Tpublish_policy;
+    private:
+        mmap_options options_;
+        publish_policy_type publish_policy_;
+        file_name_generator_type file_name_generator_;
+        std::string file_name_;
+        std::string temporary_name_;
+        int fd_{-1};
+        char* data_{};
+        std::size_t capacity_{};
+        std::size_t size_{};
+        int last_error_{};
+
+        /// map allocates the file with capacity bytes and maps it.
+        /// \return 0 on success, otherwise the errno value of the failed call.
+        int map(std::size_t capacity) {
+            if (auto error = posix_io::allocate(fd_,capacity); error!=0) return error;
+            auto data = ::mmap(nullptr,capacity,PROT_READ|PROT_WRITE,MAP_SHARED,fd_,0);
+            if (data==MAP_FAILED) return errno;
+            data_ = static_cast<char*>(data);
+            capacity_ = capacity;
+            if (options_.sequential) {
+                ::madvise(data_,capacity_,MADV_SEQUENTIAL);
+            }
+            return 0;
+        }
+
+        void unmap() {
+            if (data_!=nullptr) {
+                ::munmap(data_,capacity_);
+                data_ = nullptr;
+                capacity_ = 0;
+            }
+        }
+
+        /// grow maps the file with at least size bytes more than written.
+        /// \return 0 on success, otherwise the errno value of the failed call.
+        int grow(std::size_t size) {
+            auto capacity = std::max(2*capacity_,size_+size);
+            unmap();
+            return map(capacity);
+        }
+
+        /// close unmaps the file, truncates it to the written size and closes it.
+        /// \return The errno value of the first failed call, or 0.
+        int close() {
+            unmap();
+            auto error = posix_io::truncate(fd_,size_);
+            if (error==0 && options_.sync) {
+                error = posix_io::sync_data(fd_);
+            }
+            if (auto close_error = posix_io::close_fd(fd_); error==0) {
+                error = close_error;
+            }
+            fd_ = -1;
+            return error;
+        }
+
+        /// reserve grows the mapping when size bytes do not fit.
+        /// \return true when size bytes can be written, false when the batch was discarded.
+        bool reserve(std::size_t size) {
+            if (fd_<0) return false;
+            if (size_+size>capacity_) {
+                if (auto error = grow(size); error!=0) {
+                    fail(error);
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /// fail discards the remainder of the batch. The file is closed and removed, so a truncated segment is never
+        /// found under its name.
+        void fail(int error) {
+            last_error_ = error;
+            close();
+            ::unlink(temporary_name_.c_str());
+        }
+    public:
+
+        /// mmap_file_factory_template constructor initializes the mmap_file_factory_template using a forwarding
+        /// reference. It will pass all arguments after options to the Tfile_name_generator constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param options The size of the mapping and the madvise and msync options.
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit mmap_file_factory_template(const mmap_options& options, Args&&... args) : options_{options}, file_name_generator_{std::forward<Args>(args)...} {
+            options_.segment_size = std::max(options_.segment_size,static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)));
+        }
+        mmap_file_factory_template(mmap_file_factory_template<file_name_generator_type,publish_policy_type>&& rhs) noexcept : options_{rhs.options_}, publish_policy_{std::move(rhs.publish_policy_)}, file_name_generator_{std::move(rhs.file_name_generator_)}, file_name_{std::move(rhs.file_name_)}, temporary_name_{std::move(rhs.temporary_name_)}, fd_{rhs.fd_}, data_{rhs.data_}, capacity_{rhs.capacity_}, size_{rhs.size_}, last_error_{rhs.last_error_} {
+            rhs.fd_ = -1;
+            rhs.data_ = nullptr;
+            rhs.capacity_ = 0;
+        }
+        mmap_file_factory_template(const mmap_file_factory_template<file_name_generator_type,publish_policy_type>&) = delete;
+        mmap_file_factory_template<file_name_generator_type,publish_policy_type>&operator=(const mmap_file_factory_template<file_name_generator_type,publish_policy_type>&) = delete;
+
+        ~mmap_file_factory_template() {
+            if (fd_>=0) {
+                close();
+            }
+        }
+
+        /// begin is called when a new file should be created. It allocates and maps segment_size bytes.
+        void begin() {
+            size_ = 0;
+            file_name_ = file_name_generator_.generate();
+            temporary_name_ = publish_policy_.temporary_name(file_name_);
+            fd_ = ::open(temporary_name_.c_str(),O_RDWR|O_CREAT|O_TRUNC|O_CLOEXEC,0666);
+            if (fd_<0) {
+                last_error_ = errno;
+                return;
+            }
+            if (auto error = map(options_.segment_size); error!=0) {
+                fail(error);
+            }
+        }
+
+        /// write copies a line and the line separator into the mapping.
+        /// \tparam Tline The type of the line to write
+        /// \param line The line to write
+        template<typename Tline>
+        void write(Tline &&line) {
+            std::string_view bytes{line};
+            if (reserve(std::size(bytes)+1)) {
+                std::memcpy(data_+size_,std::data(bytes),std::size(bytes));
+                data_[size_+std::size(bytes)] = '\n';
+                size_ += std::size(bytes)+1;
+            }
+        }
+
+        /// write_text copies complete lines that are each followed by a line separator into the mapping.
+        /// \param text The lines to write.
+        void write_text(std::string_view text) {
+            if (reserve(std::size(text))) {
+                std::memcpy(data_+size_,std::data(text),std::size(text));
+                size_ += std::size(text);
+            }
+        }
+
+        /// commit syncs the mapping when configured, unmaps the file, truncates it to the written size, closes it and
+        /// publishes it.
+        void commit() {
+            if (fd_<0) return;
+            if (options_.sync && size_>0 && ::msync(data_,size_,MS_SYNC)!=0) {
+                fail(errno);
+                return;
+            }
+            auto error = close();
+            if (error==0) {
+                error = publish_policy_.publish(temporary_name_,file_name_);
+            } else {
+                ::unlink(temporary_name_.c_str());
+            }
+            if (error!=0) {
+                last_error_ = error;
+            }
+        }
+
+        /// file_name returns the name of the file of the current or last batch.
+        [[nodiscard]] const std::string& file_name() const {
+            return file_name_;
+        }
+
+        /// last_error returns the errno value of the last failed operation, or 0 when no operation failed.
+        [[nodiscard]] int last_error() const {
+            return last_error_;
+        }
+
+#ifdef CROSSCODE_ACCESS_TO_UNIT_TEST
+        /// returns the size of the current mapping. It is used for unit tests only.
+        [[nodiscard]] std::size_t mapped_size() const {
+            return capacity_;
+        }
+#endif
+    };
+
+    /// This type is a mmap_file_factory_template using our file_name_generator.
+    using mmap_file_factory = mmap_file_factory_template<file_name_generator<>>;
+    /// This type is a mmap_file_factory writing to a temporary file and renaming it to its name in commit, so readers
+    /// do not see the allocated but unwritten end of a segment.
+    using mmap_file_factory_atomic = mmap_file_factory_template<file_name_generator<>,publish_by_rename>;
+    /// This type is a mmap_file_factory_atomic syncing the directory after the rename with publish_by_durable_rename.
+    /// Use it with mmap_options::sync, so a segment is durable under its name when commit returns.
+    using mmap_file_factory_durable = mmap_file_factory_template<file_name_generator<>,publish_by_durable_rename>;
+}
+
+#endif
+
+#endif //LINE_BASED_WRITERS_MMAP_FILE_FACTORY_H
@@ -0,0 +1,260 @@
+#ifndef LINE_BASED_WRITERS_MPSC_RING_LINE_BUFFER_H
+#define LINE_BASED_WRITERS_MPSC_RING_LINE_BUFFER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include "line_arena.h"
+
+namespace crosscode::line_based_writers {
+
+    /// mpsc_ring_line_buffer is a thread safe line buffer built on a bounded multi producer single consumer ring of
+    /// pre-sized slots. Writers reserve a slot with an atomic fetch_add and copy the line bytes into the slot; they do
+    /// not take a mutex. A dedicated consumer thread writes every buffer_size lines to the sink as a segment. The
+    /// consumer sleeps until the segment at the tail is complete: it publishes the position of the line it waits for,
+    /// first the last line of the segment, then the first line that is still missing, and only the writer of that
+    /// line wakes it. An idle consumer does not wake up while a partial segment is pending.
+    /// Lines are written to the sink in the order their slots were reserved. When the ring is full, writers spin and
+    /// yield until the consumer frees a slot. Lines longer than the slot size are stored in a string owned by the
+    /// slot, which allocates.
+    /// emit writes all lines written before emit was called and blocks until they are written. Unlike line_buffer,
+    /// emit does not write empty segments. The destructor calls emit and stops the consumer thread.
+    /// \tparam Tline_based_iterator_sink The sink to write to. The sink receives std::string_view instances pointing
+    /// into the ring; they are only valid during the call to write. Only used from the consumer thread.
+    template<typename Tline_based_iterator_sink>
+    class mpsc_ring_line_buffer {
+    public:
+        using sink_type = Tline_based_iterator_sink;
+    private:
+        /// slot is a single entry of the ring.
+        /// sequence equals the ring position when the slot is free for that position and position + 1 when it
+        /// contains the line of that position.
+        struct alignas(64) slot {
+            std::atomic<std::size_t> sequence_;
+            std::size_t length_{};
+            std::string overflow_;
+        };
+
+        /// state contains everything shared with the consumer thread. It lives on the heap so the buffer is movable.
+        struct state {
+            std::size_t buffer_size_;
+            std::size_t slot_size_;
+            std::size_t mask_;
+            std::unique_ptr<slot[]> slots_;
+            std::unique_ptr<char[]> data_;
+            alignas(64) std::atomic<std::size_t> head_{0};
+            alignas(64) std::atomic<std::size_t> tail_{0};
+            /// The position of the line the consumer waits for. The writer of that line wakes the consumer.
+            alignas(64) std::atomic<std::size_t> waiting_for_{~std::size_t{0}};
+            std::size_t flush_target_{0};
+            std::size_t wakeups_{0};
+            bool stop_{false};
+            std::mutex mutex_;
+            std::condition_variable ready_;
+            std::condition_variable written_;
+            sink_type sink_;
+            std::vector<std::string_view> views_;
+            std::thread thread_;
+
+            template <typename ...Args>
+            state(std::size_t buffer_size, std::size_t capacity, std::size_t slot_size, Args&&... args) : buffer_size_{std::max(buffer_size,std::size_t{1})}, slot_size_{slot_size}, sink_{std::forward<Args>(args)...} {
+                std::size_t slots = 1;
+                while (slots < std::max({capacity,buffer_size_,std::size_t{2}})) slots <<= 1u;
+                mask_ = slots-1;
+                slots_ = std::make_unique<slot[]>(slots);
+                for (std::size_t i=0;i<slots;i++) {
+                    slots_[i].sequence_.store(i,std::memory_order_relaxed);
+                }
+                data_ = std::make_unique<char[]>(slots*slot_size_);
+                views_.reserve(buffer_size_);
+            }
+
+            /// ready returns true when the line at position pos is written to its slot.
+            bool ready(std::size_t pos) const {
+                return slots_[pos & mask_].sequence_.load(std::memory_order_acquire)==pos+1;
+            }
+
+            /// view returns a view on the line at position pos.
+            std::string_view view(std::size_t pos) const {
+                const auto& s = slots_[pos & mask_];
+                if (s.length_>slot_size_) return s.overflow_;
+                return {data_.get()+(pos & mask_)*slot_size_,s.length_};
+            }
+        };
+
+        std::unique_ptr<state> state_;
+
+        /// write_segment writes up to buffer_size ready lines starting at the tail to the sink and frees their slots.
+        /// \param partial When false nothing is written unless buffer_size lines are ready.
+        /// \return The amount of lines written.
+        static std::size_t write_segment(state& s, bool partial) {
+            auto tail = s.tail_.load(std::memory_order_relaxed);
+            s.views_.clear();
+            while (std::size(s.views_) < s.buffer_size_ && s.ready(tail+std::size(s.views_))) {
+                s.views_.push_back(s.view(tail+std::size(s.views_)));
+            }
+            auto count = std::size(s.views_);
+            if (count==0 || (!partial && count<s.buffer_size_)) return 0;
+            s.sink_.write(std::begin(s.views_),std::end(s.views_));
+            auto capacity = s.mask_+1;
+            for (std::size_t i=0;i<count;i++) {
+                s.slots_[(tail+i) & s.mask_].sequence_.store(tail+i+capacity,std::memory_order_release);
+            }
+            s.tail_.store(tail+count,std::memory_order_release);
+            return count;
+        }
+
+        /// segment_ready returns true when all lines of the segment at the tail are ready. Otherwise it publishes the
+        /// position of a line that is not ready in waiting_for_, the last line of the segment until that is ready and
+        /// then the first missing line, so the writer of that line wakes the consumer.
+        /// \param next The first position not known to be ready. Advanced while lines are found ready.
+        static bool segment_ready(state& s, std::size_t& next) {
+            auto tail = s.tail_.load(std::memory_order_relaxed);
+            auto end = tail+s.buffer_size_;
+            next = std::max(next,tail);
+            for (;;) {
+                auto target = end-1;
+                if (s.ready(target)) {
+                    while (next<end && s.ready(next)) next++;
+                    if (next==end) return true;
+                    target = next;
+                }
+                s.waiting_for_.store(target,std::memory_order_relaxed);
+                // Pairs with the fence in put: either the writer sees target or the consumer sees its line.
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (!s.ready(target)) return false;
+            }
+        }
+
+        /// put copies a line into the slot of the reserved position pos. Waits until the slot is free.
+        template<typename Tline>
+        static void put(state& s, std::size_t pos, const Tline& line) {
+            std::string_view bytes{line};
+            auto& sl = s.slots_[pos & s.mask_];
+            while (sl.sequence_.load(std::memory_order_acquire)!=pos) {
+                std::this_thread::yield();
+            }
+            sl.length_ = std::size(bytes);
+            if (std::size(bytes)>s.slot_size_) {
+                sl.overflow_.assign(bytes);
+            } else if (!bytes.empty()) {
+                std::memcpy(s.data_.get()+(pos & s.mask_)*s.slot_size_,std::data(bytes),std::size(bytes));
+            }
+            sl.sequence_.store(pos+1,std::memory_order_release);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (s.waiting_for_.load(std::memory_order_relaxed)==pos) {
+                { std::scoped_lock lock{s.mutex_}; }
+                s.ready_.notify_one();
+            }
+        }
+
+        /// run is the consumer thread.
+        static void run(state& s) {
+            std::unique_lock lock{s.mutex_};
+            std::size_t next{0};
+            for (;;) {
+                s.ready_.wait(lock,[&s,&next]{
+                    return s.stop_ || s.flush_target_ > s.tail_.load(std::memory_order_relaxed) || segment_ready(s,next);
+                });
+                s.wakeups_++;
+                auto flush = s.flush_target_ > s.tail_.load(std::memory_order_relaxed);
+                if (s.stop_ && !flush) return;
+                lock.unlock();
+                if (flush) {
+                    if (write_segment(s,true)==0) std::this_thread::yield();
+                } else {
+                    while (write_segment(s,false)>0) {}
+                }
+                lock.lock();
+                s.written_.notify_all();
+            }
+        }
+
+    public:
+        /// mpsc_ring_line_buffer constructor
+        /// \param buffer_size The amount of lines in a segment written to the sink.
+        /// \param capacity The amount of slots in the ring. Rounded up to a power of two of at least buffer_size and at
+        /// least 2, because with one slot a filled slot cannot be told apart from a slot freed for the next position.
+        /// \param slot_size The amount of bytes reserved for each line.
+        /// \param args The arguments passed to the sink constructor.
+        template <typename ...Args>
+        mpsc_ring_line_buffer(std::size_t buffer_size, std::size_t capacity, std::size_t slot_size, Args&&... args) : state_{std::make_unique<state>(buffer_size,capacity,slot_size,std::forward<Args>(args)...)} {
+            state_->thread_ = std::thread{run,std::ref(*state_)};
+        }
+        mpsc_ring_line_buffer(mpsc_ring_line_buffer<sink_type>&& rhs) noexcept : state_{std::move(rhs.state_)} {}
+        mpsc_ring_line_buffer(const mpsc_ring_line_buffer<sink_type>&) = delete;
+        mpsc_ring_line_buffer<sink_type>&operator=(const mpsc_ring_line_buffer<sink_type>&) = delete;
+
+        /// write appends a line, or every line of a range of lines, see is_line_range.
+        template<typename Tline>
+        void write(Tline &&line) {
+            if constexpr (is_line_range<std::decay_t<Tline>>::value) {
+                write(std::begin(line),std::end(line));
+            } else {
+                put(*state_,state_->head_.fetch_add(1,std::memory_order_relaxed),line);
+            }
+        }
+
+        /// write appends the lines from first up to last. For forward iterators the slots of all lines are reserved
+        /// with a single fetch_add, so the lines are contiguous in the ring and in the written segments.
+        template<typename Iter>
+        void write(Iter first, Iter last) {
+            auto& s = *state_;
+            if constexpr (std::is_base_of_v<std::forward_iterator_tag,typename std::iterator_traits<Iter>::iterator_category>) {
+                auto pos = s.head_.fetch_add(static_cast<std::size_t>(std::distance(first,last)),std::memory_order_relaxed);
+                for (;first!=last;++first) {
+                    put(s,pos++,*first);
+                }
+            } else {
+                for (;first!=last;++first) {
+                    put(s,s.head_.fetch_add(1,std::memory_order_relaxed),*first);
+                }
+            }
+        }
+
+        /// emit writes all lines written before emit was called and blocks until they are written to the sink.
+        void emit() {
+            auto& s = *state_;
+            std::unique_lock lock{s.mutex_};
+            auto target = s.head_.load(std::memory_order_acquire);
+            s.flush_target_ = std::max(s.flush_target_,target);
+            s.ready_.notify_one();
+            s.written_.wait(lock,[&s,target]{ return s.tail_.load(std::memory_order_acquire) >= target; });
+        }
+
+        /// sink returns the sink. The sink is used by the consumer thread, only access it after calling emit and while
+        /// no other thread writes.
+        sink_type& sink() { return state_->sink_; }
+
+#ifdef CROSSCODE_ACCESS_TO_UNIT_TEST
+        /// returns the amount of times the consumer thread woke up. It is used for unit tests only.
+        std::size_t wakeups() {
+            std::scoped_lock lock{state_->mutex_};
+            return state_->wakeups_;
+        }
+#endif
+
+        ~mpsc_ring_line_buffer() {
+            if (!state_) return;
+            emit();
+            {
+                std::scoped_lock lock{state_->mutex_};
+                state_->stop_ = true;
+            }
+            state_->ready_.notify_one();
+            state_->thread_.join();
+        }
+    };
+
+}
+
+#endif //LINE_BASED_WRITERS_MPSC_RING_LINE_BUFFER_H
@@ -0,0 +1,219 @@
+#ifndef LINE_BASED_WRITERS_PARALLEL_BATCH_WRITER_H
+#define LINE_BASED_WRITERS_PARALLEL_BATCH_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <algorithm>
+#include <exception>
+#include <utility>
+#include "file_stream_factory.h"
+#include "line_arena.h"
+#include "writer_metrics.h"
+
+namespace crosscode::line_based_writers {
+
+    /// file_name_reference is a filename generator that returns the filename it points to. It is used by the factories
+    /// of the workers of parallel_batch_stream_writer, which are assigned the filename of each batch.
+    class file_name_reference {
+        const std::string* file_name_;
+    public:
+        /// file_name_reference constructor
+        /// \param file_name The filename to return from generate. Must outlive the file_name_reference.
+        explicit file_name_reference(const std::string* file_name) : file_name_{file_name} {}
+
+        /// generate returns the filename.
+        [[nodiscard]] std::string generate() const {
+            return *file_name_;
+        }
+    };
+
+    /// parallel_options configures the workers of a parallel_batch_stream_writer.
+    struct parallel_options {
+        /// The amount of workers. 0 uses the amount of hardware threads.
+        std::size_t workers{};
+        /// The maximum amount of batches waiting for a worker. 0 uses twice the amount of workers.
+        std::size_t queue_depth{};
+    };
+
+    /// parallel_batch_stream_writer writes batches with a pool of workers, so expensive factories such as
+    /// compressing_file_stream_factory_template scale with the amount of cores. It is used as a sink of a line buffer
+    /// instead of batch_stream_writer.
+    /// write copies the batch, renders its filename and queues it for the workers. Filenames are rendered on the
+    /// writing thread, so the counter of the filenames follows the order in which batches are written, while the
+    /// workers write the files concurrently and may complete them in any order. When queue_depth batches are waiting,
+    /// write blocks until a worker takes a batch.
+    /// Every worker has its own factory, which uses file_name_reference to get the filename of the batch.
+    /// flush blocks until all queued batches are written. The destructor calls flush and stops the workers.
+    /// An exception thrown by the factory of a worker is caught, the batch is lost and the worker continues with the
+    /// next batch. The exception is rethrown by the next call to write or flush. An exception that is not rethrown
+    /// before the destructor runs is ignored.
+    /// \tparam Tline_writer_factory The factory used by the workers, using file_name_reference as filename generator.
+    /// For example compressing_file_stream_factory_template<file_name_reference,std::ofstream,zstd_encoder>.
+    /// \tparam Tfile_name_generator The filename generator rendering the filenames of the batches.
+    /// \tparam Tmetrics_policy Records the lines, bytes and latencies of every batch written by the workers. See
+    /// writer_metrics.h. The default policy records nothing.
+    template<typename Tline_writer_factory, typename Tfile_name_generator = file_name_generator<>, typename Tmetrics_policy = null_metrics>
+    class parallel_batch_stream_writer {
+    public:
+        using line_writer_factory = Tline_writer_factory;
+        using file_name_generator_type = Tfile_name_generator;
+        using metrics_policy_type = Tmetrics_policy;
+    private:
+        /// job is a batch waiting to be written.
+        struct job {
+            std::string file_name_;
+            line_arena lines_;
+        };
+
+        /// worker owns the factory of a worker thread. The factory refers to file_name_, so workers are not moved.
+        struct worker {
+            std::string file_name_;
+            line_writer_factory factory_;
+            std::thread thread_;
+
+            template <typename ...Args>
+            explicit worker(const Args&... args) : factory_{args...,&file_name_} {}
+        };
+
+        /// state contains everything shared with the workers. It lives on the heap so the writer is movable.
+        struct state {
+            file_name_generator_type file_name_generator_;
+            std::size_t queue_depth_;
+            std::mutex mutex_;
+            std::condition_variable queued_;
+            std::condition_variable written_; // signalled when a worker takes or completes a batch
+            std::deque<job> queue_;
+            std::vector<line_arena> free_;
+            std::size_t busy_{};
+            bool stop_{false};
+            std::exception_ptr error_; // thrown by a factory, rethrown by the next write or flush
+            metrics_policy_type metrics_;
+            std::vector<std::unique_ptr<worker>> workers_;
+
+            state(file_name_generator_type file_name_generator, std::size_t queue_depth) : file_name_generator_{std::move(file_name_generator)}, queue_depth_{queue_depth} {}
+        };
+
+        std::unique_ptr<state> state_;
+
+        /// rethrow rethrows the exception thrown by the factory of a worker, if any, and clears it.
+        void rethrow() {
+            auto& s = *state_;
+            if (s.error_) std::rethrow_exception(std::exchange(s.error_,nullptr));
+        }
+
+        /// run is a worker thread. It writes queued batches until it is stopped and the queue is empty.
+        static void run(state& s, worker& w) {
+            std::unique_lock lock{s.mutex_};
+            for (;;) {
+                s.queued_.wait(lock,[&s]{ return s.stop_ || !s.queue_.empty(); });
+                if (s.queue_.empty()) return;
+                auto batch = std::move(s.queue_.front());
+                s.queue_.pop_front();
+                s.busy_++;
+                s.written_.notify_all();
+                lock.unlock();
+                w.file_name_ = std::move(batch.file_name_);
+                std::exception_ptr error;
+                try {
+                    measured_write(s.metrics_,w.factory_,std::begin(batch.lines_),std::end(batch.lines_));
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                batch.lines_.clear();
+                lock.lock();
+                if (error && !s.error_) s.error_ = std::move(error);
+                if (std::size(s.free_) < s.queue_depth_) {
+                    s.free_.push_back(std::move(batch.lines_));
+                }
+                s.busy_--;
+                s.written_.notify_all();
+            }
+        }
+
+    public:
+        /// parallel_batch_stream_writer constructor
+        /// \param options The amount of workers and the queue depth.
+        /// \param file_name_generator The filename generator rendering the filenames of the batches.
+        /// \param args The arguments passed to the factory constructor of each worker, before the file_name_reference.
+        template <typename ...Args>
+        parallel_batch_stream_writer(parallel_options options, file_name_generator_type file_name_generator, const Args&... args) {
+            auto workers = options.workers!=0 ? options.workers : std::max(std::size_t{std::thread::hardware_concurrency()},std::size_t{1});
+            auto queue_depth = options.queue_depth!=0 ? options.queue_depth : 2*workers;
+            state_ = std::make_unique<state>(std::move(file_name_generator),queue_depth);
+            state_->workers_.reserve(workers);
+            for (std::size_t i=0;i<workers;i++) {
+                state_->workers_.push_back(std::make_unique<worker>(args...));
+            }
+            for (auto& w : state_->workers_) {
+                w->thread_ = std::thread{run,std::ref(*state_),std::ref(*w)};
+            }
+        }
+        parallel_batch_stream_writer(parallel_batch_stream_writer<line_writer_factory,file_name_generator_type,metrics_policy_type>&& rhs) noexcept : state_{std::move(rhs.state_)} {}
+        parallel_batch_stream_writer(const parallel_batch_stream_writer<line_writer_factory,file_name_generator_type,metrics_policy_type>&) = delete;
+        parallel_batch_stream_writer<line_writer_factory,file_name_generator_type,metrics_policy_type>&operator=(const parallel_batch_stream_writer<line_writer_factory,file_name_generator_type,metrics_policy_type>&) = delete;
+
+        /// write copies a batch and queues it for the workers. Blocks while the queue is full. The batch is copied
+        /// without holding the lock shared with the workers, so workers taking and completing batches do not wait
+        /// for the copy. Rethrows an exception thrown by a factory since the last write or flush without queueing the
+        /// batch.
+        template<typename Iter>
+        void write(Iter b,Iter e) {
+            auto& s = *state_;
+            line_arena lines;
+            {
+                std::scoped_lock lock{s.mutex_};
+                rethrow();
+                if (!s.free_.empty()) {
+                    lines = std::move(s.free_.back());
+                    s.free_.pop_back();
+                }
+            }
+            std::for_each(b,e,[&lines](const auto& line){ lines.emplace_back(std::string_view{line}); });
+            std::unique_lock lock{s.mutex_};
+            s.written_.wait(lock,[&s]{ return std::size(s.queue_) < s.queue_depth_; });
+            s.queue_.push_back(job{s.file_name_generator_.generate(),std::move(lines)});
+            s.queued_.notify_one();
+        }
+
+        /// flush blocks until every queued batch has been written. Rethrows an exception thrown by a factory since the
+        /// last write or flush.
+        void flush() {
+            auto& s = *state_;
+            std::unique_lock lock{s.mutex_};
+            s.written_.wait(lock,[&s]{ return s.queue_.empty() && s.busy_==0; });
+            rethrow();
+        }
+
+        /// metrics returns the metrics policy shared by the workers.
+        metrics_policy_type& metrics() { return state_->metrics_; }
+
+        /// workers returns the amount of workers.
+        [[nodiscard]] std::size_t workers() const { return std::size(state_->workers_); }
+
+        ~parallel_batch_stream_writer() {
+            if (!state_) return;
+            try {
+                flush();
+            } catch (...) {
+                // A destructor does not throw, the exception of the factory is ignored.
+            }
+            {
+                std::scoped_lock lock{state_->mutex_};
+                state_->stop_ = true;
+            }
+            state_->queued_.notify_all();
+            for (auto& w : state_->workers_) {
+                w->thread_.join();
+            }
+        }
+    };
+
+}
+
+#endif //LINE_BASED_WRITERS_PARALLEL_BATCH_WRITER_H
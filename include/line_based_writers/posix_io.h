@@ -0,0 +1,200 @@
+#ifndef LINE_BASED_WRITERS_POSIX_IO_H
+#define LINE_BASED_WRITERS_POSIX_IO_H
+
+#if defined(__unix__) || defined(__APPLE__)
+#define LINE_BASED_WRITERS_HAS_POSIX_IO 1
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <string>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+
+namespace crosscode::line_based_writers {
+
+    /// posix_io contains helpers for writing to file descriptors.
+    namespace posix_io {
+
+#ifdef IOV_MAX
+        constexpr std::size_t max_iovecs = IOV_MAX;
+#else
+        constexpr std::size_t max_iovecs = 1024;
+#endif
+
+        /// write_all writes all buffers described by iov to fd with writev. It continues after partial writes and
+        /// interrupts. The iovecs are modified while writing.
+        /// \param fd The file descriptor to write to.
+        /// \param iov The buffers to write.
+        /// \param count The amount of buffers.
+        /// \return 0 on success, otherwise the errno value of the failed writev.
+        inline int write_all(int fd, iovec* iov, std::size_t count) {
+            while (count>0) {
+                auto n = ::writev(fd,iov,static_cast<int>(std::min(count,max_iovecs)));
+                if (n<0) {
+                    if (errno==EINTR) continue;
+                    return errno;
+                }
+                auto written = static_cast<std::size_t>(n);
+                while (count>0 && written>=iov->iov_len) {
+                    written -= iov->iov_len;
+                    ++iov;
+                    --count;
+                }
+                if (count>0) {
+                    iov->iov_base = static_cast<char*>(iov->iov_base)+written;
+                    iov->iov_len -= written;
+                }
+            }
+            return 0;
+        }
+
+        /// close_fd closes a file descriptor. It does not retry on EINTR, because the descriptor is released anyway.
+        /// \return 0 on success, otherwise the errno value of the failed close.
+        inline int close_fd(int fd) {
+            return ::close(fd)==0 ? 0 : errno;
+        }
+
+        /// sync_data flushes the data of a file to stable storage with fdatasync, or fsync where fdatasync is not
+        /// available. Retries on EINTR.
+        /// \return 0 on success, otherwise the errno value of the failed call.
+        inline int sync_data(int fd) {
+            for (;;) {
+#ifdef __APPLE__
+                auto result = ::fsync(fd);
+#else
+                auto result = ::fdatasync(fd);
+#endif
+                if (result==0) return 0;
+                if (errno!=EINTR) return errno;
+            }
+        }
+
+        /// parent_directory returns the directory containing a file: the part of file_name before the last '/', "/" for
+        /// files in the root directory and "." for names without a directory.
+        inline std::string parent_directory(const std::string& file_name) {
+            auto pos = file_name.find_last_of('/');
+            if (pos==std::string::npos) return ".";
+            return file_name.substr(0,std::max<std::size_t>(pos,1));
+        }
+
+        /// sync_directory flushes the entries of a directory to stable storage with fsync, so files created in or
+        /// renamed into it are found after a crash. Syncing the data of a file does not persist its directory entry.
+        /// Retries on EINTR.
+        /// \param directory The directory to sync, see parent_directory.
+        /// \return 0 on success, otherwise the errno value of the failed call.
+        inline int sync_directory(const std::string& directory) {
+            auto fd = ::open(directory.c_str(),O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+            if (fd<0) return errno;
+            int error{};
+            while (::fsync(fd)!=0) {
+                if (errno!=EINTR) {
+                    error = errno;
+                    break;
+                }
+            }
+            auto close_error = close_fd(fd);
+            return error!=0 ? error : close_error;
+        }
+
+        /// truncate sets the size of a file with ftruncate. Retries on EINTR.
+        /// \return 0 on success, otherwise the errno value of the failed ftruncate.
+        inline int truncate(int fd, std::size_t size) {
+            for (;;) {
+                if (::ftruncate(fd,static_cast<off_t>(size))==0) return 0;
+                if (errno!=EINTR) return errno;
+            }
+        }
+
+        /// preallocate reserves size bytes of disk space for a file before it is written, so the filesystem can
+        /// allocate the file in few extents instead of growing it with every write. On Linux, fallocate with
+        /// FALLOC_FL_KEEP_SIZE is used, so the size of the file does not change. On other systems posix_fallocate is
+        /// used where available. Preallocation is best effort: filesystems that do not support it are ignored.
+        /// \param fd The file descriptor of the file.
+        /// \param size The amount of bytes to reserve, starting at offset 0.
+        /// \return 0 on success or when preallocation is not supported, otherwise the errno value of the failed call,
+        /// for example ENOSPC.
+        inline int preallocate(int fd, std::size_t size) {
+            if (size==0) return 0;
+#if defined(__linux__)
+            for (;;) {
+                if (::fallocate(fd,FALLOC_FL_KEEP_SIZE,0,static_cast<off_t>(size))==0) return 0;
+                if (errno==EINTR) continue;
+                return errno==EOPNOTSUPP || errno==ENOSYS ? 0 : errno;
+            }
+#elif defined(__APPLE__)
+            (void)fd;
+            return 0;
+#else
+            auto error = ::posix_fallocate(fd,0,static_cast<off_t>(size));
+            return error==EOPNOTSUPP || error==EINVAL ? 0 : error;
+#endif
+        }
+
+        /// allocate sets the size of a file to size bytes and allocates the disk space of the whole file, so later
+        /// writes through a memory mapping cannot fail for lack of space. Filesystems that cannot allocate space
+        /// only get their size set with ftruncate.
+        /// \param fd The file descriptor of the file.
+        /// \param size The new size of the file.
+        /// \return 0 on success, otherwise the errno value of the failed call, for example ENOSPC.
+        inline int allocate(int fd, std::size_t size) {
+            if (size==0) return truncate(fd,0);
+#if defined(__linux__)
+            for (;;) {
+                if (::fallocate(fd,0,0,static_cast<off_t>(size))==0) return 0;
+                if (errno==EINTR) continue;
+                if (errno!=EOPNOTSUPP && errno!=ENOSYS) return errno;
+                break;
+            }
+#elif !defined(__APPLE__)
+            if (auto error = ::posix_fallocate(fd,0,static_cast<off_t>(size)); error!=EOPNOTSUPP && error!=EINVAL) return error;
+#endif
+            return truncate(fd,size);
+        }
+
+        /// write_back writes the dirty pages of a file to the device and waits until they are written. On Linux
+        /// sync_file_range is used, which neither flushes the disk cache nor the file metadata, so the data is not
+        /// necessarily durable. On other systems sync_data is used. Retries on EINTR.
+        /// \return 0 on success, otherwise the errno value of the failed call.
+        inline int write_back(int fd) {
+#ifdef __linux__
+            for (;;) {
+                if (::sync_file_range(fd,0,0,SYNC_FILE_RANGE_WAIT_BEFORE|SYNC_FILE_RANGE_WRITE|SYNC_FILE_RANGE_WAIT_AFTER)==0) return 0;
+                if (errno!=EINTR) return errno;
+            }
+#else
+            return sync_data(fd);
+#endif
+        }
+
+        /// drop_cache advises the operating system to remove the pages of a file from the page cache with
+        /// posix_fadvise(POSIX_FADV_DONTNEED). Only clean pages are removed, call write_back first. Does nothing
+        /// where posix_fadvise is not available.
+        /// \return 0 on success, otherwise the errno value of the failed posix_fadvise.
+        inline int drop_cache(int fd) {
+#ifdef POSIX_FADV_DONTNEED
+            return ::posix_fadvise(fd,0,0,POSIX_FADV_DONTNEED);
+#else
+            (void)fd;
+            return 0;
+#endif
+        }
+
+#ifdef __linux__
+        /// sync_filesystem flushes all data of the filesystem containing fd to stable storage with syncfs. Only
+        /// available on Linux.
+        /// \return 0 on success, otherwise the errno value of the failed syncfs.
+        inline int sync_filesystem(int fd) {
+            return ::syncfs(fd)==0 ? 0 : errno;
+        }
+#endif
+
+    }
+
+}
+
+#endif
+
+#endif //LINE_BASED_WRITERS_POSIX_IO_H
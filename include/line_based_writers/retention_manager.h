@@ -0,0 +1,246 @@
+#ifndef LINE_BASED_WRITERS_RETENTION_MANAGER_H
+#define LINE_BASED_WRITERS_RETENTION_MANAGER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <fstream>
+#include <type_traits>
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cerrno>
+#include "posix_io.h"
+#include "line_arena.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+#include <sys/stat.h>
+#endif
+
+namespace crosscode::line_based_writers {
+
+    /// retention_limits contains the limits of a retention_manager.
+    struct retention_limits {
+        /// The maximum total size in bytes of the tracked files. 0 disables the limit.
+        std::uint64_t max_bytes{};
+        /// The maximum amount of tracked files. 0 disables the limit.
+        std::size_t max_files{};
+    };
+
+    /// retention_metrics contains the counters of a retention_manager.
+    struct retention_metrics {
+        /// The amount and total size of the tracked files.
+        std::uint64_t files{};
+        std::uint64_t bytes{};
+        /// The amount and total size of the files deleted to stay within the limits.
+        std::uint64_t deleted_files{};
+        std::uint64_t deleted_bytes{};
+        /// The amount of files that could not be deleted. They are no longer tracked.
+        std::uint64_t failed_deletes{};
+    };
+
+    /// file_size retrieves the size of a file.
+    /// \return 0 on success, otherwise the errno value of the failed lookup.
+    inline int file_size(const std::string& file_name, std::uint64_t& size) {
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+        struct stat st{};
+        if (::stat(file_name.c_str(),&st)!=0) return errno;
+        size = static_cast<std::uint64_t>(st.st_size);
+#else
+        std::ifstream in{file_name,std::ios::binary|std::ios::ate};
+        if (!in) return ENOENT;
+        size = static_cast<std::uint64_t>(in.tellg());
+#endif
+        return 0;
+    }
+
+    /// retention_manager bounds the disk usage of written segments. It tracks the files it is told about with add, in
+    /// the order they were added, and deletes the oldest files when the total size or the amount of files exceeds
+    /// retention_limits. The directory is never scanned: the size of each added file is looked up once, and deleted
+    /// files are removed from the front of the tracked files.
+    /// add only queues the file name, the lookups and deletes run on a dedicated thread so writers are not delayed.
+    /// The newest file is never deleted, because it may still be written to. Files that no longer exist when they
+    /// are looked up or deleted, for example because a shipper moved them, are no longer tracked.
+    /// Use retained_factory to add every file a factory writes. Files from before a restart are only tracked when
+    /// they are added, oldest first, before new files are written.
+    class retention_manager {
+        /// entry is a tracked file.
+        struct entry {
+            std::string file_name_;
+            std::uint64_t bytes_{};
+        };
+
+        /// state contains everything shared with the retention thread. It lives on the heap so retention_manager is
+        /// movable.
+        struct state {
+            retention_limits limits_;
+            std::mutex mutex_;
+            std::condition_variable added_cv_;
+            std::condition_variable processed_cv_;
+            std::vector<std::string> added_;
+            std::uint64_t added_count_{};
+            std::uint64_t processed_count_{};
+            bool stop_{false};
+            retention_metrics metrics_;
+            std::thread thread_;
+
+            explicit state(const retention_limits& limits) : limits_{limits} {}
+        };
+
+        std::unique_ptr<state> state_;
+
+        /// track looks up the size of an added file. A file added again directly after itself, like the open file of a
+        /// rotating factory, updates the size of the newest file.
+        static void track(std::deque<entry>& files, std::uint64_t& bytes, std::string& file_name) {
+            std::uint64_t size{};
+            if (file_size(file_name,size)!=0) return;
+            if (!files.empty() && files.back().file_name_==file_name) {
+                bytes = bytes-files.back().bytes_+size;
+                files.back().bytes_ = size;
+                return;
+            }
+            bytes += size;
+            files.push_back(entry{std::move(file_name),size});
+        }
+
+        static bool exceeded(const retention_limits& limits, std::size_t files, std::uint64_t bytes) {
+            return (limits.max_files!=0 && files>limits.max_files) || (limits.max_bytes!=0 && bytes>limits.max_bytes);
+        }
+
+        static void run(state& s) {
+            std::deque<entry> files;
+            std::uint64_t bytes{};
+            std::vector<std::string> added;
+            std::unique_lock lock{s.mutex_};
+            while (true) {
+                s.added_cv_.wait(lock,[&s]{ return s.stop_ || !s.added_.empty(); });
+                if (s.added_.empty()) return;
+                added.swap(s.added_);
+                auto count = s.added_count_;
+                lock.unlock();
+                for (auto& file_name : added) {
+                    track(files,bytes,file_name);
+                }
+                added.clear();
+                retention_metrics deleted;
+                while (std::size(files)>1 && exceeded(s.limits_,std::size(files),bytes)) {
+                    auto& oldest = files.front();
+                    if (std::remove(oldest.file_name_.c_str())==0) {
+                        deleted.deleted_files++;
+                        deleted.deleted_bytes += oldest.bytes_;
+                    } else if (errno!=ENOENT) {
+                        deleted.failed_deletes++;
+                    }
+                    bytes -= oldest.bytes_;
+                    files.pop_front();
+                }
+                lock.lock();
+                s.metrics_.files = std::size(files);
+                s.metrics_.bytes = bytes;
+                s.metrics_.deleted_files += deleted.deleted_files;
+                s.metrics_.deleted_bytes += deleted.deleted_bytes;
+                s.metrics_.failed_deletes += deleted.failed_deletes;
+                s.processed_count_ = count;
+                s.processed_cv_.notify_all();
+            }
+        }
+    public:
+        /// retention_manager constructor starts the retention thread.
+        /// \param limits The maximum total size and amount of files.
+        explicit retention_manager(const retention_limits& limits) : state_{std::make_unique<state>(limits)} {
+            state_->thread_ = std::thread{run,std::ref(*state_)};
+        }
+        retention_manager(retention_manager&& rhs) noexcept : state_{std::move(rhs.state_)} {}
+        retention_manager(const retention_manager&) = delete;
+        retention_manager& operator=(const retention_manager&) = delete;
+
+        /// The destructor applies the limits to the files added before and stops the retention thread.
+        ~retention_manager() {
+            if (!state_) return;
+            {
+                std::scoped_lock lock{state_->mutex_};
+                state_->stop_ = true;
+            }
+            state_->added_cv_.notify_one();
+            state_->thread_.join();
+        }
+
+        /// add queues a complete file to be tracked. It returns without accessing the file. Thread safe.
+        /// \param file_name The name of the file.
+        void add(std::string file_name) {
+            {
+                std::scoped_lock lock{state_->mutex_};
+                state_->added_.push_back(std::move(file_name));
+                state_->added_count_++;
+            }
+            state_->added_cv_.notify_one();
+        }
+
+        /// wait blocks until the files added before are tracked and the limits are applied to them.
+        void wait() {
+            std::unique_lock lock{state_->mutex_};
+            auto count = state_->added_count_;
+            state_->processed_cv_.wait(lock,[this,count]{ return state_->processed_count_>=count; });
+        }
+
+        [[nodiscard]] retention_metrics metrics() const {
+            std::scoped_lock lock{state_->mutex_};
+            return state_->metrics_;
+        }
+    };
+
+    /// retained_factory adds the file of every committed batch of a line writer factory to a retention_manager.
+    /// The retention_manager must outlive the retained_factory. The factory must provide
+    /// const std::string& file_name() const and the file must be complete when commit returns, like
+    /// file_stream_factory, rotating_file_stream_factory, fd_file_factory, mmap_file_factory and direct_file_factory.
+    /// \tparam Tfactory The line writer factory writing the files.
+    template <typename Tfactory>
+    class retained_factory {
+    public:
+        using factory_type = Tfactory;
+    private:
+        retention_manager& retention_;
+        factory_type factory_;
+    public:
+        /// retained_factory constructor passes all arguments after retention to the Tfactory constructor.
+        /// \tparam Args Parameter pack of argument types
+        /// \param retention The retention manager tracking the written files.
+        /// \param args Expanded parameter pack arguments
+        template <typename ...Args>
+        explicit retained_factory(retention_manager& retention, Args&&... args) : retention_{retention}, factory_{std::forward<Args>(args)...} {}
+        retained_factory(retained_factory<factory_type>&& rhs) noexcept : retention_{rhs.retention_}, factory_{std::move(rhs.factory_)} {}
+        retained_factory(const retained_factory<factory_type>&) = delete;
+        retained_factory<factory_type>&operator=(const retained_factory<factory_type>&) = delete;
+
+        void begin() {
+            factory_.begin();
+        }
+
+        template<typename Tline>
+        void write(Tline &&line) {
+            factory_.write(std::forward<Tline>(line));
+        }
+
+        /// write_text is only available when the factory provides it.
+        template <typename Tf = factory_type, typename = std::enable_if_t<has_write_text<Tf>::value>>
+        void write_text(std::string_view text) {
+            factory_.write_text(text);
+        }
+
+        /// commit commits the batch and adds its file to the retention manager.
+        void commit() {
+            factory_.commit();
+            retention_.add(factory_.file_name());
+        }
+
+        factory_type& factory() { return factory_; }
+    };
+
+}
+
+#endif //LINE_BASED_WRITERS_RETENTION_MANAGER_H
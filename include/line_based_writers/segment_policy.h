@@ -0,0 +1,144 @@
+#ifndef LINE_BASED_WRITERS_SEGMENT_POLICY_H
+#define LINE_BASED_WRITERS_SEGMENT_POLICY_H
+
+#include <string_view>
+#include <tuple>
+#include <cstddef>
+#include <chrono>
+
+namespace crosscode::line_based_writers {
+
+    /// Segment policies decide when a line buffer rolls its buffered lines into a segment.
+    /// A segment policy provides the following members:
+    /// - add(line) is called for every line appended to the buffer.
+    /// - full() returns true when the buffered lines should be written as a segment.
+    /// - reset() is called when the buffered lines have been handed to the sink.
+    /// Line buffers also evaluate full() in poll(), so time based policies can roll a segment without a write.
+
+    /// line_count_policy rolls a segment when max_lines lines are buffered. This is the default policy.
+    class line_count_policy {
+        std::size_t max_lines_;
+        std::size_t lines_{};
+    public:
+        /// line_count_policy constructor. Not explicit, so a line buffer can still be constructed with a line count.
+        /// \param max_lines The amount of lines in a segment. 0 disables rolling on line count.
+        line_count_policy(std::size_t max_lines) : max_lines_{max_lines} {}
+
+        template<typename Tline>
+        void add(const Tline&) {
+            lines_++;
+        }
+
+        [[nodiscard]] bool full() const {
+            return max_lines_!=0 && lines_>=max_lines_;
+        }
+
+        void reset() {
+            lines_ = 0;
+        }
+    };
+
+    /// byte_size_policy rolls a segment when at least max_bytes bytes are buffered. Each line is counted with its line
+    /// separator, so the size matches the size of the segment that is written.
+    class byte_size_policy {
+        std::size_t max_bytes_;
+        std::size_t bytes_{};
+    public:
+        /// byte_size_policy constructor
+        /// \param max_bytes The minimum size of a segment in bytes. 0 disables rolling on size.
+        explicit byte_size_policy(std::size_t max_bytes) : max_bytes_{max_bytes} {}
+
+        template<typename Tline>
+        void add(const Tline& line) {
+            bytes_ += std::size(std::string_view{line})+1;
+        }
+
+        [[nodiscard]] bool full() const {
+            return max_bytes_!=0 && bytes_>=max_bytes_;
+        }
+
+        void reset() {
+            bytes_ = 0;
+        }
+    };
+
+    /// max_age_policy rolls a segment when the oldest buffered line is at least max_age old.
+    /// The age is checked on every write and on every poll of the line buffer. Use flush_timer to poll a line buffer
+    /// periodically, so lines are written during quiet periods too.
+    /// \tparam now The function to use for retrieving the current time. Replaceable to enable unit tests.
+    template <auto now=std::chrono::steady_clock::now>
+    class max_age_policy {
+    public:
+        using time_point = decltype(now());
+        using duration = typename time_point::duration;
+    private:
+        duration max_age_;
+        time_point first_{};
+        bool empty_{true};
+    public:
+        /// max_age_policy constructor
+        /// \param max_age The maximum time a line is buffered before the segment is rolled.
+        explicit max_age_policy(duration max_age) : max_age_{max_age} {}
+
+        template<typename Tline>
+        void add(const Tline&) {
+            if (empty_) {
+                first_ = now();
+                empty_ = false;
+            }
+        }
+
+        [[nodiscard]] bool full() const {
+            return !empty_ && now()-first_>=max_age_;
+        }
+
+        void reset() {
+            empty_ = true;
+        }
+    };
+
+    /// any_of_policy combines segment policies. It rolls a segment when any of the policies is full.
+    /// \tparam Tpolicies The policies to combine.
+    template<typename ...Tpolicies>
+    class any_of_policy {
+        std::tuple<Tpolicies...> policies_;
+    public:
+        explicit any_of_policy(Tpolicies... policies) : policies_{std::move(policies)...} {}
+
+        template<typename Tline>
+        void add(const Tline& line) {
+            std::apply([&line](auto&... p){ (p.add(line),...); },policies_);
+        }
+
+        [[nodiscard]] bool full() const {
+            return std::apply([](const auto&... p){ return (p.full() || ...); },policies_);
+        }
+
+        void reset() {
+            std::apply([](auto&... p){ (p.reset(),...); },policies_);
+        }
+    };
+
+    /// line_count_or_byte_size_policy rolls a segment when either max_lines lines or max_bytes bytes are buffered,
+    /// whichever comes first.
+    class line_count_or_byte_size_policy : public any_of_policy<line_count_policy,byte_size_policy> {
+    public:
+        /// line_count_or_byte_size_policy constructor
+        /// \param max_lines The maximum amount of lines in a segment. 0 disables rolling on line count.
+        /// \param max_bytes The minimum size of a segment in bytes. 0 disables rolling on size.
+        line_count_or_byte_size_policy(std::size_t max_lines, std::size_t max_bytes) : any_of_policy{line_count_policy{max_lines},byte_size_policy{max_bytes}} {}
+    };
+
+    /// line_count_or_max_age_policy rolls a segment when either max_lines lines are buffered or the oldest buffered
+    /// line is max_age old, whichever comes first.
+    class line_count_or_max_age_policy : public any_of_policy<line_count_policy,max_age_policy<>> {
+    public:
+        /// line_count_or_max_age_policy constructor
+        /// \param max_lines The maximum amount of lines in a segment. 0 disables rolling on line count.
+        /// \param max_age The maximum time a line is buffered before the segment is rolled.
+        line_count_or_max_age_policy(std::size_t max_lines, std::chrono::steady_clock::duration max_age) : any_of_policy{line_count_policy{max_lines},max_age_policy<>{max_age}} {}
+    };
+
+}
+
+#endif //LINE_BASED_WRITERS_SEGMENT_POLICY_H
@@ -0,0 +1,201 @@
+#ifndef LINE_BASED_WRITERS_SPILL_POLICY_H
+#define LINE_BASED_WRITERS_SPILL_POLICY_H
+
+#include <string>
+#include <string_view>
+#include <deque>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+namespace crosscode::line_based_writers {
+
+    /// Spill policies decide what file_stream_factory_template does with a batch that could not be written, for
+    /// example because the directory does not exist or the disk is full. A spill policy provides:
+    /// - static constexpr bool enabled. When false the factory writes lines to the stream as they are written and a
+    ///   batch that fails is lost. When true the factory collects the lines of a batch in memory and passes them to
+    ///   the members below, which write the file with the write function of the factory.
+    /// - int commit(std::string file_name, std::string& text, Twrite&& write) writes or spills a batch.
+    /// - int retry(Twrite&& write) writes spilled batches when their retry is due. It may write only some of them.
+    /// - int flush(Twrite&& write) writes spilled batches without waiting for the backoff.
+    /// The write function has the signature int(const std::string& file_name, std::string_view text) and returns the
+    /// errno value of a failed write, or 0. All members return the errno value of the last failed write, or 0.
+
+    /// write_error describes a failed write of a batch. It is passed to the error callback of memory_spill_template.
+    struct write_error {
+        /// The errno value of the failed write.
+        int error{};
+        /// The name of the file of the batch.
+        std::string file_name;
+        /// The size of the batch in bytes.
+        std::size_t bytes{};
+        /// The amount of times writing the batch was attempted, 0 when it was not attempted.
+        std::size_t attempts{};
+        /// True when the batch is kept in the spill buffer to be retried, false when it was dropped because the spill
+        /// buffer is full.
+        bool spilled{};
+    };
+
+    /// no_spill writes lines directly to the stream. A batch that cannot be written is lost and reported with
+    /// last_error. This is the default spill policy.
+    struct no_spill {
+        static constexpr bool enabled = false;
+    };
+
+    /// spill_options configures memory_spill_template.
+    struct spill_options {
+        /// The maximum amount of bytes kept in the spill buffer. Batches that do not fit are dropped.
+        std::size_t max_bytes{64*1024*1024};
+        /// The time to wait before the first retry after a failure. Doubled after every failed retry.
+        std::chrono::steady_clock::duration initial_backoff{std::chrono::milliseconds{100}};
+        /// The maximum time between retries.
+        std::chrono::steady_clock::duration max_backoff{std::chrono::seconds{30}};
+        /// The maximum amount of spilled batches written by one commit or retry. With more than one, the spill buffer
+        /// shrinks while batches are committed. Minimum is 1.
+        std::size_t max_retry_batches{2};
+        /// Called for every failed write and every dropped batch, on the thread that commits. Should return quickly.
+        std::function<void(const write_error&)> on_error;
+    };
+
+    /// spill_metrics contains the counters of memory_spill_template.
+    struct spill_metrics {
+        /// The amount of failed writes.
+        std::uint64_t failures{};
+        /// The amount of batches written by a retry.
+        std::uint64_t recovered_batches{};
+        /// The amount of batches dropped because the spill buffer was full.
+        std::uint64_t dropped_batches{};
+        std::uint64_t dropped_bytes{};
+        /// The amount of batches and bytes currently in the spill buffer.
+        std::uint64_t spilled_batches{};
+        std::uint64_t spilled_bytes{};
+    };
+
+    /// memory_spill_template keeps batches that could not be written in a bounded in-memory spill buffer and retries
+    /// them with exponential backoff. Retries happen in commit and retry, which write at most max_retry_batches
+    /// spilled batches, so no thread sleeps and a commit is delayed by at most max_retry_batches writes. flush writes
+    /// all spilled batches. While batches are spilled, new batches are appended to the spill buffer, so files are
+    /// written in the order of their batches. Once a retry succeeds, the backoff is reset, and once the spill buffer
+    /// is empty batches are written directly again.
+    /// \tparam now The function to use for retrieving the current time. Replaceable to enable unit tests.
+    template <auto now=std::chrono::steady_clock::now>
+    class memory_spill_template {
+        /// batch is a spilled batch.
+        struct batch {
+            std::string file_name_;
+            std::string text_;
+            std::size_t attempts_{};
+        };
+
+        spill_options options_;
+        std::deque<batch> batches_;
+        std::size_t bytes_{};
+        std::chrono::steady_clock::duration backoff_{};
+        decltype(now()) next_retry_{};
+        int error_{};
+        spill_metrics metrics_;
+
+        void report(const batch& b, bool spilled) const {
+            if (options_.on_error) {
+                options_.on_error(write_error{error_,b.file_name_,std::size(b.text_),b.attempts_,spilled});
+            }
+        }
+
+        /// failed records a failed write and schedules the next retry.
+        void failed(int error) {
+            error_ = error;
+            metrics_.failures++;
+            backoff_ = backoff_==decltype(backoff_){} ? options_.initial_backoff : std::min(2*backoff_,options_.max_backoff);
+            next_retry_ = now()+backoff_;
+        }
+
+        /// spill appends a batch to the spill buffer, or drops it when it does not fit.
+        void spill(batch b) {
+            if (bytes_+std::size(b.text_)>options_.max_bytes) {
+                metrics_.dropped_batches++;
+                metrics_.dropped_bytes += std::size(b.text_);
+                report(b,false);
+                return;
+            }
+            report(b,true);
+            bytes_ += std::size(b.text_);
+            batches_.push_back(std::move(b));
+        }
+
+        /// write_spilled writes up to limit spilled batches in order until a write fails.
+        template <typename Twrite>
+        int write_spilled(Twrite& write, std::size_t limit) {
+            for (std::size_t i=0;i<limit && !batches_.empty();i++) {
+                auto& b = batches_.front();
+                b.attempts_++;
+                if (auto error = write(b.file_name_,std::string_view{b.text_}); error!=0) {
+                    failed(error);
+                    report(b,true);
+                    return error;
+                }
+                metrics_.recovered_batches++;
+                bytes_ -= std::size(b.text_);
+                batches_.pop_front();
+            }
+            backoff_ = {};
+            return 0;
+        }
+    public:
+        static constexpr bool enabled = true;
+
+        /// memory_spill_template constructor
+        /// \param options The size of the spill buffer, the backoff and the error callback.
+        explicit memory_spill_template(spill_options options = {}) : options_{std::move(options)} {
+            options_.max_retry_batches = std::max(options_.max_retry_batches,std::size_t{1});
+        }
+
+        /// commit writes a batch when no batches are spilled, otherwise it retries up to max_retry_batches spilled
+        /// batches first when their retry is due. A batch that fails, or that has to wait for spilled batches, is spilled.
+        /// \param file_name The name of the file of the batch.
+        /// \param text The lines of the batch. Moved from when the batch is spilled.
+        /// \param write The function writing a file.
+        template <typename Twrite>
+        int commit(std::string file_name, std::string& text, Twrite&& write) {
+            auto error = retry(write);
+            if (batches_.empty()) {
+                error = write(file_name,std::string_view{text});
+                if (error==0) return 0;
+                failed(error);
+                spill(batch{std::move(file_name),std::move(text),1});
+                return error;
+            }
+            spill(batch{std::move(file_name),std::move(text),0});
+            return error;
+        }
+
+        /// retry writes up to max_retry_batches spilled batches when the backoff has expired.
+        template <typename Twrite>
+        int retry(Twrite&& write) {
+            if (batches_.empty() || now()<next_retry_) return 0;
+            return write_spilled(write,options_.max_retry_batches);
+        }
+
+        /// flush writes the spilled batches without waiting for the backoff.
+        template <typename Twrite>
+        int flush(Twrite&& write) {
+            return write_spilled(write,std::size(batches_));
+        }
+
+        /// error returns the errno value of the last failed write, or 0 when no write failed.
+        [[nodiscard]] int error() const { return error_; }
+
+        [[nodiscard]] spill_metrics metrics() const {
+            auto result = metrics_;
+            result.spilled_batches = std::size(batches_);
+            result.spilled_bytes = bytes_;
+            return result;
+        }
+    };
+
+    using memory_spill = memory_spill_template<>;
+
+}
+
+#endif //LINE_BASED_WRITERS_SPILL_POLICY_H
@@ -0,0 +1,59 @@
+#ifndef LINE_BASED_WRITERS_THREAD_INDEX_H
+#define LINE_BASED_WRITERS_THREAD_INDEX_H
+
+#include <vector>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+namespace crosscode::line_based_writers {
+
+    /// thread_indices hands out the indices returned by thread_index. A released index is handed out again before a
+    /// new index, lowest first, so the indices of the live threads are 0 up to the amount of live threads.
+    class thread_indices {
+        std::mutex mutex_;
+        std::vector<std::size_t> free_;
+        std::size_t next_{};
+    public:
+        /// acquire returns the lowest released index, or a new index when no index was released.
+        std::size_t acquire() {
+            std::scoped_lock lock{mutex_};
+            if (free_.empty()) return next_++;
+            std::pop_heap(std::begin(free_),std::end(free_),std::greater<>{});
+            auto index = free_.back();
+            free_.pop_back();
+            return index;
+        }
+
+        /// release hands an index out again. Called when the thread that acquired it exits.
+        void release(std::size_t index) {
+            std::scoped_lock lock{mutex_};
+            free_.push_back(index);
+            std::push_heap(std::begin(free_),std::end(free_),std::greater<>{});
+        }
+
+        /// instance returns the process wide thread_indices. It is never destroyed, so threads exiting during static
+        /// destruction can still release their index.
+        static thread_indices& instance() {
+            static auto* indices = new thread_indices{};
+            return *indices;
+        }
+    };
+
+    /// thread_index returns a stable index for the calling thread. The index is released when the thread exits and
+    /// reused by the next thread calling thread_index, so when at most n threads are alive their indices are below n.
+    /// Used to assign threads to shards with thread_index() % shards, where threads that are alive at the same time
+    /// only share a shard when there are more of them than shards.
+    inline std::size_t thread_index() {
+        struct holder {
+            std::size_t index_{thread_indices::instance().acquire()};
+            ~holder() { thread_indices::instance().release(index_); }
+        };
+        thread_local const holder h;
+        return h.index_;
+    }
+
+}
+
+#endif //LINE_BASED_WRITERS_THREAD_INDEX_H
@@ -0,0 +1,233 @@
+#ifndef LINE_BASED_WRITERS_TRACING_H
+#define LINE_BASED_WRITERS_TRACING_H
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "writer_metrics.h"
+
+namespace crosscode::line_based_writers {
+
+    /// Trace policies receive spans describing where the time of a line goes. They are used by line_buffer and
+    /// line_buffer_ts, which trace the time lines wait in the buffer and the time writers wait for the mutex, and as
+    /// metrics policy of batch_stream_writer, which traces begin, write and commit of the factory. A line buffer shares
+    /// its tracer with a batch_stream_writer sink using the same trace policy, so all spans reach the same tracer.
+    /// A trace policy provides the following members:
+    /// - static constexpr bool enabled. When false the line buffers do not read the clock, so a disabled policy costs
+    ///   nothing.
+    /// - static std::chrono::steady_clock::time_point clock() returns the current time.
+    /// - void record(const trace_span& span) receives a span. May be called concurrently.
+    /// - begin_segment and end_segment of the metrics policy interface, see writer_metrics.h.
+    /// Trace policies are handles: copies share the callback or ring they record to.
+
+    /// trace_stage identifies the stage a span measures.
+    enum class trace_stage : std::uint8_t {
+        /// The time from buffering the first line of a segment until the segment is emitted.
+        buffer,
+        /// The time a write of line_buffer_ts waited for the mutex.
+        lock_wait,
+        /// The duration of begin of the factory, which opens the file.
+        begin,
+        /// The duration of writing the lines of a segment to the factory.
+        write,
+        /// The duration of commit of the factory.
+        commit
+    };
+
+    /// trace_span is the timing of one stage.
+    struct trace_span {
+        trace_stage stage{};
+        /// The time the stage started.
+        std::chrono::steady_clock::time_point start{};
+        std::chrono::nanoseconds duration{};
+        /// The amount of lines the stage handled.
+        std::size_t lines{};
+    };
+
+    /// trace_segment records the begin, write and commit spans of a written segment.
+    template <typename Ttracer>
+    void trace_segment(Ttracer& tracer, const segment_sample& sample) {
+        auto write_start = sample.start+sample.begin;
+        tracer.record(trace_span{trace_stage::begin,sample.start,sample.begin,sample.lines});
+        tracer.record(trace_span{trace_stage::write,write_start,sample.write,sample.lines});
+        tracer.record(trace_span{trace_stage::commit,write_start+sample.write,sample.commit,sample.lines});
+    }
+
+    /// null_tracer records nothing. This is the default trace policy.
+    class null_tracer {
+    public:
+        static constexpr bool enabled = false;
+
+        static std::chrono::steady_clock::time_point clock() { return {}; }
+
+        void record(const trace_span&) {}
+
+        void begin_segment() {}
+
+        void end_segment(const segment_sample&) {}
+    };
+
+    /// callback_tracer passes every span to a callback. The callback is called on the thread that completed the stage,
+    /// possibly concurrently, and should return quickly.
+    class callback_tracer {
+    public:
+        using callback_type = std::function<void(const trace_span&)>;
+    private:
+        std::shared_ptr<callback_type> callback_;
+    public:
+        static constexpr bool enabled = true;
+
+        /// callback_tracer constructor
+        /// \param callback The callback receiving the spans. An empty callback discards them.
+        explicit callback_tracer(callback_type callback = {}) : callback_{std::make_shared<callback_type>(std::move(callback))} {}
+        /// Copies and moves share the callback, so a moved from tracer remains usable.
+        callback_tracer(const callback_tracer&) = default;
+        callback_tracer& operator=(const callback_tracer&) = default;
+
+        /// callback replaces the callback of this tracer and all its copies. Set it before lines are written.
+        void callback(callback_type callback) {
+            *callback_ = std::move(callback);
+        }
+
+        static std::chrono::steady_clock::time_point clock() {
+            return std::chrono::steady_clock::now();
+        }
+
+        void record(const trace_span& span) {
+            if (*callback_) {
+                (*callback_)(span);
+            }
+        }
+
+        void begin_segment() {}
+
+        void end_segment(const segment_sample& sample) {
+            trace_segment(*this,sample);
+        }
+    };
+
+    /// ring_options configures a ring_tracer.
+    struct ring_options {
+        /// The amount of spans kept. Older spans are overwritten.
+        std::size_t capacity{4096};
+        /// Spans shorter than min_duration are not recorded, so rare slow stages are not overwritten by the common
+        /// fast ones.
+        std::chrono::nanoseconds min_duration{};
+    };
+
+    /// ring_tracer keeps the most recent spans in a fixed size in-memory ring without locks. Writers claim a slot with
+    /// one atomic increment and publish the span with a sequence number per slot. spans returns a consistent copy of
+    /// the recorded spans and may be called at any time from any thread.
+    class ring_tracer {
+        /// ring_slot stores a span as atomics. sequence is odd while the span is written and 2*position+2 when the span
+        /// at position is complete.
+        struct ring_slot {
+            std::atomic<std::uint64_t> sequence_{};
+            std::atomic<std::uint64_t> stage_{};
+            std::atomic<std::int64_t> start_{};
+            std::atomic<std::int64_t> duration_{};
+            std::atomic<std::uint64_t> lines_{};
+        };
+
+        /// state is shared by the copies of a ring_tracer.
+        struct state {
+            ring_options options_;
+            std::unique_ptr<ring_slot[]> slots_;
+            std::atomic<std::uint64_t> next_{};
+            std::atomic<std::uint64_t> dropped_{};
+
+            explicit state(const ring_options& options) : options_{options}, slots_{std::make_unique<ring_slot[]>(options.capacity)} {}
+        };
+
+        std::shared_ptr<state> state_;
+    public:
+        static constexpr bool enabled = true;
+
+        /// ring_tracer constructor
+        /// \param options The capacity of the ring and the minimum duration of recorded spans.
+        explicit ring_tracer(const ring_options& options = {}) {
+            auto o = options;
+            o.capacity = std::max(o.capacity,std::size_t{1});
+            state_ = std::make_shared<state>(o);
+        }
+        /// Copies and moves share the ring, so a moved from tracer remains usable.
+        ring_tracer(const ring_tracer&) = default;
+        ring_tracer& operator=(const ring_tracer&) = default;
+
+        static std::chrono::steady_clock::time_point clock() {
+            return std::chrono::steady_clock::now();
+        }
+
+        void record(const trace_span& span) {
+            auto& s = *state_;
+            if (span.duration<s.options_.min_duration) return;
+            auto position = s.next_.fetch_add(1,std::memory_order_relaxed);
+            auto& slot = s.slots_[position % s.options_.capacity];
+            auto sequence = slot.sequence_.load(std::memory_order_relaxed);
+            do {
+                // Another writer is still writing this slot, or already wrote a newer span to it.
+                if ((sequence & 1u)!=0 || sequence>2*position) {
+                    s.dropped_.fetch_add(1,std::memory_order_relaxed);
+                    return;
+                }
+            } while (!slot.sequence_.compare_exchange_weak(sequence,2*position+1,std::memory_order_acquire,std::memory_order_relaxed));
+            slot.stage_.store(static_cast<std::uint64_t>(span.stage),std::memory_order_relaxed);
+            slot.start_.store(span.start.time_since_epoch().count(),std::memory_order_relaxed);
+            slot.duration_.store(span.duration.count(),std::memory_order_relaxed);
+            slot.lines_.store(span.lines,std::memory_order_relaxed);
+            slot.sequence_.store(2*position+2,std::memory_order_release);
+        }
+
+        void begin_segment() {}
+
+        void end_segment(const segment_sample& sample) {
+            trace_segment(*this,sample);
+        }
+
+        /// spans returns the recorded spans that were not overwritten, oldest first. Spans that are written while
+        /// spans copies the ring are skipped.
+        [[nodiscard]] std::vector<trace_span> spans() const {
+            auto& s = *state_;
+            auto end = s.next_.load(std::memory_order_acquire);
+            auto first = end>s.options_.capacity ? end-s.options_.capacity : 0;
+            std::vector<trace_span> result;
+            result.reserve(static_cast<std::size_t>(end-first));
+            for (auto position=first;position<end;position++) {
+                auto& slot = s.slots_[position % s.options_.capacity];
+                auto sequence = slot.sequence_.load(std::memory_order_acquire);
+                if (sequence!=2*position+2) continue;
+                trace_span span;
+                span.stage = static_cast<trace_stage>(slot.stage_.load(std::memory_order_relaxed));
+                span.start = std::chrono::steady_clock::time_point{std::chrono::steady_clock::duration{slot.start_.load(std::memory_order_relaxed)}};
+                span.duration = std::chrono::nanoseconds{slot.duration_.load(std::memory_order_relaxed)};
+                span.lines = static_cast<std::size_t>(slot.lines_.load(std::memory_order_relaxed));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence_.load(std::memory_order_relaxed)==sequence) {
+                    result.push_back(span);
+                }
+            }
+            return result;
+        }
+
+        /// dropped returns the amount of spans that were not recorded because their slot was still being written.
+        [[nodiscard]] std::uint64_t dropped() const {
+            return state_->dropped_.load(std::memory_order_relaxed);
+        }
+    };
+
+    /// traced_by is true when the sink of a line buffer is a batch_stream_writer using Ttracer as metrics policy.
+    template <typename Tsink, typename Ttracer, typename = void>
+    struct traced_by : std::false_type {};
+
+    template <typename Tsink, typename Ttracer>
+    struct traced_by<Tsink,Ttracer,std::void_t<typename Tsink::metrics_policy_type>> : std::is_same<typename Tsink::metrics_policy_type,Ttracer> {};
+
+}
+
+#endif //LINE_BASED_WRITERS_TRACING_H
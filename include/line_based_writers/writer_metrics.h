@@ -0,0 +1,332 @@
+#ifndef LINE_BASED_WRITERS_WRITER_METRICS_H
+#define LINE_BASED_WRITERS_WRITER_METRICS_H
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <iterator>
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include "line_arena.h"
+#include "thread_index.h"
+
+namespace crosscode::line_based_writers {
+
+    /// Metrics policies instrument the segments written by batch_stream_writer and parallel_batch_stream_writer.
+    /// A metrics policy provides the following members:
+    /// - static constexpr bool enabled. When false the writer does not read the clock or count the bytes of a segment,
+    ///   so a disabled policy costs nothing.
+    /// - clock() returns the current std::chrono::steady_clock::time_point. Only used when enabled.
+    /// - void begin_segment() is called before the factory begins a segment.
+    /// - void end_segment(const segment_sample& sample) is called after the factory committed the segment.
+    /// Both may be called concurrently by the workers of parallel_batch_stream_writer.
+
+    /// segment_sample describes a written segment.
+    struct segment_sample {
+        /// The time begin of the factory was called.
+        std::chrono::steady_clock::time_point start{};
+        /// The amount of lines in the segment.
+        std::size_t lines{};
+        /// The size of the segment in bytes, including the line separators.
+        std::size_t bytes{};
+        /// The duration of begin of the factory.
+        std::chrono::nanoseconds begin{};
+        /// The duration of writing the lines to the factory.
+        std::chrono::nanoseconds write{};
+        /// The duration of commit of the factory.
+        std::chrono::nanoseconds commit{};
+    };
+
+    /// segment_lines returns the amount of lines from b up to e.
+    template <typename Iter>
+    std::size_t segment_lines(Iter b, Iter e) {
+        if constexpr (std::is_same_v<Iter,line_arena::const_iterator>) {
+            return static_cast<std::size_t>(e-b);
+        } else {
+            return static_cast<std::size_t>(std::distance(b,e));
+        }
+    }
+
+    /// segment_bytes returns the size of the lines from b up to e in bytes, including the line separators.
+    template <typename Iter>
+    std::size_t segment_bytes(Iter b, Iter e) {
+        if constexpr (std::is_same_v<Iter,line_arena::const_iterator>) {
+            return std::size(line_arena::text(b,e));
+        } else {
+            std::size_t bytes{};
+            std::for_each(b,e,[&bytes](const auto& line) { bytes += std::size(std::string_view{line})+1; });
+            return bytes;
+        }
+    }
+
+    /// null_metrics records nothing. This is the default metrics policy.
+    class null_metrics {
+    public:
+        static constexpr bool enabled = false;
+
+        void begin_segment() {}
+
+        void end_segment(const segment_sample&) {}
+    };
+
+    /// histogram_snapshot is a copy of a latency_histogram. Bucket 0 counts latencies of 0ns, bucket i counts latencies
+    /// from 2^(i-1)ns up to 2^i ns. The last bucket also counts all larger latencies.
+    struct histogram_snapshot {
+        static constexpr std::size_t bucket_count = 48;
+
+        std::uint64_t count{};
+        std::chrono::nanoseconds sum{};
+        std::chrono::nanoseconds max{};
+        std::array<std::uint64_t,bucket_count> buckets{};
+
+        /// upper_bound returns the exclusive upper bound of a bucket.
+        [[nodiscard]] static std::chrono::nanoseconds upper_bound(std::size_t bucket) {
+            return std::chrono::nanoseconds{std::int64_t{1} << bucket};
+        }
+
+        /// mean returns the mean latency, or zero when no latency was recorded.
+        [[nodiscard]] std::chrono::nanoseconds mean() const {
+            return count==0 ? std::chrono::nanoseconds{} : sum/static_cast<std::chrono::nanoseconds::rep>(count);
+        }
+
+        /// quantile returns the upper bound of the bucket containing quantile q of the latencies, limited to max, or
+        /// zero when no latency was recorded. The result is at most twice the exact quantile.
+        /// \param q The quantile, from 0 to 1.
+        [[nodiscard]] std::chrono::nanoseconds quantile(double q) const {
+            if (count==0) return {};
+            auto rank = static_cast<std::uint64_t>(q*static_cast<double>(count-1))+1;
+            std::uint64_t seen{};
+            for (std::size_t i=0;i<bucket_count;i++) {
+                seen += buckets[i];
+                if (seen>=rank) {
+                    return std::min(upper_bound(i),max);
+                }
+            }
+            return max;
+        }
+
+        void merge(const histogram_snapshot& rhs) {
+            count += rhs.count;
+            sum += rhs.sum;
+            max = std::max(max,rhs.max);
+            for (std::size_t i=0;i<bucket_count;i++) {
+                buckets[i] += rhs.buckets[i];
+            }
+        }
+    };
+
+    /// latency_histogram counts latencies in log2 sized buckets without locks. add and snapshot may be called
+    /// concurrently, a snapshot may then include a latency in some fields only.
+    class latency_histogram {
+        std::atomic<std::uint64_t> count_{};
+        std::atomic<std::uint64_t> sum_{};
+        std::atomic<std::uint64_t> max_{};
+        std::array<std::atomic<std::uint64_t>,histogram_snapshot::bucket_count> buckets_{};
+
+        static std::size_t bucket(std::uint64_t ns) {
+            std::size_t b{};
+            while (ns!=0 && b<histogram_snapshot::bucket_count-1) {
+                ns >>= 1u;
+                b++;
+            }
+            return b;
+        }
+    public:
+        void add(std::chrono::nanoseconds latency) {
+            auto ns = static_cast<std::uint64_t>(std::max(latency.count(),std::chrono::nanoseconds::rep{}));
+            buckets_[bucket(ns)].fetch_add(1,std::memory_order_relaxed);
+            sum_.fetch_add(ns,std::memory_order_relaxed);
+            auto max = max_.load(std::memory_order_relaxed);
+            while (ns>max && !max_.compare_exchange_weak(max,ns,std::memory_order_relaxed)) {}
+            count_.fetch_add(1,std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] histogram_snapshot snapshot() const {
+            histogram_snapshot s;
+            s.count = count_.load(std::memory_order_relaxed);
+            s.sum = std::chrono::nanoseconds{sum_.load(std::memory_order_relaxed)};
+            s.max = std::chrono::nanoseconds{max_.load(std::memory_order_relaxed)};
+            for (std::size_t i=0;i<histogram_snapshot::bucket_count;i++) {
+                s.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            }
+            return s;
+        }
+    };
+
+    /// metrics_snapshot is a copy of the metrics of a writer.
+    struct metrics_snapshot {
+        /// Counter of the committed segments.
+        std::uint64_t segments{};
+        /// Counter of the lines in the committed segments.
+        std::uint64_t lines{};
+        /// Counter of the bytes in the committed segments, including the line separators.
+        std::uint64_t bytes{};
+        /// Gauge of the segments that are begun but not committed.
+        std::uint64_t segments_in_progress{};
+        /// The latency of begin of the factory.
+        histogram_snapshot begin_latency{};
+        /// The latency of writing the lines of a segment to the factory.
+        histogram_snapshot write_latency{};
+        /// The latency of commit of the factory.
+        histogram_snapshot commit_latency{};
+        /// The latency of writing a segment, from begin up to and including commit.
+        histogram_snapshot segment_latency{};
+
+        /// visit calls visitor(std::string_view name, std::uint64_t value) for every counter and gauge, and for the
+        /// count, mean, p50, p99 and max in nanoseconds of every histogram, for example to write them as fields of a
+        /// line protocol line.
+        template <typename Tvisitor>
+        void visit(Tvisitor&& visitor) const {
+            visitor("segments",segments);
+            visitor("lines",lines);
+            visitor("bytes",bytes);
+            visitor("segments_in_progress",segments_in_progress);
+            visit_histogram(visitor,"begin",begin_latency);
+            visit_histogram(visitor,"write",write_latency);
+            visit_histogram(visitor,"commit",commit_latency);
+            visit_histogram(visitor,"segment",segment_latency);
+        }
+    private:
+        template <typename Tvisitor>
+        static void visit_histogram(Tvisitor& visitor, std::string_view prefix, const histogram_snapshot& h) {
+            std::string name{prefix};
+            auto field = [&visitor,&name,&prefix](std::string_view suffix, std::uint64_t value) {
+                name.resize(std::size(prefix));
+                name += suffix;
+                visitor(std::string_view{name},value);
+            };
+            field("_count",h.count);
+            field("_mean_ns",static_cast<std::uint64_t>(h.mean().count()));
+            field("_p50_ns",static_cast<std::uint64_t>(h.quantile(0.5).count()));
+            field("_p99_ns",static_cast<std::uint64_t>(h.quantile(0.99).count()));
+            field("_max_ns",static_cast<std::uint64_t>(h.max.count()));
+        }
+    };
+
+    /// writer_metrics_template counts segments, lines and bytes and records the latency of begin, write and commit of
+    /// every segment in log2 bucketed histograms. The metrics are kept in per thread shards of relaxed atomics, so
+    /// recording never takes a lock and threads writing concurrently do not share cache lines. snapshot sums the shards
+    /// and may be called at any time from any thread.
+    /// \tparam now The function to use for retrieving the current time. Replaceable to enable unit tests.
+    template <auto now=std::chrono::steady_clock::now>
+    class writer_metrics_template {
+    public:
+        using time_point = decltype(now());
+    private:
+        /// shard is aligned to a cache line so shards used by different threads do not share cache lines.
+        struct alignas(64) shard {
+            std::atomic<std::uint64_t> segments_{};
+            std::atomic<std::uint64_t> lines_{};
+            std::atomic<std::uint64_t> bytes_{};
+            std::atomic<std::uint64_t> begun_{};
+            latency_histogram begin_;
+            latency_histogram write_;
+            latency_histogram commit_;
+            latency_histogram segment_;
+        };
+
+        std::vector<std::unique_ptr<shard>> shards_;
+
+        shard& local() {
+            return *shards_[thread_index() % std::size(shards_)];
+        }
+    public:
+        static constexpr bool enabled = true;
+
+        /// writer_metrics_template constructor
+        /// \param shards The amount of shards. When 0 the amount of hardware threads is used.
+        explicit writer_metrics_template(std::size_t shards = 0) {
+            if (shards==0) {
+                shards = std::max(std::size_t{std::thread::hardware_concurrency()},std::size_t{1});
+            }
+            shards_.reserve(shards);
+            for (std::size_t i=0;i<shards;i++) {
+                shards_.push_back(std::make_unique<shard>());
+            }
+        }
+        writer_metrics_template(writer_metrics_template<now>&& rhs) noexcept : shards_{std::move(rhs.shards_)} {}
+        writer_metrics_template(const writer_metrics_template<now>&) = delete;
+        writer_metrics_template<now>&operator=(const writer_metrics_template<now>&) = delete;
+
+        /// clock returns the current time of the clock used to measure the latencies.
+        static time_point clock() {
+            return now();
+        }
+
+        void begin_segment() {
+            if (shards_.empty()) return; // moved from
+            local().begun_.fetch_add(1,std::memory_order_relaxed);
+        }
+
+        void end_segment(const segment_sample& sample) {
+            if (shards_.empty()) return; // moved from
+            auto& s = local();
+            s.segments_.fetch_add(1,std::memory_order_relaxed);
+            s.lines_.fetch_add(sample.lines,std::memory_order_relaxed);
+            s.bytes_.fetch_add(sample.bytes,std::memory_order_relaxed);
+            s.begin_.add(sample.begin);
+            s.write_.add(sample.write);
+            s.commit_.add(sample.commit);
+            s.segment_.add(sample.begin+sample.write+sample.commit);
+        }
+
+        /// snapshot returns the sum of the metrics of all threads. The counters of a segment that is committed while
+        /// the snapshot is taken may be partially included.
+        [[nodiscard]] metrics_snapshot snapshot() const {
+            metrics_snapshot result;
+            std::uint64_t begun{};
+            for (const auto& s : shards_) {
+                result.segments += s->segments_.load(std::memory_order_relaxed);
+                result.lines += s->lines_.load(std::memory_order_relaxed);
+                result.bytes += s->bytes_.load(std::memory_order_relaxed);
+                begun += s->begun_.load(std::memory_order_relaxed);
+                result.begin_latency.merge(s->begin_.snapshot());
+                result.write_latency.merge(s->write_.snapshot());
+                result.commit_latency.merge(s->commit_.snapshot());
+                result.segment_latency.merge(s->segment_.snapshot());
+            }
+            result.segments_in_progress = begun>result.segments ? begun-result.segments : 0;
+            return result;
+        }
+    };
+
+    using writer_metrics = writer_metrics_template<>;
+
+    /// measured_write writes the lines from b up to e to a new segment of factory and records the segment with the
+    /// metrics policy. With a disabled metrics policy it only calls begin, write_lines and commit.
+    template <typename Tmetrics_policy, typename Tfactory, typename Iter>
+    void measured_write(Tmetrics_policy& metrics, Tfactory& factory, Iter b, Iter e) {
+        if constexpr (Tmetrics_policy::enabled) {
+            metrics.begin_segment();
+            auto start = metrics.clock();
+            factory.begin();
+            auto begun = metrics.clock();
+            write_lines(factory,b,e);
+            auto written = metrics.clock();
+            factory.commit();
+            auto committed = metrics.clock();
+            metrics.end_segment(segment_sample{
+                start,
+                segment_lines(b,e),
+                segment_bytes(b,e),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(begun-start),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(written-begun),
+                std::chrono::duration_cast<std::chrono::nanoseconds>(committed-written)
+            });
+        } else {
+            factory.begin();
+            write_lines(factory,b,e);
+            factory.commit();
+        }
+    }
+
+}
+
+#endif //LINE_BASED_WRITERS_WRITER_METRICS_H
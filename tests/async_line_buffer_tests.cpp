@@ -0,0 +1,240 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+#include <vector>
+#include <string>
+#include <atomic>
+#include <future>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+using batches = std::vector<std::vector<std::string>>;
+
+class recording_sink {
+    std::shared_ptr<batches> batches_;
+    std::shared_future<void> gate_;
+    std::shared_ptr<std::atomic<int>> entered_;
+public:
+    explicit recording_sink(std::shared_ptr<batches> b, std::shared_future<void> gate = {}, std::shared_ptr<std::atomic<int>> entered = {}) : batches_{std::move(b)}, gate_{std::move(gate)}, entered_{std::move(entered)} {}
+
+    template<typename Iter>
+    void write(Iter b, Iter e) {
+        if (entered_) (*entered_)++;
+        if (gate_.valid()) gate_.wait();
+        auto& batch = batches_->emplace_back();
+        std::for_each(b,e,[&batch](const auto& line){ batch.emplace_back(line); });
+    }
+};
+
+/// throwing_sink throws when a buffer contains the line "fail" and records the other buffers.
+class throwing_sink {
+    std::shared_ptr<batches> batches_;
+public:
+    explicit throwing_sink(std::shared_ptr<batches> b) : batches_{std::move(b)} {}
+
+    template<typename Iter>
+    void write(Iter b, Iter e) {
+        if (std::find(b,e,"fail")!=e) throw std::runtime_error{"sink failed"};
+        auto& batch = batches_->emplace_back();
+        std::for_each(b,e,[&batch](const auto& line){ batch.emplace_back(line); });
+    }
+};
+
+TEST_SUITE("Async line buffer tests") {
+    TEST_CASE("Can create async line buffer of 2") {
+        auto result = std::make_shared<batches>();
+        lbw::async_line_buffer<recording_sink> lb{2u,2u,result};
+        lb.write("line 1");
+        lb.write("line 2"s);
+        lb.write("line 3");
+        lb.write("line 4");
+        lb.write("line 5");
+        SUBCASE("Emit writes all buffered lines") {
+            lb.emit();
+            REQUIRE(batches{{"line 1","line 2"},{"line 3","line 4"},{"line 5"}}==*result);
+            SUBCASE("Emit does not write empty buffers") {
+                lb.emit();
+                REQUIRE(3u==result->size());
+            }
+        }
+    }
+    TEST_CASE("Async line buffer splits a group of lines across buffers") {
+        auto result = std::make_shared<batches>();
+        lbw::async_line_buffer<recording_sink,lbw::line_arena> lb{2u,4u,result};
+        std::vector<std::string> group{"line 1","line 2","line 3"};
+        lb.write(std::begin(group),std::end(group));
+        lb.write(std::vector<std::string_view>{"line 4"sv});
+        lb.emit();
+        REQUIRE(batches{{"line 1","line 2"},{"line 3","line 4"}}==*result);
+    }
+    TEST_CASE("Destructor of async line buffer writes all buffered lines") {
+        auto result = std::make_shared<batches>();
+        {
+            lbw::async_line_buffer<recording_sink,lbw::line_arena> lb{2u,1u,result};
+            lb.write("line 1");
+            lb.write("line 2");
+            lb.write("line 3");
+        }
+        REQUIRE(batches{{"line 1","line 2"},{"line 3"}}==*result);
+    }
+    TEST_CASE("Can move async line buffer") {
+        auto result = std::make_shared<batches>();
+        {
+            lbw::async_line_buffer<recording_sink> lb{2u,1u,result};
+            lb.write("line 1");
+            auto moved = std::move(lb);
+            moved.write("line 2");
+        }
+        REQUIRE(batches{{"line 1","line 2"}}==*result);
+    }
+    TEST_CASE("Async line buffer blocks writer when queue is full") {
+        auto result = std::make_shared<batches>();
+        std::promise<void> gate;
+        lbw::async_line_buffer<recording_sink> lb{1u,1u,result,gate.get_future().share()};
+        lb.write("line 1");
+        lb.write("line 2");
+        std::atomic<bool> done{false};
+        auto writer = std::async(std::launch::async,[&lb,&done]{
+            lb.write("line 3");
+            lb.write("line 4");
+            done = true;
+        });
+        REQUIRE(writer.wait_for(50ms)==std::future_status::timeout);
+        REQUIRE_FALSE(done);
+        gate.set_value();
+        writer.get();
+        lb.emit();
+        REQUIRE(batches{{"line 1"},{"line 2"},{"line 3"},{"line 4"}}==*result);
+    }
+    /// saturate writes line 1 to 3 to a buffer of one line per segment and a queue depth of 1 whose sink blocks on the
+    /// gate. Line 1 is in the sink, line 2 is queued and line 3 is the full current buffer, so line 4 is saturated.
+    template <typename Tbackpressure_policy>
+    void saturate(lbw::async_line_buffer<recording_sink,lbw::line_arena,lbw::line_count_policy,Tbackpressure_policy>& lb, const std::atomic<int>& entered) {
+        lb.write("line 1");
+        while (entered==0) {
+            std::this_thread::yield();
+        }
+        lb.write("line 2");
+        lb.write("line 3");
+    }
+    TEST_CASE("Drop newest backpressure drops lines written while the buffer is saturated") {
+        auto result = std::make_shared<batches>();
+        auto entered = std::make_shared<std::atomic<int>>(0);
+        std::promise<void> gate;
+        {
+            lbw::async_line_buffer<recording_sink,lbw::line_arena,lbw::line_count_policy,lbw::drop_newest_backpressure> lb{1u,1u,result,gate.get_future().share(),entered};
+            saturate(lb,*entered);
+            lb.write("line 4");
+            lb.write("line 5");
+            auto metrics = lb.backpressure();
+            REQUIRE(2==metrics.saturated);
+            REQUIRE(2==metrics.dropped_lines);
+            REQUIRE(0==metrics.dropped_buffers);
+            gate.set_value();
+        }
+        REQUIRE(batches{{"line 1"},{"line 2"},{"line 3"}}==*result);
+    }
+    TEST_CASE("Drop oldest backpressure drops the oldest queued buffer") {
+        auto result = std::make_shared<batches>();
+        auto entered = std::make_shared<std::atomic<int>>(0);
+        std::promise<void> gate;
+        {
+            lbw::async_line_buffer<recording_sink,lbw::line_arena,lbw::line_count_policy,lbw::drop_oldest_backpressure> lb{1u,1u,result,gate.get_future().share(),entered};
+            saturate(lb,*entered);
+            lb.write("line 4");
+            lb.write("line 5");
+            auto metrics = lb.backpressure();
+            REQUIRE(2==metrics.saturated);
+            REQUIRE(2==metrics.dropped_lines);
+            REQUIRE(2==metrics.dropped_buffers);
+            gate.set_value();
+        }
+        REQUIRE(batches{{"line 1"},{"line 4"},{"line 5"}}==*result);
+    }
+    TEST_CASE("Timeout backpressure drops a line after waiting for the timeout") {
+        auto result = std::make_shared<batches>();
+        auto entered = std::make_shared<std::atomic<int>>(0);
+        std::promise<void> gate;
+        {
+            lbw::async_line_buffer<recording_sink,lbw::line_arena,lbw::line_count_policy,lbw::timeout_backpressure> lb{lbw::timeout_backpressure{10ms},1u,1u,result,gate.get_future().share(),entered};
+            saturate(lb,*entered);
+            auto start = std::chrono::steady_clock::now();
+            lb.write("line 4");
+            REQUIRE(std::chrono::steady_clock::now()-start>=10ms);
+            auto metrics = lb.backpressure();
+            REQUIRE(1==metrics.saturated);
+            REQUIRE(1==metrics.timeouts);
+            REQUIRE(1==metrics.dropped_lines);
+            gate.set_value();
+            lb.write("line 5");
+        }
+        REQUIRE(batches{{"line 1"},{"line 2"},{"line 3"},{"line 5"}}==*result);
+    }
+    TEST_CASE("Timeout backpressure writes a line when the sink catches up within the timeout") {
+        auto result = std::make_shared<batches>();
+        auto entered = std::make_shared<std::atomic<int>>(0);
+        std::promise<void> gate;
+        {
+            lbw::async_line_buffer<recording_sink,lbw::line_arena,lbw::line_count_policy,lbw::timeout_backpressure> lb{lbw::timeout_backpressure{10s},1u,1u,result,gate.get_future().share(),entered};
+            saturate(lb,*entered);
+            auto opener = std::async(std::launch::async,[&gate]{
+                std::this_thread::sleep_for(10ms);
+                gate.set_value();
+            });
+            lb.write("line 4");
+            REQUIRE(0==lb.backpressure().dropped_lines);
+        }
+        REQUIRE(batches{{"line 1"},{"line 2"},{"line 3"},{"line 4"}}==*result);
+    }
+    TEST_CASE("Sampling backpressure keeps one of every n saturated lines") {
+        auto result = std::make_shared<batches>();
+        auto entered = std::make_shared<std::atomic<int>>(0);
+        std::promise<void> gate;
+        {
+            lbw::async_line_buffer<recording_sink,lbw::line_arena,lbw::line_count_policy,lbw::sampling_backpressure> lb{lbw::sampling_backpressure{2,1ms},1u,1u,result,gate.get_future().share(),entered};
+            saturate(lb,*entered);
+            for (int i=4;i<8;i++) {
+                lb.write("line "+std::to_string(i));
+            }
+            auto metrics = lb.backpressure();
+            REQUIRE(4==metrics.saturated);
+            REQUIRE(2==metrics.timeouts);
+            REQUIRE(4==metrics.dropped_lines);
+            gate.set_value();
+        }
+        REQUIRE(batches{{"line 1"},{"line 2"},{"line 3"}}==*result);
+    }
+    TEST_CASE("Async line buffer rethrows an exception of the sink from the next emit") {
+        auto result = std::make_shared<batches>();
+        {
+            lbw::async_line_buffer<throwing_sink> lb{1u,4u,result};
+            lb.write("fail");
+            REQUIRE_THROWS_AS(lb.emit(),std::runtime_error);
+            lb.write("line 1");
+            lb.emit();
+            lb.write("line 2");
+            lb.write("fail");
+        }
+        REQUIRE(batches{{"line 1"},{"line 2"}}==*result);
+    }
+    TEST_CASE("Async line buffer rethrows an exception of the sink from the next write") {
+        auto result = std::make_shared<batches>();
+        std::size_t written{};
+        {
+            lbw::async_line_buffer<throwing_sink> lb{1u,4u,result};
+            lb.write("fail");
+            auto write_until_thrown = [&lb,&written]{
+                for (;;) {
+                    lb.write("line");
+                    written++;
+                }
+            };
+            REQUIRE_THROWS_AS(write_until_thrown(),std::runtime_error);
+            lb.emit();
+        }
+        REQUIRE(written==std::size(*result));
+    }
+}
@@ -0,0 +1,171 @@
+#include "doctest.h"
+
+#define CROSSCODE_ACCESS_TO_UNIT_TEST
+
+#include "line_based_writers.h"
+#include <sstream>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+
+    struct compressed_stream : public std::stringstream {
+        std::string last_file_name;
+        bool is_open=false;
+        void open(const std::string& file_name, ios_base::openmode) {
+            str("");
+            last_file_name = file_name;
+            is_open = true;
+        }
+        void close() {
+            is_open = false;
+        }
+    };
+
+    /// framing_encoder is a fake encoder that frames every chunk it receives, so the tests can see when and with
+    /// which data the encoder is called.
+    struct framing_encoder {
+        static constexpr std::string_view extension{".fake"};
+        int level;
+        std::string dictionary;
+        int begins{};
+        int chunks{};
+        bool fail_compress{false};
+
+        explicit framing_encoder(const lbw::compression_options& options) : level{options.level}, dictionary{options.dictionary} {}
+
+        bool begin() {
+            begins++;
+            return true;
+        }
+
+        bool compress(std::string_view input, std::string& output) {
+            if (fail_compress) return false;
+            if (input.empty()) return true;
+            chunks++;
+            output += "<"+std::string{input}+">";
+            return true;
+        }
+
+        bool end(std::string& output) {
+            output += "|";
+            return true;
+        }
+    };
+
+    using testable_compressing_factory = lbw::compressing_file_stream_factory_no_stream<compressed_stream,framing_encoder>;
+
+}
+
+TEST_SUITE("Compressing file factory tests") {
+    TEST_CASE("Compressing factory compresses a batch into a file with the encoder extension") {
+        testable_compressing_factory factory{lbw::compression_options{7,"dict"},"/tmp/test-%NUM:4%.log"};
+        REQUIRE(7==factory.encoder().level);
+        REQUIRE("dict"==factory.encoder().dictionary);
+        factory.begin();
+        REQUIRE("/tmp/test-0000.log.fake"==factory.underlying_stream().last_file_name);
+        REQUIRE(factory.underlying_stream().is_open);
+        factory.write("test1");
+        factory.write("test2"sv);
+        factory.commit();
+        REQUIRE_FALSE(factory.underlying_stream().is_open);
+        REQUIRE("<test1\ntest2\n>|"==factory.underlying_stream().str());
+        REQUIRE(0==factory.last_error());
+        SUBCASE("New begin starts a new compressed stream in a new file") {
+            factory.begin();
+            factory.write("test3");
+            factory.commit();
+            REQUIRE("/tmp/test-0001.log.fake"==factory.underlying_stream().last_file_name);
+            REQUIRE("<test3\n>|"==factory.underlying_stream().str());
+            REQUIRE(2==factory.encoder().begins);
+        }
+    }
+    TEST_CASE("Compressing factory compresses full chunks while lines are written") {
+        lbw::compression_options options;
+        options.chunk_size = 8;
+        testable_compressing_factory factory{options,"/tmp/test.log"};
+        factory.begin();
+        factory.write("abc");
+        REQUIRE(0==factory.encoder().chunks);
+        factory.write("defg");
+        REQUIRE(1==factory.encoder().chunks);
+        REQUIRE("<abc\ndefg\n>"==factory.underlying_stream().str());
+        factory.write("h");
+        factory.commit();
+        REQUIRE(2==factory.encoder().chunks);
+        REQUIRE("<abc\ndefg\n><h\n>|"==factory.underlying_stream().str());
+    }
+    TEST_CASE("Compressing factory compresses text in chunks") {
+        lbw::compression_options options;
+        options.chunk_size = 8;
+        testable_compressing_factory factory{options,"/tmp/test.log"};
+        factory.begin();
+        factory.write("ab");
+        factory.write_text("cd\nefghijklmnopqrstu\nv\n");
+        factory.commit();
+        REQUIRE(4==factory.encoder().chunks);
+        REQUIRE("<ab\ncd\nef><ghijklmn><opqrstu\n><v\n>|"==factory.underlying_stream().str());
+    }
+    TEST_CASE("Compressing factory uses chunks of at least one byte") {
+        lbw::compression_options options;
+        options.chunk_size = 0;
+        testable_compressing_factory factory{options,"/tmp/test.log"};
+        factory.begin();
+        factory.write_text("ab\n");
+        factory.commit();
+        REQUIRE(3==factory.encoder().chunks);
+        REQUIRE("<a><b><\n>|"==factory.underlying_stream().str());
+    }
+    TEST_CASE("Compressing factory does not append the extension when disabled") {
+        lbw::compression_options options;
+        options.append_extension = false;
+        testable_compressing_factory factory{options,"/tmp/test-%NUM%.log.fake"};
+        factory.begin();
+        factory.commit();
+        REQUIRE("/tmp/test-0.log.fake"==factory.underlying_stream().last_file_name);
+        REQUIRE("|"==factory.underlying_stream().str());
+    }
+    TEST_CASE("Compressing factory discards the batch when the encoder fails") {
+        testable_compressing_factory factory{lbw::compression_options{},"/tmp/test.log"};
+        factory.encoder().fail_compress = true;
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(EIO==factory.last_error());
+        REQUIRE_FALSE(factory.underlying_stream().is_open);
+        REQUIRE(""==factory.underlying_stream().str());
+    }
+    TEST_CASE("Compressing factory can be used with line_buffer") {
+        lbw::line_buffer<lbw::batch_stream_writer<testable_compressing_factory>,lbw::line_arena> lb{2u,lbw::compression_options{},"/tmp/test-%NUM%.log"};
+        lb.write("test1");
+        lb.write("test2");
+        auto& factory = lb.sink().factory();
+        REQUIRE("/tmp/test-0.log.fake"==factory.underlying_stream().last_file_name);
+        REQUIRE("<test1\ntest2\n>|"==factory.underlying_stream().str());
+    }
+#ifdef LINE_BASED_WRITERS_HAS_ZSTD
+    TEST_CASE("zstd encoder produces a frame that decompresses to the lines") {
+        lbw::compression_options options;
+        options.level = 3;
+        options.chunk_size = 16;
+        lbw::compressing_file_stream_factory_no_stream<compressed_stream,lbw::zstd_encoder> factory{options,"/tmp/test.log"};
+        factory.begin();
+        std::string expected;
+        for (int i=0;i<1000;i++) {
+            auto line = "line "+std::to_string(i);
+            factory.write(line);
+            expected += line+"\n";
+        }
+        factory.commit();
+        REQUIRE("/tmp/test.log.zst"==factory.underlying_stream().last_file_name);
+        auto compressed = factory.underlying_stream().str();
+        REQUIRE(std::size(compressed)<std::size(expected));
+        std::string decompressed(std::size(expected),'\0');
+        auto size = ZSTD_decompress(std::data(decompressed),std::size(decompressed),std::data(compressed),std::size(compressed));
+        REQUIRE_FALSE(ZSTD_isError(size));
+        decompressed.resize(size);
+        REQUIRE(expected==decompressed);
+    }
+#endif
+}
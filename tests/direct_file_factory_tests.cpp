@@ -0,0 +1,142 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include "temp_dir.h"
+#include <csignal>
+#include <sys/resource.h>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+
+    lbw::direct_io_options buffer_size(std::size_t size) {
+        lbw::direct_io_options options;
+        options.buffer_size = size;
+        return options;
+    }
+
+    /// file_size_limit limits the size of the files the process writes, so writes beyond it fail with EFBIG instead of
+    /// raising SIGXFSZ. The limit and the signal handler are restored by the destructor.
+    class file_size_limit {
+        rlimit previous_{};
+        void (*handler_)(int);
+    public:
+        explicit file_size_limit(rlim_t size) : handler_{std::signal(SIGXFSZ,SIG_IGN)} {
+            ::getrlimit(RLIMIT_FSIZE,&previous_);
+            rlimit limit{size,previous_.rlim_max};
+            ::setrlimit(RLIMIT_FSIZE,&limit);
+        }
+        file_size_limit(const file_size_limit&) = delete;
+        file_size_limit& operator=(const file_size_limit&) = delete;
+        ~file_size_limit() {
+            ::setrlimit(RLIMIT_FSIZE,&previous_);
+            std::signal(SIGXFSZ,handler_);
+        }
+    };
+
+}
+
+TEST_SUITE("Direct file factory tests") {
+    TEST_CASE("Direct file factory pads the last block and truncates to the lines") {
+        temp_dir dir;
+        auto first = dir.file("test-0000.txt");
+        auto second = dir.file("test-0001.txt");
+        lbw::direct_file_factory factory{buffer_size(4096),dir.path()+"/test-%NUM:4%.txt"};
+        factory.begin();
+        factory.write("test1");
+        factory.write("test2"sv);
+        factory.commit();
+        REQUIRE(0==factory.last_error());
+        REQUIRE("test1\ntest2\n"==read_file(first));
+        SUBCASE("New begin should create new file") {
+            factory.begin();
+            factory.commit();
+            REQUIRE(0==factory.last_error());
+            REQUIRE(file_exists(second));
+            REQUIRE(""==read_file(second));
+        }
+    }
+    TEST_CASE("Direct file factory writes segments larger than the buffer") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        lbw::direct_file_factory factory{buffer_size(1),file};
+        std::string expected;
+        factory.begin();
+        for (int i=0;i<5000;i++) {
+            auto line = std::string(static_cast<std::size_t>(i%7),'x')+std::to_string(i);
+            factory.write(line);
+            expected += line+"\n";
+        }
+        factory.commit();
+        REQUIRE(0==factory.last_error());
+        REQUIRE(expected==read_file(file));
+    }
+    TEST_CASE("Direct file factory reports errors when the file cannot be created") {
+        lbw::direct_file_factory factory{lbw::direct_io_options{},"/nonexistent-directory/test.txt"};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(ENOENT==factory.last_error());
+    }
+    TEST_CASE("Direct file factory removes a file that could not be written") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        lbw::direct_file_factory factory{buffer_size(4096),file};
+        file_size_limit limit{4096};
+        factory.begin();
+        REQUIRE(file_exists(file));
+        SUBCASE("Writing a full buffer fails") {
+            factory.write(std::string(8192,'x'));
+            REQUIRE(EFBIG==factory.last_error());
+            REQUIRE_FALSE(file_exists(file));
+            factory.write("test1");
+            factory.commit();
+        }
+        SUBCASE("Writing the last block in commit fails") {
+            factory.write(std::string(5000,'x'));
+            REQUIRE(0==factory.last_error());
+            factory.commit();
+        }
+        REQUIRE(EFBIG==factory.last_error());
+        REQUIRE_FALSE(file_exists(file));
+    }
+    TEST_CASE("Direct file factory reports an invalid alignment") {
+        lbw::direct_io_options options;
+        options.alignment = 3000;
+        lbw::direct_file_factory factory{options,"/tmp/test.txt"};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(ENOMEM==factory.last_error());
+    }
+    TEST_CASE("Direct file factory can be used with line_buffer_ts") {
+        temp_dir dir;
+        auto first = dir.file("test-0.txt");
+        auto second = dir.file("test-1.txt");
+        dir.file("test-2.txt");
+        {
+            lbw::segmented_line_based_direct_writer_ts writer{2u,lbw::direct_io_options{},dir.path()+"/test-%NUM%.txt"};
+            writer.write("test1");
+            writer.write("test2");
+            writer.write("test3");
+        }
+        REQUIRE("test1\ntest2\n"==read_file(first));
+        REQUIRE("test3\n"==read_file(second));
+    }
+    TEST_CASE("drop_page_cache writes segments back before closing them") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        lbw::fd_file_factory_uncached factory{file};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(0==factory.last_error());
+        REQUIRE(1==factory.durability().metrics().sync_latency.count);
+        REQUIRE("test1\n"==read_file(file));
+    }
+}
+
+#endif
@@ -0,0 +1,166 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include "temp_dir.h"
+#include <chrono>
+#include <thread>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+
+    /// wait_for_durable polls the metrics of a policy until count segments are durable or a second passed.
+    template <typename Tpolicy>
+    bool wait_for_durable(Tpolicy& policy, std::uint64_t count) {
+        auto deadline = std::chrono::steady_clock::now()+1s;
+        while (policy.metrics().durable_latency.count<count) {
+            if (std::chrono::steady_clock::now()>deadline) return false;
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+
+    lbw::group_commit_options group_commit(std::chrono::steady_clock::duration max_delay, std::size_t max_segments, lbw::group_commit_options::sync_mode mode = lbw::group_commit_options::sync_mode::fdatasync) {
+        lbw::group_commit_options options;
+        options.max_delay = max_delay;
+        options.max_segments = max_segments;
+        options.mode = mode;
+        return options;
+    }
+
+}
+
+TEST_SUITE("Durability policy tests") {
+    TEST_CASE("latency_stats accumulates latencies") {
+        lbw::latency_stats stats;
+        REQUIRE(0ns==stats.mean());
+        stats.add(10ns);
+        stats.add(30ns);
+        REQUIRE(2==stats.count);
+        REQUIRE(40ns==stats.total);
+        REQUIRE(30ns==stats.max);
+        REQUIRE(20ns==stats.mean());
+    }
+    TEST_CASE("no_durability counts segments without syncing") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        lbw::fd_file_factory factory{file};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(0==factory.wait_durable());
+        REQUIRE(1==factory.durability().metrics().segments);
+        REQUIRE(0==factory.durability().metrics().sync_latency.count);
+        REQUIRE("test1\n"==read_file(file));
+    }
+    TEST_CASE("fdatasync_durability syncs every segment in commit") {
+        temp_dir dir;
+        dir.file("test-0.txt");
+        dir.file("test-1.txt");
+        lbw::fd_file_factory_fdatasync factory{dir.path()+"/test-%NUM%.txt"};
+        for (int i=0;i<2;i++) {
+            factory.begin();
+            factory.write("test"+std::to_string(i));
+            factory.commit();
+        }
+        REQUIRE(0==factory.last_error());
+        auto metrics = factory.durability().metrics();
+        REQUIRE(2==metrics.segments);
+        REQUIRE(2==metrics.sync_latency.count);
+        REQUIRE(2==metrics.durable_latency.count);
+        REQUIRE("test1\n"==read_file(dir.path()+"/test-1.txt"));
+    }
+    TEST_CASE("parent_directory returns the directory containing a file") {
+        REQUIRE("/tmp/logs"==lbw::posix_io::parent_directory("/tmp/logs/test.txt"));
+        REQUIRE("/"==lbw::posix_io::parent_directory("/test.txt"));
+        REQUIRE("."==lbw::posix_io::parent_directory("test.txt"));
+    }
+    TEST_CASE("fdatasync_durability syncs the directory of a published segment") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        lbw::fd_file_factory_atomic factory{file};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(0==factory.last_error());
+        REQUIRE("test1\n"==read_file(file));
+        REQUIRE(0==factory.durability().published(file));
+        REQUIRE(ENOENT==factory.durability().published(dir.path()+"/missing/test.txt"));
+    }
+    TEST_CASE("group_commit_durability syncs pending segments in one pass on wait") {
+        temp_dir dir;
+        for (int i=0;i<3;i++) dir.file("test-"+std::to_string(i)+".txt");
+        lbw::fd_file_factory_group_commit factory{lbw::group_commit_durability{group_commit(1h,100)},dir.path()+"/test-%NUM%.txt"};
+        for (int i=0;i<3;i++) {
+            factory.begin();
+            factory.write("test"+std::to_string(i));
+            factory.commit();
+        }
+        REQUIRE(0==factory.durability().metrics().durable_latency.count);
+        REQUIRE(0==factory.wait_durable());
+        auto metrics = factory.durability().metrics();
+        REQUIRE(3==metrics.segments);
+        REQUIRE(1==metrics.sync_latency.count);
+        REQUIRE(3==metrics.durable_latency.count);
+        for (int i=0;i<3;i++) {
+            REQUIRE("test"+std::to_string(i)+"\n"==read_file(dir.path()+"/test-"+std::to_string(i)+".txt"));
+        }
+    }
+    TEST_CASE("group_commit_durability starts a group commit when max_segments are pending") {
+        temp_dir dir;
+        dir.file("test-0.txt");
+        dir.file("test-1.txt");
+        lbw::fd_file_factory_group_commit factory{lbw::group_commit_durability{group_commit(1h,2)},dir.path()+"/test-%NUM%.txt"};
+        for (int i=0;i<2;i++) {
+            factory.begin();
+            factory.write("test");
+            factory.commit();
+        }
+        REQUIRE(wait_for_durable(factory.durability(),2));
+        REQUIRE(1==factory.durability().metrics().sync_latency.count);
+    }
+    TEST_CASE("group_commit_durability starts a group commit after max_delay") {
+        temp_dir dir;
+        dir.file("test.txt");
+        lbw::fd_file_factory_group_commit factory{lbw::group_commit_durability{group_commit(5ms,100)},dir.path()+"/test.txt"};
+        factory.begin();
+        factory.write("test");
+        factory.commit();
+        REQUIRE(wait_for_durable(factory.durability(),1));
+        REQUIRE(factory.durability().metrics().durable_latency.max>=5ms);
+    }
+    TEST_CASE("group_commit_durability syncs the directories of published segments with the group") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        lbw::group_commit_durability durability{group_commit(1h,100)};
+        REQUIRE(0==durability.published(file));
+        REQUIRE(0==durability.published(file));
+        REQUIRE(0==durability.wait());
+        REQUIRE(0==durability.published(dir.path()+"/missing/test.txt"));
+        REQUIRE(ENOENT==durability.wait());
+        auto metrics = durability.metrics();
+        REQUIRE(0==metrics.segments);
+        REQUIRE(2==metrics.sync_latency.count);
+        REQUIRE(0==metrics.durable_latency.count);
+    }
+#ifdef __linux__
+    TEST_CASE("group_commit_durability can sync the filesystem with syncfs") {
+        temp_dir dir;
+        auto file = dir.file("test-0.txt");
+        dir.file("test-1.txt");
+        {
+            lbw::segmented_line_based_group_commit_writer_ts writer{2u,lbw::group_commit_durability{group_commit(1h,100,lbw::group_commit_options::sync_mode::syncfs)},dir.path()+"/test-%NUM%.txt"};
+            writer.write("test1");
+            writer.write("test2");
+            REQUIRE(0==writer.sink().factory().wait_durable());
+            REQUIRE(1==writer.sink().factory().durability().metrics().sync_latency.count);
+        }
+        REQUIRE("test1\ntest2\n"==read_file(file));
+    }
+#endif
+}
+
+#endif
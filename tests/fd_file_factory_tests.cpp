@@ -0,0 +1,122 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include "temp_dir.h"
+#include <sys/stat.h>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+TEST_SUITE("Fd file factory tests") {
+    TEST_CASE("Can write batches to files with fd_file_factory") {
+        temp_dir dir;
+        auto first = dir.file("test-0000.txt");
+        auto second = dir.file("test-0001.txt");
+        lbw::fd_file_factory factory{dir.path()+"/test-%NUM:4%.txt"};
+        std::vector<std::string> lines{"test1","test2"};
+        factory.begin();
+        for (const auto& line : lines) factory.write(line);
+        factory.commit();
+        REQUIRE(0==factory.last_error());
+        REQUIRE("test1\ntest2\n"==read_file(first));
+        SUBCASE("New begin should create new file") {
+            factory.begin();
+            factory.write("test3"sv);
+            factory.commit();
+            REQUIRE("test3\n"==read_file(second));
+        }
+    }
+    TEST_CASE("Fd file factory writes batches larger than the writev limit") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        {
+            lbw::segmented_line_based_fd_writer writer{10000u,file};
+            for (int i=0;i<5000;i++) {
+                writer.write(std::to_string(i));
+            }
+        }
+        std::string expected;
+        for (int i=0;i<5000;i++) {
+            expected += std::to_string(i)+"\n";
+        }
+        REQUIRE(expected==read_file(file));
+    }
+    TEST_CASE("Fd file factory reports errors when the file cannot be created") {
+        lbw::fd_file_factory factory{"/nonexistent-directory/test.txt"};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(ENOENT==factory.last_error());
+    }
+#ifdef __linux__
+    TEST_CASE("preallocate reserves space without changing the file size") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        auto fd = ::open(file.c_str(),O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC,0666);
+        REQUIRE(fd>=0);
+        REQUIRE(0==lbw::posix_io::preallocate(fd,1u<<20u));
+        struct stat st{};
+        REQUIRE(0==::fstat(fd,&st));
+        REQUIRE(0==st.st_size);
+        REQUIRE(0==lbw::posix_io::close_fd(fd));
+    }
+#endif
+    TEST_CASE("Preallocated fd file factory writes segments with their exact size") {
+        temp_dir dir;
+        auto first = dir.file("test-0.txt");
+        auto second = dir.file("test-1.txt");
+        auto third = dir.file("test-2.txt");
+        {
+            lbw::segmented_line_based_fd_writer_sized_ts writer{lbw::line_count_or_byte_size_policy{100,12},dir.path()+"/test-%NUM%.txt"};
+            writer.write("test1");
+            writer.write("test2");
+            writer.write("test3");
+            REQUIRE(0==writer.sink().factory().last_error());
+        }
+        REQUIRE("test1\ntest2\n"==read_file(first));
+        REQUIRE("test3\n"==read_file(second));
+        REQUIRE(""==read_file(third));
+    }
+    TEST_CASE("Atomic factories publish a file under its name only when it is complete") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        auto temporary = dir.file(".test.txt.tmp");
+        auto check = [&](auto& factory) {
+            factory.begin();
+            factory.write("test1");
+            REQUIRE(file_exists(temporary));
+            REQUIRE_FALSE(file_exists(file));
+            factory.commit();
+            REQUIRE(0==factory.last_error());
+            REQUIRE_FALSE(file_exists(temporary));
+            REQUIRE("test1\n"==read_file(file));
+            std::remove(file.c_str());
+        };
+        SUBCASE("file_stream_factory_atomic") {
+            lbw::file_stream_factory_atomic factory{file};
+            check(factory);
+        }
+        SUBCASE("fd_file_factory_atomic") {
+            lbw::fd_file_factory_atomic factory{file};
+            check(factory);
+        }
+    }
+    TEST_CASE("Atomic fd file factory replaces an existing file") {
+        temp_dir dir;
+        auto file = dir.file("test-0.txt");
+        dir.file("test-1.txt");
+        {
+            lbw::segmented_line_based_fd_writer_atomic_ts writer{1u,dir.path()+"/test-%NUM%.txt"};
+            writer.write("test1");
+        }
+        {
+            lbw::segmented_line_based_fd_writer_atomic_ts writer{1u,dir.path()+"/test-%NUM%.txt"};
+            writer.write("test2");
+        }
+        REQUIRE("test2\n"==read_file(file));
+    }
+}
+
+#endif
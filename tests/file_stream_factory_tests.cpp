@@ -35,7 +35,20 @@ std::chrono::system_clock::time_point fake_now() {
     return std::chrono::system_clock::time_point{134055123456789ns};
 }
 
+std::chrono::system_clock::time_point fake_system_time{134055123456789ns};
+
+std::chrono::system_clock::time_point fake_system_now() {
+    return fake_system_time;
+}
+
+std::chrono::steady_clock::time_point fake_steady_time{};
+
+std::chrono::steady_clock::time_point fake_steady_now() {
+    return fake_steady_time;
+}
+
 using testable_file_stream_factory = lbw::file_stream_factory_no_stream<fake_stream>;
+using testable_rotating_file_stream_factory = lbw::rotating_file_stream_factory_no_stream<fake_stream,fake_steady_now>;
 
 TEST_SUITE("File stream factory tests") {
     TEST_CASE("Can write to file_stream in file_stream_factory") {
@@ -124,5 +137,95 @@ TEST_SUITE("File stream factory tests") {
         lbw::file_name_generator<fake_now> fng("/tmp/test-%SECOND%.txt");
         REQUIRE("/tmp/test-15.txt"==fng.generate());
     }
+    TEST_CASE("Can create file_name_generator with template combining counter and date macros."){
+        lbw::file_name_generator<fake_now> fng("/logs/%YEAR%-%MONTH%-%DAY%/%HOUR%-%MINUTE%-%SECOND%-%COUNTER:3%");
+        REQUIRE("/logs/1970-01-02/13-14-15-000"==fng.generate());
+        REQUIRE("/logs/1970-01-02/13-14-15-001"==fng.generate());
+    }
+    TEST_CASE("file_name_generator renders unknown macros empty."){
+        lbw::file_name_generator fng("a-%UNKNOWN%-%NUM%-b");
+        REQUIRE("a--0-b"==fng.generate());
+    }
+    TEST_CASE("file_name_generator updates the date fields when the second changes."){
+        fake_system_time = std::chrono::system_clock::time_point{134055123456789ns};
+        lbw::file_name_generator<fake_system_now> fng("%HOUR%:%MINUTE%:%SECOND%");
+        REQUIRE("13:14:15"==fng.generate());
+        fake_system_time += 500ms;
+        REQUIRE("13:14:15"==fng.generate());
+        fake_system_time += 1s;
+        REQUIRE("13:14:16"==fng.generate());
+        fake_system_time += 1h;
+        REQUIRE("14:14:16"==fng.generate());
+    }
+    TEST_CASE("publish_by_rename writes to a hidden temporary file in the same directory") {
+        lbw::publish_by_rename policy;
+        REQUIRE("/tmp/.test.txt.tmp"==policy.temporary_name("/tmp/test.txt"));
+        REQUIRE(".test.txt.tmp"==policy.temporary_name("test.txt"));
+        lbw::file_stream_factory_template<lbw::file_name_generator<>,fake_stream,lbw::publish_by_rename> tfsf("/nonexistent-directory/test-%NUM:4%.txt");
+        tfsf.begin();
+        REQUIRE("/nonexistent-directory/.test-0000.txt.tmp"==tfsf.underlying_stream().last_file_name);
+        tfsf.write("test1");
+        tfsf.commit();
+        REQUIRE(ENOENT==tfsf.last_error());
+    }
+    TEST_CASE("Rotating file stream factory appends batches to the same file") {
+        testable_rotating_file_stream_factory trfsf(lbw::file_rotation{20,0s},"/tmp/test-%NUM:4%.txt");
+        trfsf.begin();
+        REQUIRE("/tmp/test-0000.txt"==trfsf.underlying_stream().last_file_name);
+        REQUIRE((std::ios::trunc|std::ios::binary|std::ios_base::out)==trfsf.underlying_stream().last_open_mode);
+        trfsf.write("test1");
+        trfsf.write("test2"s);
+        trfsf.commit();
+        REQUIRE(true==trfsf.underlying_stream().is_open);
+        REQUIRE(12u==trfsf.bytes());
+        trfsf.begin();
+        trfsf.write("test3"sv);
+        REQUIRE("/tmp/test-0000.txt"==trfsf.underlying_stream().last_file_name);
+        REQUIRE("test1\ntest2\ntest3\n"==trfsf.underlying_stream().str());
+        SUBCASE("File is closed when it reaches the maximum size after a batch") {
+            trfsf.write("test4");
+            trfsf.commit();
+            REQUIRE(false==trfsf.underlying_stream().is_open);
+            REQUIRE(true==trfsf.underlying_stream().is_clear);
+            SUBCASE("Next batch is written to a new file") {
+                trfsf.begin();
+                trfsf.write("test5");
+                trfsf.commit();
+                REQUIRE("/tmp/test-0001.txt"==trfsf.underlying_stream().last_file_name);
+                REQUIRE("test5\n"==trfsf.underlying_stream().str());
+                REQUIRE(6u==trfsf.bytes());
+            }
+        }
+    }
+    TEST_CASE("Rotating file stream factory rotates files on age") {
+        fake_steady_time = std::chrono::steady_clock::time_point{100s};
+        testable_rotating_file_stream_factory trfsf(lbw::file_rotation{0,60s},"/tmp/test-%NUM:4%.txt");
+        trfsf.begin();
+        trfsf.write("test1");
+        trfsf.commit();
+        fake_steady_time += 59s;
+        trfsf.begin();
+        trfsf.write("test2");
+        trfsf.commit();
+        REQUIRE("/tmp/test-0000.txt"==trfsf.underlying_stream().last_file_name);
+        REQUIRE(true==trfsf.underlying_stream().is_open);
+        SUBCASE("File is rotated when it is too old on begin") {
+            fake_steady_time += 1s;
+            trfsf.begin();
+            REQUIRE("/tmp/test-0001.txt"==trfsf.underlying_stream().last_file_name);
+            trfsf.write("test3");
+            trfsf.commit();
+            REQUIRE("test3\n"==trfsf.underlying_stream().str());
+        }
+    }
+    TEST_CASE("Rotating file stream factory reports a file that cannot be opened and opens a new file") {
+        lbw::rotating_file_stream_factory factory(lbw::file_rotation{},"/nonexistent-directory/test-%NUM:4%.txt");
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(ENOENT==factory.last_error());
+        REQUIRE(0u==factory.bytes());
+        factory.begin();
+        REQUIRE("/nonexistent-directory/test-0001.txt"==factory.file_name());
+    }
 }
-
@@ -0,0 +1,32 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+#include <atomic>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+class counting_sink {
+    std::shared_ptr<std::atomic<std::size_t>> lines_;
+public:
+    explicit counting_sink(std::shared_ptr<std::atomic<std::size_t>> lines) : lines_{std::move(lines)} {}
+
+    template<typename Iter>
+    void write(Iter b, Iter e) {
+        *lines_ += static_cast<std::size_t>(std::distance(b,e));
+    }
+};
+
+TEST_SUITE("Flush timer tests") {
+    TEST_CASE("Flush timer rolls segments of a line buffer without writes") {
+        auto lines = std::make_shared<std::atomic<std::size_t>>(0);
+        lbw::line_buffer_ts<counting_sink,lbw::line_arena,lbw::line_count_or_max_age_policy> lb{lbw::line_count_or_max_age_policy{1000,10ms},lines};
+        lbw::flush_timer timer{lb,1ms};
+        lb.write("line 1");
+        lb.write("line 2");
+        auto deadline = std::chrono::steady_clock::now()+5s;
+        while (*lines<2 && std::chrono::steady_clock::now()<deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        REQUIRE(2u==*lines);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef LINE_BASED_WRITERS_TESTS_TEMP_DIR_H
+#define LINE_BASED_WRITERS_TESTS_TEMP_DIR_H
+
+#include <string>
+#include <string_view>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <system_error>
+#include <cstdlib>
+#include <unistd.h>
+
+/// temp_dir creates a temporary directory and removes it and everything in it on destruction.
+class temp_dir {
+    std::string path_;
+public:
+    temp_dir() {
+        char tpl[] = "/tmp/lbw-test-XXXXXX";
+        path_ = ::mkdtemp(tpl);
+    }
+    temp_dir(const temp_dir&) = delete;
+    temp_dir& operator=(const temp_dir&) = delete;
+    ~temp_dir() {
+        std::error_code ec;
+        std::filesystem::remove_all(path_,ec);
+    }
+
+    /// file returns the path of a file in the temporary directory.
+    std::string file(std::string_view name) {
+        return path_+"/"+std::string{name};
+    }
+
+    [[nodiscard]] const std::string& path() const { return path_; }
+};
+
+/// read_file returns the contents of a file.
+inline std::string read_file(const std::string& name) {
+    std::ifstream in{name,std::ios::binary};
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+/// file_exists returns true when the file exists.
+inline bool file_exists(const std::string& name) {
+    return ::access(name.c_str(),F_OK)==0;
+}
+
+#endif //LINE_BASED_WRITERS_TESTS_TEMP_DIR_H
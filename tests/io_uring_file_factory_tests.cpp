@@ -0,0 +1,107 @@
+#include "doctest.h"
+
+#define CROSSCODE_ACCESS_TO_UNIT_TEST
+
+#include "line_based_writers.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_IO_URING
+
+#include "temp_dir.h"
+#include <thread>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+TEST_SUITE("io_uring file factory tests") {
+    TEST_CASE("Can write segments with io_uring_file_factory") {
+        for (auto use_io_uring : {true,false}) {
+            CAPTURE(use_io_uring);
+            temp_dir dir;
+            std::vector<std::string> files;
+            for (int i=0;i<10;i++) {
+                files.push_back(dir.file("test-"+std::to_string(i)+".txt"));
+            }
+            {
+                lbw::io_uring_options options;
+                options.max_in_flight = 4;
+                options.submit_batch = 2;
+                options.fsync = true;
+                options.use_io_uring = use_io_uring;
+                lbw::io_uring_file_factory factory{options,dir.path()+"/test-%NUM%.txt"};
+                if (!use_io_uring) {
+                    REQUIRE_FALSE(factory.uses_io_uring());
+                }
+                for (int i=0;i<10;i++) {
+                    factory.begin();
+                    factory.write("segment "+std::to_string(i));
+                    factory.write("line 2"sv);
+                    factory.commit();
+                }
+                factory.wait();
+                REQUIRE(0==factory.last_error());
+                for (int i=0;i<10;i++) {
+                    REQUIRE("segment "+std::to_string(i)+"\nline 2\n"==read_file(files[static_cast<std::size_t>(i)]));
+                }
+            }
+        }
+    }
+    TEST_CASE("io_uring file factory submits submit_batch segments with one system call") {
+        temp_dir dir;
+        std::vector<std::string> files;
+        for (int i=0;i<8;i++) {
+            files.push_back(dir.file("test-"+std::to_string(i)+".txt"));
+        }
+        lbw::io_uring_options options;
+        options.submit_batch = 4;
+        lbw::io_uring_file_factory factory{options,dir.path()+"/test-%NUM%.txt"};
+        if (!factory.uses_io_uring()) return;
+        for (int i=0;i<8;i++) {
+            factory.begin();
+            factory.write("segment "+std::to_string(i));
+            factory.commit();
+        }
+        REQUIRE(2==factory.enters());
+        factory.wait();
+        REQUIRE(0==factory.last_error());
+        for (int i=0;i<8;i++) {
+            REQUIRE("segment "+std::to_string(i)+"\n"==read_file(files[static_cast<std::size_t>(i)]));
+        }
+    }
+    TEST_CASE("io_uring file factory writes a committed segment without further calls") {
+        temp_dir dir;
+        auto file = dir.file("test-0.txt");
+        lbw::io_uring_options options;
+        options.fsync = true;
+        lbw::io_uring_file_factory factory{options,dir.path()+"/test-%NUM%.txt"};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        for (int i=0;i<500 && read_file(file)!="test1\n";i++) {
+            std::this_thread::sleep_for(10ms);
+        }
+        REQUIRE("test1\n"==read_file(file));
+    }
+    TEST_CASE("io_uring writer writes all segments on destruction") {
+        temp_dir dir;
+        auto first = dir.file("test-0.txt");
+        auto second = dir.file("test-1.txt");
+        {
+            lbw::segmented_line_based_io_uring_writer writer{2u,lbw::io_uring_options{},dir.path()+"/test-%NUM%.txt"};
+            writer.write("line 1");
+            writer.write("line 2");
+            writer.write("line 3");
+        }
+        REQUIRE("line 1\nline 2\n"==read_file(first));
+        REQUIRE("line 3\n"==read_file(second));
+    }
+    TEST_CASE("io_uring file factory reports errors when the file cannot be created") {
+        lbw::io_uring_file_factory factory{lbw::io_uring_options{},"/nonexistent-directory/test.txt"};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        factory.wait();
+        REQUIRE(ENOENT==factory.last_error());
+    }
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include "doctest.h"
+#include "line_based_writers/line_arena.h"
+#include <vector>
+#include <array>
+#include <cstddef>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+TEST_SUITE("Line arena tests") {
+    TEST_CASE("Can create empty line arena") {
+        lbw::line_arena arena;
+        REQUIRE(arena.empty());
+        REQUIRE(0u==arena.size());
+        REQUIRE(0u==arena.bytes());
+        REQUIRE(arena.begin()==arena.end());
+    }
+    TEST_CASE("Can append lines to line arena") {
+        lbw::line_arena arena;
+        arena.emplace_back("line 1");
+        arena.emplace_back("longer line 2"s);
+        arena.emplace_back(""sv);
+        REQUIRE(3u==arena.size());
+        REQUIRE(19u==arena.bytes());
+        REQUIRE("line 1"sv==arena[0]);
+        REQUIRE("longer line 2"sv==arena[1]);
+        REQUIRE(""sv==arena[2]);
+        SUBCASE("Can iterate lines in line arena") {
+            std::vector<std::string_view> lines(arena.begin(),arena.end());
+            REQUIRE(std::vector<std::string_view>{"line 1"sv,"longer line 2"sv,""sv}==lines);
+        }
+        SUBCASE("Can clear line arena") {
+            arena.clear();
+            REQUIRE(arena.empty());
+            REQUIRE(0u==arena.bytes());
+        }
+    }
+    TEST_CASE("Clearing line arena keeps memory for reuse") {
+        lbw::line_arena arena{2,64};
+        arena.emplace_back("line 1");
+        auto first = arena[0].data();
+        arena.clear();
+        arena.emplace_back("line 2");
+        REQUIRE(first==arena[0].data());
+        REQUIRE("line 2"sv==arena[0]);
+    }
+    TEST_CASE("Can append a line from the arena itself") {
+        lbw::line_arena arena;
+        arena.emplace_back("line 1");
+        for (int i=0;i<64;i++) {
+            arena.emplace_back(arena[0]);
+        }
+        REQUIRE(65u==arena.size());
+        REQUIRE("line 1"sv==arena[64]);
+    }
+    TEST_CASE("Line arena stores every line followed by a line separator") {
+        lbw::line_arena arena;
+        arena.emplace_back("line 1");
+        arena.emplace_back(""sv);
+        arena.emplace_back("line 3");
+        REQUIRE("line 1\n\nline 3\n"sv==arena.text());
+        REQUIRE(12u==arena.bytes());
+        auto b = arena.begin();
+        auto e = arena.end();
+        REQUIRE("line 1\n\nline 3\n"sv==lbw::line_arena::text(b,e));
+        ++b;
+        REQUIRE("\nline 3\n"sv==lbw::line_arena::text(b,e));
+        auto m = b;
+        ++m;
+        REQUIRE("\n"sv==lbw::line_arena::text(b,m));
+        REQUIRE(""sv==lbw::line_arena::text(e,e));
+    }
+    TEST_CASE("line_view views byte buffers as lines") {
+        std::array<unsigned char,3> bytes{'a','b','c'};
+        std::vector<std::byte> empty;
+        REQUIRE("abc"sv==lbw::line_view(bytes));
+        REQUIRE("ab"sv==lbw::line_view(std::data(bytes),2));
+        REQUIRE(lbw::line_view(empty).empty());
+    }
+    TEST_CASE("owns_lines only accepts storage that owns the bytes of its lines") {
+        static_assert(lbw::owns_lines<lbw::line_arena>::value);
+        static_assert(lbw::owns_lines<std::vector<std::string>>::value);
+        static_assert(!lbw::owns_lines<std::vector<std::string_view>>::value);
+    }
+}
@@ -1,6 +1,9 @@
 #include "doctest.h"
 #include "line_based_writers.h"
 #include <sstream>
+#include <thread>
+#include <map>
+#include <array>
 
 namespace lbw = crosscode::line_based_writers;
 using namespace std::literals;
@@ -27,9 +30,74 @@ class string_stream_factory {
 
 };
 
+namespace {
+    std::chrono::steady_clock::time_point fake_steady_time{};
+
+    std::chrono::steady_clock::time_point fake_steady_now() {
+        return fake_steady_time;
+    }
+}
+
+class recording_stream_factory {
+    std::vector<std::vector<std::string>> segments_;
+    public:
+    void begin() {
+        segments_.emplace_back();
+    }
+
+    template<typename Tline>
+    void write(Tline &&line) {
+        segments_.back().emplace_back(std::forward<Tline>(line));
+    }
+
+    void commit() {
+
+    }
+
+    const std::vector<std::vector<std::string>>& segments() const {
+        return segments_;
+    }
+};
+
+/// text_stream_factory records whether lines were passed one by one or as one contiguous text.
+class text_stream_factory {
+    std::stringstream ss_;
+    std::vector<std::string_view> texts_;
+    int lines_{};
+    public:
+    void begin() {
+        ss_.str("");
+        texts_.clear();
+    }
+
+    template<typename Tline>
+    void write(Tline &&line) {
+        ss_ << line << "\n";
+        lines_++;
+    }
+
+    void write_text(std::string_view text) {
+        ss_ << text;
+        texts_.push_back(text);
+    }
+
+    void commit() {
+
+    }
+
+    std::stringstream& current() { return ss_; }
+    const std::vector<std::string_view>& texts() const { return texts_; }
+    int lines() const { return lines_; }
+};
+
 using stringstream_stream_writer = lbw::stream_writer<std::stringstream>;
 using batch_stream_writer = lbw::line_buffer<lbw::batch_stream_writer<string_stream_factory>>;
 using batch_stream_writer_ts = lbw::line_buffer_ts<lbw::batch_stream_writer<string_stream_factory>>;
+using batch_stream_writer_arena = lbw::line_buffer<lbw::batch_stream_writer<string_stream_factory>,lbw::line_arena>;
+using batch_stream_writer_arena_ts = lbw::line_buffer_ts<lbw::batch_stream_writer<string_stream_factory>,lbw::line_arena>;
+using batch_stream_writer_sized = lbw::line_buffer<lbw::batch_stream_writer<string_stream_factory>,lbw::line_arena,lbw::line_count_or_byte_size_policy>;
+using batch_stream_writer_timed = lbw::line_buffer<lbw::batch_stream_writer<string_stream_factory>,lbw::line_arena,lbw::any_of_policy<lbw::line_count_policy,lbw::max_age_policy<fake_steady_now>>>;
+using batch_stream_writer_sharded = lbw::sharded_line_buffer<lbw::batch_stream_writer<recording_stream_factory>,lbw::line_arena>;
 
 TEST_SUITE("Line based writers tests") {
     TEST_CASE("Can create stream writer with header") {
@@ -100,4 +168,182 @@ TEST_SUITE("Line based writers tests") {
 
         }
     }
-}
\ No newline at end of file
+    TEST_CASE("Can create line buffer of 2 with line arena storage") {
+        batch_stream_writer_arena lb{2u};
+        SUBCASE("Can write line to line buffer, but is not outputted to sink yet") {
+            lb.write("line 1");
+            REQUIRE(""==lb.sink().factory().current().str());
+            SUBCASE("Can write another line to line buffer, but is outputted to sink") {
+                lb.write("line 2"s);
+                REQUIRE("line 1\nline 2\n"==lb.sink().factory().current().str());
+                SUBCASE("Can write another line to line buffer, but is outputted to sink on emit") {
+                    lb.write("line 3"sv);
+                    lb.emit();
+                    REQUIRE("line 3\n"==lb.sink().factory().current().str());
+                }
+            }
+        }
+    }
+    TEST_CASE("Line buffer with line arena storage passes a segment as one text to the factory") {
+        lbw::line_buffer<lbw::batch_stream_writer<text_stream_factory>,lbw::line_arena> lb{3u};
+        std::string line{"line 1"};
+        lb.write(line);
+        line = "line 2";
+        lb.write(line);
+        lb.write(lbw::line_view(std::vector<std::byte>{std::byte{'l'},std::byte{'3'}}));
+        auto& factory = lb.sink().factory();
+        REQUIRE("line 1\nline 2\nl3\n"==factory.current().str());
+        REQUIRE(1==std::size(factory.texts()));
+        REQUIRE(0==factory.lines());
+    }
+    TEST_CASE("Line buffer with string storage passes lines one by one to a factory with write_text") {
+        lbw::line_buffer<lbw::batch_stream_writer<text_stream_factory>> lb{2u};
+        lb.write("line 1");
+        lb.write("line 2");
+        REQUIRE("line 1\nline 2\n"==lb.sink().factory().current().str());
+        REQUIRE(lb.sink().factory().texts().empty());
+        REQUIRE(2==lb.sink().factory().lines());
+    }
+    TEST_CASE("Line buffer splits a group of lines across segment boundaries") {
+        lbw::line_buffer<lbw::batch_stream_writer<recording_stream_factory>,lbw::line_arena> lb{3u};
+        std::vector<std::string> group{"1","2","3","4","5","6","7"};
+        lb.write(std::begin(group),std::end(group));
+        auto& segments = lb.sink().factory().segments();
+        REQUIRE(std::vector<std::vector<std::string>>{{"1","2","3"},{"4","5","6"}}==segments);
+        SUBCASE("A range continues the buffered segment") {
+            lb.write(std::array<std::string_view,2>{"8"sv,"9"sv});
+            REQUIRE(std::vector<std::string>{"7","8","9"}==segments.back());
+        }
+    }
+    TEST_CASE("Thread safe line buffer writes groups of lines contiguously") {
+        constexpr int thread_count = 4;
+        constexpr int group_count = 100;
+        lbw::line_buffer_ts<lbw::batch_stream_writer<recording_stream_factory>,lbw::line_arena> lb{1000u};
+        std::vector<std::thread> threads;
+        for (int t=0;t<thread_count;t++) {
+            threads.emplace_back([&lb,t]{
+                for (int g=0;g<group_count;g++) {
+                    std::vector<std::string> group;
+                    for (int i=0;i<5;i++) group.push_back(std::to_string(t)+" "+std::to_string(i));
+                    if (g%2==0) {
+                        lb.write(std::begin(group),std::end(group));
+                    } else {
+                        lb.write(group);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        lb.emit();
+        std::vector<std::string> lines;
+        for (const auto& segment : lb.sink().factory().segments()) {
+            lines.insert(std::end(lines),std::begin(segment),std::end(segment));
+        }
+        REQUIRE(static_cast<std::size_t>(thread_count*group_count*5)==std::size(lines));
+        for (std::size_t i=0;i<std::size(lines);i+=5) {
+            auto t = lines[i].substr(0,lines[i].find(' '));
+            for (int j=0;j<5;j++) {
+                REQUIRE(t+" "+std::to_string(j)==lines[i+static_cast<std::size_t>(j)]);
+            }
+        }
+    }
+    TEST_CASE("Sharded line buffer writes a group of lines to one shard") {
+        batch_stream_writer_sharded lb{2u,4u};
+        std::vector<std::string> group{"1","2","3"};
+        lb.write(group);
+        lb.emit();
+        REQUIRE(std::vector<std::vector<std::string>>{{"1","2"},{"3"}}==lb.sink().factory().segments());
+    }
+    TEST_CASE("Can create thread safe line buffer of 2 with line arena storage") {
+        batch_stream_writer_arena_ts lb{2u};
+        lb.write("line 1");
+        REQUIRE(""==lb.sink().factory().current().str());
+        lb.write("line 2");
+        REQUIRE("line 1\nline 2\n"==lb.sink().factory().current().str());
+    }
+    TEST_CASE("Can create sharded line buffer of 2 with 4 shards") {
+        batch_stream_writer_sharded lb{2u,4u};
+        REQUIRE(4u==lb.shards());
+        SUBCASE("Can write lines to sharded line buffer, but is only outputted to sink when shard is full") {
+            lb.write("line 1");
+            REQUIRE(lb.sink().factory().segments().empty());
+            lb.write("line 2");
+            REQUIRE(std::vector<std::vector<std::string>>{{"line 1","line 2"}}==lb.sink().factory().segments());
+            SUBCASE("Emit only writes shards that contain lines") {
+                lb.write("line 3");
+                lb.emit();
+                REQUIRE(std::vector<std::vector<std::string>>{{"line 1","line 2"},{"line 3"}}==lb.sink().factory().segments());
+            }
+        }
+    }
+    TEST_CASE("Sharded line buffer preserves order of lines per thread") {
+        constexpr int thread_count = 4;
+        constexpr int line_count = 1000;
+        batch_stream_writer_sharded lb{7u,2u};
+        std::vector<std::thread> threads;
+        for (int t=0;t<thread_count;t++) {
+            threads.emplace_back([&lb,t]{
+                for (int i=0;i<line_count;i++) {
+                    lb.write(std::to_string(t)+" "+std::to_string(i));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        lb.emit();
+        std::map<int,int> next;
+        std::size_t total{};
+        for (const auto& segment : lb.sink().factory().segments()) {
+            for (const auto& line : segment) {
+                auto space = line.find(' ');
+                auto t = std::stoi(line.substr(0,space));
+                auto i = std::stoi(line.substr(space+1));
+                REQUIRE(next[t]==i);
+                next[t]=i+1;
+                total++;
+            }
+        }
+        REQUIRE(static_cast<std::size_t>(thread_count*line_count)==total);
+    }
+    TEST_CASE("Can create line buffer that rolls on 3 lines or 16 bytes") {
+        batch_stream_writer_sized lb{lbw::line_count_or_byte_size_policy{3,16}};
+        SUBCASE("Rolls on byte size when lines are long") {
+            lb.write("long line 1");
+            REQUIRE(""==lb.sink().factory().current().str());
+            lb.write("long line 2");
+            REQUIRE("long line 1\nlong line 2\n"==lb.sink().factory().current().str());
+        }
+        SUBCASE("Rolls on line count when lines are short") {
+            lb.write("1");
+            lb.write("2");
+            REQUIRE(""==lb.sink().factory().current().str());
+            lb.write("3");
+            REQUIRE("1\n2\n3\n"==lb.sink().factory().current().str());
+            SUBCASE("Counting starts again after a roll") {
+                lb.write("4");
+                lb.write("5");
+                REQUIRE("1\n2\n3\n"==lb.sink().factory().current().str());
+            }
+        }
+    }
+    TEST_CASE("Can create line buffer that rolls on 3 lines or an age of 5 seconds") {
+        batch_stream_writer_timed lb{lbw::any_of_policy{lbw::line_count_policy{3},lbw::max_age_policy<fake_steady_now>{5s}}};
+        lb.write("line 1");
+        fake_steady_time += 4s;
+        lb.poll();
+        REQUIRE(""==lb.sink().factory().current().str());
+        SUBCASE("Poll rolls the segment when the oldest line is too old") {
+            fake_steady_time += 1s;
+            lb.poll();
+            REQUIRE("line 1\n"==lb.sink().factory().current().str());
+        }
+        SUBCASE("Write rolls the segment when the oldest line is too old") {
+            fake_steady_time += 1s;
+            lb.write("line 2");
+            REQUIRE("line 1\nline 2\n"==lb.sink().factory().current().str());
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#include "doctest.h"
+
+#define CROSSCODE_ACCESS_TO_UNIT_TEST
+
+#include "line_based_writers.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include "temp_dir.h"
+#include <sys/stat.h>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+
+    lbw::mmap_options segment_size(std::size_t size) {
+        lbw::mmap_options options;
+        options.segment_size = size;
+        return options;
+    }
+
+    /// file_size returns the size of a file.
+    off_t file_size(const std::string& name) {
+        struct stat st{};
+        ::stat(name.c_str(),&st);
+        return st.st_size;
+    }
+
+}
+
+TEST_SUITE("Mmap file factory tests") {
+    TEST_CASE("Mmap file factory allocates the segment size and truncates to the written lines") {
+        temp_dir dir;
+        auto first = dir.file("test-0000.txt");
+        auto second = dir.file("test-0001.txt");
+        lbw::mmap_file_factory factory{segment_size(1u<<20u),dir.path()+"/test-%NUM:4%.txt"};
+        factory.begin();
+        REQUIRE((1u<<20u)==factory.mapped_size());
+        REQUIRE((1u<<20u)==file_size(first));
+        factory.write("test1");
+        factory.write("test2"sv);
+        factory.commit();
+        REQUIRE(0==factory.last_error());
+        REQUIRE(0==factory.mapped_size());
+        REQUIRE("test1\ntest2\n"==read_file(first));
+        SUBCASE("New begin should create new file") {
+            factory.begin();
+            factory.commit();
+            REQUIRE(file_exists(second));
+            REQUIRE(""==read_file(second));
+        }
+    }
+    TEST_CASE("Mmap file factory grows the mapping when a segment is larger than the segment size") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        lbw::mmap_options options = segment_size(0);
+        options.sync = true;
+        lbw::mmap_file_factory factory{options,file};
+        factory.begin();
+        auto page = factory.mapped_size();
+        REQUIRE(page>0);
+        std::string expected;
+        for (int i=0;i<10000;i++) {
+            auto line = std::to_string(i);
+            factory.write(line);
+            expected += line+"\n";
+        }
+        REQUIRE(factory.mapped_size()>page);
+        factory.commit();
+        REQUIRE(0==factory.last_error());
+        REQUIRE(expected==read_file(file));
+    }
+    TEST_CASE("Atomic mmap file factory publishes a segment when it is complete") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        auto temporary = dir.file(".test.txt.tmp");
+        lbw::mmap_file_factory_atomic factory{segment_size(1u<<16u),file};
+        factory.begin();
+        factory.write("test1");
+        REQUIRE(file_exists(temporary));
+        REQUIRE_FALSE(file_exists(file));
+        factory.commit();
+        REQUIRE_FALSE(file_exists(temporary));
+        REQUIRE("test1\n"==read_file(file));
+    }
+    TEST_CASE("Durable mmap file factory syncs the segment and its directory") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        auto temporary = dir.file(".test.txt.tmp");
+        auto options = segment_size(1u<<16u);
+        options.sync = true;
+        lbw::mmap_file_factory_durable factory{options,file};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(0==factory.last_error());
+        REQUIRE_FALSE(file_exists(temporary));
+        REQUIRE("test1\n"==read_file(file));
+        lbw::publish_by_durable_rename policy;
+        REQUIRE(ENOENT==policy.publish(temporary,file));
+    }
+    TEST_CASE("Mmap file factory reports errors when the file cannot be created") {
+        lbw::mmap_file_factory factory{lbw::mmap_options{},"/nonexistent-directory/test.txt"};
+        factory.begin();
+        factory.write("test1");
+        factory.commit();
+        REQUIRE(ENOENT==factory.last_error());
+    }
+    TEST_CASE("Mmap file factory removes a segment that could not be allocated") {
+        temp_dir dir;
+        auto file = dir.file("test.txt");
+        lbw::mmap_file_factory factory{segment_size(4096),file};
+        factory.begin();
+        factory.write("test1");
+        REQUIRE(file_exists(file));
+        // Allocating a file larger than the filesystem supports fails before the text is read.
+        factory.write_text(std::string_view{file.c_str(),(std::size_t{1}<<60u)+std::size(file)});
+        factory.write("test3");
+        factory.commit();
+        REQUIRE(0!=factory.last_error());
+        REQUIRE_FALSE(file_exists(file));
+    }
+    TEST_CASE("Mmap file factory can be used with line_buffer_ts") {
+        temp_dir dir;
+        auto first = dir.file("test-0.txt");
+        auto second = dir.file("test-1.txt");
+        dir.file("test-2.txt");
+        {
+            lbw::segmented_line_based_mmap_writer_ts writer{2u,segment_size(4096),dir.path()+"/test-%NUM%.txt"};
+            writer.write("test1");
+            writer.write("test2");
+            writer.write("test3");
+        }
+        REQUIRE("test1\ntest2\n"==read_file(first));
+        REQUIRE("test3\n"==read_file(second));
+    }
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include "doctest.h"
+
+#define CROSSCODE_ACCESS_TO_UNIT_TEST
+
+#include "line_based_writers.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <map>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+class segment_recorder {
+    std::vector<std::vector<std::string>> segments_;
+public:
+    template<typename Iter>
+    void write(Iter b, Iter e) {
+        auto& segment = segments_.emplace_back();
+        std::for_each(b,e,[&segment](std::string_view line){ segment.emplace_back(line); });
+    }
+
+    const std::vector<std::vector<std::string>>& segments() const {
+        return segments_;
+    }
+};
+
+struct shared_recorder {
+    std::shared_ptr<std::vector<std::string>> lines;
+    template<typename Iter>
+    void write(Iter b, Iter e) {
+        std::for_each(b,e,[this](std::string_view line){ lines->emplace_back(line); });
+    }
+};
+
+struct segment_counter {
+    std::shared_ptr<std::atomic<std::size_t>> segments;
+    template<typename Iter>
+    void write(Iter, Iter) {
+        (*segments)++;
+    }
+};
+
+using ring_line_buffer = lbw::mpsc_ring_line_buffer<segment_recorder>;
+
+TEST_SUITE("MPSC ring line buffer tests") {
+    TEST_CASE("Can create ring line buffer of 2") {
+        ring_line_buffer lb{2u,4u,16u};
+        lb.write("line 1");
+        lb.write("line 2"s);
+        lb.write("line 3"sv);
+        lb.emit();
+        REQUIRE(std::vector<std::vector<std::string>>{{"line 1","line 2"},{"line 3"}}==lb.sink().segments());
+        SUBCASE("Emit does not write empty segments") {
+            lb.emit();
+            REQUIRE(2u==lb.sink().segments().size());
+        }
+    }
+    TEST_CASE("Ring line buffer stores lines longer than the slot size") {
+        ring_line_buffer lb{2u,2u,4u};
+        lb.write("short");
+        lb.write("");
+        lb.write("this line is longer than a slot");
+        lb.emit();
+        REQUIRE(std::vector<std::vector<std::string>>{{"short",""},{"this line is longer than a slot"}}==lb.sink().segments());
+    }
+    TEST_CASE("Ring line buffer wraps around when more lines are written than it has slots") {
+        ring_line_buffer lb{3u,4u,8u};
+        for (int i=0;i<100;i++) {
+            lb.write(std::to_string(i));
+        }
+        lb.emit();
+        std::size_t expected{};
+        for (const auto& segment : lb.sink().segments()) {
+            REQUIRE(segment.size()<=3u);
+            for (const auto& line : segment) {
+                REQUIRE(std::to_string(expected++)==line);
+            }
+        }
+        REQUIRE(100u==expected);
+    }
+    TEST_CASE("Ring line buffer writes all lines of multiple writers") {
+        constexpr int thread_count = 4;
+        constexpr int line_count = 1000;
+        ring_line_buffer lb{16u,64u,16u};
+        std::vector<std::thread> threads;
+        for (int t=0;t<thread_count;t++) {
+            threads.emplace_back([&lb,t]{
+                for (int i=0;i<line_count;i++) {
+                    lb.write(std::to_string(t)+" "+std::to_string(i));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        lb.emit();
+        std::map<int,int> next;
+        std::size_t total{};
+        for (const auto& segment : lb.sink().segments()) {
+            for (const auto& line : segment) {
+                auto space = line.find(' ');
+                auto t = std::stoi(line.substr(0,space));
+                auto i = std::stoi(line.substr(space+1));
+                REQUIRE(next[t]==i);
+                next[t]=i+1;
+                total++;
+            }
+        }
+        REQUIRE(static_cast<std::size_t>(thread_count*line_count)==total);
+    }
+    TEST_CASE("Ring line buffer with a capacity of 1 writes all lines of multiple writers") {
+        constexpr int thread_count = 4;
+        constexpr int line_count = 5000;
+        ring_line_buffer lb{1u,1u,8u};
+        std::vector<std::thread> threads;
+        for (int t=0;t<thread_count;t++) {
+            threads.emplace_back([&lb,t]{
+                for (int i=0;i<line_count;i++) {
+                    lb.write(std::to_string(t)+" "+std::to_string(i));
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        lb.emit();
+        std::map<int,int> next;
+        std::size_t total{};
+        for (const auto& segment : lb.sink().segments()) {
+            REQUIRE(1u==segment.size());
+            auto space = segment[0].find(' ');
+            auto t = std::stoi(segment[0].substr(0,space));
+            REQUIRE(next[t]==std::stoi(segment[0].substr(space+1)));
+            next[t]++;
+            total++;
+        }
+        REQUIRE(static_cast<std::size_t>(thread_count*line_count)==total);
+    }
+    TEST_CASE("Ring line buffer reserves the slots of a group of lines at once") {
+        constexpr int thread_count = 4;
+        constexpr int group_count = 200;
+        ring_line_buffer lb{16u,32u,16u};
+        std::vector<std::thread> threads;
+        for (int t=0;t<thread_count;t++) {
+            threads.emplace_back([&lb,t]{
+                std::vector<std::string> group;
+                for (int i=0;i<5;i++) group.push_back(std::to_string(t)+" "+std::to_string(i));
+                for (int g=0;g<group_count;g++) {
+                    lb.write(group);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        lb.emit();
+        std::vector<std::string> lines;
+        for (const auto& segment : lb.sink().segments()) {
+            REQUIRE(segment.size()<=16u);
+            lines.insert(std::end(lines),std::begin(segment),std::end(segment));
+        }
+        REQUIRE(static_cast<std::size_t>(thread_count*group_count*5)==std::size(lines));
+        for (std::size_t i=0;i<std::size(lines);i+=5) {
+            auto t = lines[i].substr(0,lines[i].find(' '));
+            for (int j=0;j<5;j++) {
+                REQUIRE(t+" "+std::to_string(j)==lines[i+static_cast<std::size_t>(j)]);
+            }
+        }
+    }
+    TEST_CASE("Ring line buffer writes a group larger than the ring") {
+        ring_line_buffer lb{2u,4u,8u};
+        std::vector<std::string> group;
+        for (int i=0;i<11;i++) group.push_back(std::to_string(i));
+        lb.write(std::begin(group),std::end(group));
+        lb.emit();
+        std::vector<std::string> lines;
+        for (const auto& segment : lb.sink().segments()) {
+            lines.insert(std::end(lines),std::begin(segment),std::end(segment));
+        }
+        REQUIRE(group==lines);
+    }
+    TEST_CASE("Destructor of ring line buffer writes all lines") {
+        auto recorder = std::make_shared<std::vector<std::string>>();
+        {
+            lbw::mpsc_ring_line_buffer<shared_recorder> lb{4u,4u,8u,shared_recorder{recorder}};
+            lb.write("line 1");
+            lb.write("line 2");
+        }
+        REQUIRE(std::vector<std::string>{"line 1","line 2"}==*recorder);
+    }
+    TEST_CASE("Ring line buffer consumer sleeps while a partial segment is pending") {
+        auto segments = std::make_shared<std::atomic<std::size_t>>(0);
+        lbw::mpsc_ring_line_buffer<segment_counter> lb{1000u,4096u,16u,segment_counter{segments}};
+        for (int i=0;i<1500;i++) lb.write(std::to_string(i));
+        while (*segments<1u) std::this_thread::yield();
+        auto wakeups = lb.wakeups();
+        std::this_thread::sleep_for(50ms);
+        REQUIRE(wakeups==lb.wakeups());
+        for (int i=1500;i<2000;i++) lb.write(std::to_string(i));
+        while (*segments<2u) std::this_thread::yield();
+        REQUIRE(lb.wakeups()>wakeups);
+    }
+}
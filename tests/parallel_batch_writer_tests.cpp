@@ -0,0 +1,128 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+
+    /// written_files collects the files written by recording_factory instances of all workers.
+    struct written_files {
+        std::mutex mutex;
+        std::map<std::string,std::string> files;
+        int active{};
+        int max_active{};
+    };
+
+    /// recording_factory records the files it writes in written_files. commit waits, so batches overlap when they are
+    /// written by multiple workers. Writing the line "fail" throws.
+    template <typename Tfile_name_generator>
+    class recording_factory {
+        written_files* written_;
+        std::chrono::milliseconds delay_;
+        Tfile_name_generator file_name_generator_;
+        std::string file_name_;
+        std::string contents_;
+    public:
+        template <typename ...Args>
+        recording_factory(written_files* written, std::chrono::milliseconds delay, Args&&... args) : written_{written}, delay_{delay}, file_name_generator_{std::forward<Args>(args)...} {}
+
+        void begin() {
+            file_name_ = file_name_generator_.generate();
+            contents_.clear();
+            std::scoped_lock lock{written_->mutex};
+            written_->max_active = std::max(written_->max_active,++written_->active);
+        }
+
+        template<typename Tline>
+        void write(Tline &&line) {
+            if (std::string_view{line}=="fail") throw std::runtime_error{"factory failed"};
+            contents_ += std::string{line}+"\n";
+        }
+
+        void commit() {
+            std::this_thread::sleep_for(delay_);
+            std::scoped_lock lock{written_->mutex};
+            written_->files[file_name_] = contents_;
+            written_->active--;
+        }
+    };
+
+    using testable_parallel_writer = lbw::parallel_batch_stream_writer<recording_factory<lbw::file_name_reference>>;
+
+}
+
+TEST_SUITE("Parallel batch writer tests") {
+    TEST_CASE("Parallel batch writer names batches in the order they are written") {
+        written_files written;
+        {
+            testable_parallel_writer writer{lbw::parallel_options{4,2},lbw::file_name_generator<>{"test-%NUM:2%"},&written,0ms};
+            REQUIRE(4==writer.workers());
+            for (int i=0;i<20;i++) {
+                std::vector<std::string> batch{"batch"+std::to_string(i),"line"};
+                writer.write(std::begin(batch),std::end(batch));
+            }
+            writer.flush();
+            std::scoped_lock lock{written.mutex};
+            REQUIRE(20==std::size(written.files));
+        }
+        for (int i=0;i<20;i++) {
+            auto name = std::string{i<10 ? "test-0" : "test-"}+std::to_string(i);
+            REQUIRE("batch"+std::to_string(i)+"\nline\n"==written.files[name]);
+        }
+    }
+    TEST_CASE("Parallel batch writer writes batches concurrently") {
+        written_files written;
+        {
+            testable_parallel_writer writer{lbw::parallel_options{4,0},lbw::file_name_generator<>{"test-%NUM%"},&written,20ms};
+            for (int i=0;i<8;i++) {
+                std::vector<std::string> batch{"line"};
+                writer.write(std::begin(batch),std::end(batch));
+            }
+        }
+        REQUIRE(8==std::size(written.files));
+        REQUIRE(written.max_active>1);
+    }
+    TEST_CASE("Parallel batch writer can be used with line_buffer_ts") {
+        written_files written;
+        {
+            lbw::line_buffer_ts<testable_parallel_writer,lbw::line_arena> lb{2u,lbw::parallel_options{2,0},lbw::file_name_generator<>{"test-%NUM%"},&written,0ms};
+            lb.write("test1");
+            lb.write("test2");
+            lb.write("test3");
+        }
+        REQUIRE("test1\ntest2\n"==written.files["test-0"]);
+        REQUIRE("test3\n"==written.files["test-1"]);
+    }
+    TEST_CASE("Parallel batch writer rethrows an exception of a factory from the next flush or write") {
+        written_files written;
+        {
+            testable_parallel_writer writer{lbw::parallel_options{2,0},lbw::file_name_generator<>{"test-%NUM%"},&written,0ms};
+            std::vector<std::string> failing{"fail"};
+            std::vector<std::string> batch{"line"};
+            writer.write(std::begin(failing),std::end(failing));
+            REQUIRE_THROWS_AS(writer.flush(),std::runtime_error);
+            writer.write(std::begin(batch),std::end(batch));
+            writer.flush();
+            writer.write(std::begin(failing),std::end(failing));
+            std::size_t written_batches{};
+            auto write_until_thrown = [&writer,&batch,&written_batches]{
+                for (;;) {
+                    writer.write(std::begin(batch),std::end(batch));
+                    written_batches++;
+                }
+            };
+            REQUIRE_THROWS_AS(write_until_thrown(),std::runtime_error);
+            writer.flush();
+            std::scoped_lock lock{written.mutex};
+            REQUIRE(1+written_batches==std::size(written.files));
+            REQUIRE("line\n"==written.files["test-1"]);
+            REQUIRE(0==written.files.count("test-0"));
+        }
+    }
+}
@@ -0,0 +1,122 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+
+#ifdef LINE_BASED_WRITERS_HAS_POSIX_IO
+
+#include "temp_dir.h"
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+    /// write_files writes count files with one line each, test-0000.txt holding "test0".
+    template <typename Tfactory>
+    std::vector<std::string> write_files(temp_dir& dir, Tfactory& factory, std::size_t count) {
+        std::vector<std::string> files;
+        for (std::size_t i=0;i<count;i++) {
+            files.push_back(dir.file("test-000"+std::to_string(i)+".txt"));
+            factory.begin();
+            factory.write("test"+std::to_string(i));
+            factory.commit();
+        }
+        return files;
+    }
+}
+
+TEST_SUITE("Retention manager tests") {
+    TEST_CASE("Retention manager deletes the oldest files when there are too many files") {
+        temp_dir dir;
+        lbw::retention_manager retention{lbw::retention_limits{0,3}};
+        lbw::retained_factory<lbw::fd_file_factory> factory{retention,dir.path()+"/test-%NUM:4%.txt"};
+        auto files = write_files(dir,factory,5);
+        retention.wait();
+        REQUIRE_FALSE(file_exists(files[0]));
+        REQUIRE_FALSE(file_exists(files[1]));
+        REQUIRE("test2\n"==read_file(files[2]));
+        REQUIRE("test4\n"==read_file(files[4]));
+        auto metrics = retention.metrics();
+        REQUIRE(3==metrics.files);
+        REQUIRE(18==metrics.bytes);
+        REQUIRE(2==metrics.deleted_files);
+        REQUIRE(12==metrics.deleted_bytes);
+        REQUIRE(0==metrics.failed_deletes);
+    }
+    TEST_CASE("Retention manager deletes the oldest files when the files are too large") {
+        temp_dir dir;
+        lbw::retention_manager retention{lbw::retention_limits{13,0}};
+        lbw::retained_factory<lbw::fd_file_factory> factory{retention,dir.path()+"/test-%NUM:4%.txt"};
+        auto files = write_files(dir,factory,4);
+        retention.wait();
+        REQUIRE_FALSE(file_exists(files[1]));
+        REQUIRE(file_exists(files[2]));
+        REQUIRE(file_exists(files[3]));
+        REQUIRE(12==retention.metrics().bytes);
+    }
+    TEST_CASE("Retention manager never deletes the newest file") {
+        temp_dir dir;
+        lbw::retention_manager retention{lbw::retention_limits{1,0}};
+        lbw::retained_factory<lbw::fd_file_factory> factory{retention,dir.path()+"/test-%NUM:4%.txt"};
+        auto files = write_files(dir,factory,2);
+        retention.wait();
+        REQUIRE_FALSE(file_exists(files[0]));
+        REQUIRE(file_exists(files[1]));
+        REQUIRE(1==retention.metrics().files);
+    }
+    TEST_CASE("Retention manager stops tracking files that were removed by others") {
+        temp_dir dir;
+        lbw::retention_manager retention{lbw::retention_limits{0,2}};
+        lbw::retained_factory<lbw::fd_file_factory> factory{retention,dir.path()+"/test-%NUM:4%.txt"};
+        auto files = write_files(dir,factory,2);
+        retention.wait();
+        std::remove(files[0].c_str());
+        files.push_back(dir.file("test-0002.txt"));
+        factory.begin();
+        factory.write("test2");
+        factory.commit();
+        retention.wait();
+        auto metrics = retention.metrics();
+        REQUIRE(2==metrics.files);
+        REQUIRE(0==metrics.deleted_files);
+        REQUIRE(0==metrics.failed_deletes);
+        REQUIRE(file_exists(files[1]));
+    }
+    TEST_CASE("Retention manager updates the size of a file that is added again") {
+        temp_dir dir;
+        auto file = dir.file("test-0000.txt");
+        lbw::retention_manager retention{lbw::retention_limits{}};
+        lbw::retained_factory<lbw::rotating_file_stream_factory> factory{retention,lbw::file_rotation{},dir.path()+"/test-%NUM:4%.txt"};
+        for (int i=0;i<2;i++) {
+            factory.begin();
+            factory.write("test1");
+            factory.commit();
+        }
+        retention.wait();
+        auto metrics = retention.metrics();
+        REQUIRE(1==metrics.files);
+        REQUIRE(12==metrics.bytes);
+    }
+    TEST_CASE("Retained writer keeps the newest segments") {
+        temp_dir dir;
+        std::vector<std::string> files;
+        for (int i=0;i<6;i++) {
+            files.push_back(dir.file("test-000"+std::to_string(i)+".txt"));
+        }
+        lbw::retention_manager retention{lbw::retention_limits{0,2}};
+        {
+            lbw::segmented_line_based_file_writer_retained_ts writer{2u,retention,dir.path()+"/test-%NUM:4%.txt"};
+            for (int i=0;i<9;i++) {
+                writer.write("test"+std::to_string(i));
+            }
+        }
+        retention.wait();
+        REQUIRE_FALSE(file_exists(files[0]));
+        REQUIRE_FALSE(file_exists(files[3]));
+        REQUIRE("test8\n"==read_file(files[4]));
+        REQUIRE(file_exists(files[5]));
+        auto metrics = retention.metrics();
+        REQUIRE(2==metrics.files);
+        REQUIRE(4==metrics.deleted_files);
+    }
+}
+
+#endif
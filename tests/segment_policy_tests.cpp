@@ -0,0 +1,80 @@
+#include "doctest.h"
+#include "line_based_writers/segment_policy.h"
+#include <string>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+    std::chrono::steady_clock::time_point fake_steady_time{};
+
+    std::chrono::steady_clock::time_point fake_steady_now() {
+        return fake_steady_time;
+    }
+}
+
+TEST_SUITE("Segment policy tests") {
+    TEST_CASE("Line count policy is full after max lines") {
+        lbw::line_count_policy p{2};
+        p.add("line 1");
+        REQUIRE_FALSE(p.full());
+        p.add("line 2"s);
+        REQUIRE(p.full());
+        SUBCASE("Reset starts counting again") {
+            p.reset();
+            REQUIRE_FALSE(p.full());
+        }
+    }
+    TEST_CASE("Line count policy of 0 is never full") {
+        lbw::line_count_policy p{0};
+        p.add("line 1");
+        REQUIRE_FALSE(p.full());
+    }
+    TEST_CASE("Byte size policy counts bytes including line separator") {
+        lbw::byte_size_policy p{10};
+        p.add("1234");
+        REQUIRE_FALSE(p.full());
+        p.add("123"sv);
+        REQUIRE_FALSE(p.full());
+        p.add(""s);
+        REQUIRE(p.full());
+        SUBCASE("Reset starts counting again") {
+            p.reset();
+            REQUIRE_FALSE(p.full());
+        }
+    }
+    TEST_CASE("Line count or byte size policy is full when either limit is reached") {
+        SUBCASE("Line count is reached first") {
+            lbw::line_count_or_byte_size_policy p{2,100};
+            p.add("a");
+            REQUIRE_FALSE(p.full());
+            p.add("b");
+            REQUIRE(p.full());
+        }
+        SUBCASE("Byte size is reached first") {
+            lbw::line_count_or_byte_size_policy p{100,10};
+            p.add("123456789");
+            REQUIRE(p.full());
+            p.reset();
+            REQUIRE_FALSE(p.full());
+        }
+    }
+    TEST_CASE("Max age policy is full when oldest line reaches max age") {
+        fake_steady_time = std::chrono::steady_clock::time_point{10s};
+        lbw::max_age_policy<fake_steady_now> p{5s};
+        REQUIRE_FALSE(p.full());
+        p.add("line 1");
+        fake_steady_time += 3s;
+        p.add("line 2");
+        REQUIRE_FALSE(p.full());
+        fake_steady_time += 2s;
+        REQUIRE(p.full());
+        SUBCASE("Reset waits for the next line") {
+            p.reset();
+            fake_steady_time += 10s;
+            REQUIRE_FALSE(p.full());
+            p.add("line 3");
+            REQUIRE_FALSE(p.full());
+        }
+    }
+}
@@ -0,0 +1,206 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+#include <sstream>
+#include <map>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+    std::chrono::steady_clock::time_point fake_steady_time{};
+
+    std::chrono::steady_clock::time_point fake_steady_now() {
+        return fake_steady_time;
+    }
+
+    /// The errno value failing_stream fails to open with, or 0.
+    int open_error{};
+    /// The files written by failing_stream.
+    std::map<std::string,std::string> files;
+
+    /// failing_stream fails to open with open_error, and stores the written files in files when they are closed.
+    struct failing_stream : public std::stringstream {
+        std::string file_name;
+
+        void open(const std::string& name, ios_base::openmode) {
+            str("");
+            file_name = name;
+            if (open_error!=0) {
+                errno = open_error;
+                setstate(std::ios::failbit);
+            }
+        }
+
+        void close() {
+            if (*this && !file_name.empty()) {
+                files[file_name] = str();
+            }
+            file_name.clear();
+        }
+    };
+
+    void reset() {
+        fake_steady_time = std::chrono::steady_clock::time_point{};
+        open_error = 0;
+        files.clear();
+    }
+
+    using fake_spill = lbw::memory_spill_template<fake_steady_now>;
+    using spilling_factory = lbw::file_stream_factory_template<lbw::file_name_generator<>,failing_stream,lbw::publish_in_place,fake_spill>;
+
+    /// write_batch writes one batch of lines with factory.
+    template <typename Tfactory>
+    void write_batch(Tfactory& factory, std::initializer_list<std::string_view> lines) {
+        factory.begin();
+        for (auto line : lines) {
+            factory.write(line);
+        }
+        factory.commit();
+    }
+}
+
+TEST_SUITE("Spill policy tests") {
+    TEST_CASE("File stream factory without spill policy reports the errno value of a failed open") {
+        reset();
+        lbw::file_stream_factory_no_stream<failing_stream> factory{"test-%NUM%"};
+        open_error = ENOSPC;
+        write_batch(factory,{"test1"});
+        REQUIRE(ENOSPC==factory.last_error());
+        REQUIRE(files.empty());
+    }
+    TEST_CASE("Spilling factory writes batches directly while writes succeed") {
+        reset();
+        spilling_factory factory{"test-%NUM%"};
+        write_batch(factory,{"test1","test2"});
+        write_batch(factory,{"test3"});
+        REQUIRE(std::map<std::string,std::string>{{"test-0","test1\ntest2\n"},{"test-1","test3\n"}}==files);
+        REQUIRE(0==factory.last_error());
+        REQUIRE(0==factory.spill().metrics().failures);
+    }
+    TEST_CASE("Spilling factory keeps failed batches and retries them in order after the backoff") {
+        reset();
+        std::vector<lbw::write_error> errors;
+        lbw::spill_options options;
+        options.on_error = [&errors](const lbw::write_error& error) { errors.push_back(error); };
+        spilling_factory factory{fake_spill{options},"test-%NUM%"};
+        open_error = ENOSPC;
+        write_batch(factory,{"test1"});
+        REQUIRE(ENOSPC==factory.last_error());
+        REQUIRE(1==std::size(errors));
+        REQUIRE(ENOSPC==errors[0].error);
+        REQUIRE("test-0"==errors[0].file_name);
+        REQUIRE(6==errors[0].bytes);
+        REQUIRE(1==errors[0].attempts);
+        REQUIRE(errors[0].spilled);
+        open_error = 0;
+        fake_steady_time += 50ms;
+        write_batch(factory,{"test2"});
+        REQUIRE(files.empty());
+        REQUIRE(2==std::size(errors));
+        REQUIRE(0==errors[1].attempts);
+        auto spilled = factory.spill().metrics();
+        REQUIRE(2==spilled.spilled_batches);
+        REQUIRE(12==spilled.spilled_bytes);
+        fake_steady_time += 50ms;
+        write_batch(factory,{"test3"});
+        REQUIRE(std::map<std::string,std::string>{{"test-0","test1\n"},{"test-1","test2\n"},{"test-2","test3\n"}}==files);
+        spilled = factory.spill().metrics();
+        REQUIRE(0==spilled.spilled_batches);
+        REQUIRE(0==spilled.spilled_bytes);
+        REQUIRE(2==spilled.recovered_batches);
+        REQUIRE(1==spilled.failures);
+    }
+    TEST_CASE("Spilling factory writes at most max_retry_batches spilled batches per commit") {
+        reset();
+        lbw::spill_options options;
+        options.max_retry_batches = 2;
+        spilling_factory factory{fake_spill{options},"test-%NUM%"};
+        open_error = ENOSPC;
+        for (auto line : {"test0"sv,"test1"sv,"test2"sv,"test3"sv}) {
+            write_batch(factory,{line});
+        }
+        open_error = 0;
+        fake_steady_time += 1s;
+        write_batch(factory,{"test4"});
+        REQUIRE(2==std::size(files));
+        REQUIRE(3==factory.spill().metrics().spilled_batches);
+        write_batch(factory,{"test5"});
+        REQUIRE(4==std::size(files));
+        REQUIRE(2==factory.spill().metrics().spilled_batches);
+        factory.retry();
+        REQUIRE(6==std::size(files));
+        REQUIRE(0==factory.spill().metrics().spilled_batches);
+        REQUIRE(6==factory.spill().metrics().recovered_batches);
+    }
+    TEST_CASE("Spilling factory doubles the backoff up to the maximum") {
+        reset();
+        lbw::spill_options options;
+        options.initial_backoff = 100ms;
+        options.max_backoff = 300ms;
+        spilling_factory factory{fake_spill{options},"test-%NUM%"};
+        open_error = EIO;
+        write_batch(factory,{"test1"});
+        auto retry_at = [&factory](std::chrono::milliseconds time) {
+            fake_steady_time = std::chrono::steady_clock::time_point{time};
+            factory.retry();
+            return factory.spill().metrics().failures;
+        };
+        REQUIRE(1==retry_at(99ms));
+        REQUIRE(2==retry_at(100ms));
+        REQUIRE(2==retry_at(299ms));
+        REQUIRE(3==retry_at(300ms));
+        REQUIRE(3==retry_at(599ms));
+        REQUIRE(4==retry_at(600ms));
+        open_error = 0;
+        REQUIRE(4==retry_at(900ms));
+        REQUIRE(1==std::size(files));
+    }
+    TEST_CASE("Spilling factory drops batches that do not fit in the spill buffer") {
+        reset();
+        std::vector<lbw::write_error> errors;
+        lbw::spill_options options;
+        options.max_bytes = 10;
+        options.on_error = [&errors](const lbw::write_error& error) { errors.push_back(error); };
+        spilling_factory factory{fake_spill{options},"test-%NUM%"};
+        open_error = ENOSPC;
+        write_batch(factory,{"test1"});
+        write_batch(factory,{"test2"});
+        REQUIRE(2==std::size(errors));
+        REQUIRE_FALSE(errors[1].spilled);
+        REQUIRE("test-1"==errors[1].file_name);
+        auto spilled = factory.spill().metrics();
+        REQUIRE(1==spilled.spilled_batches);
+        REQUIRE(1==spilled.dropped_batches);
+        REQUIRE(6==spilled.dropped_bytes);
+    }
+    TEST_CASE("Spilling factory writes the spilled batches when it is destroyed") {
+        reset();
+        {
+            spilling_factory factory{"test-%NUM%"};
+            open_error = ENOSPC;
+            write_batch(factory,{"test1"});
+            open_error = 0;
+        }
+        REQUIRE(std::map<std::string,std::string>{{"test-0","test1\n"}}==files);
+    }
+    TEST_CASE("Line buffer writes arena segments with a spilling factory") {
+        reset();
+        {
+            lbw::line_buffer<lbw::batch_stream_writer<spilling_factory>,lbw::line_arena> lb{2u,fake_spill{},"test-%NUM%"};
+            open_error = ENOSPC;
+            lb.write("test1");
+            lb.write("test2");
+            REQUIRE(files.empty());
+            open_error = 0;
+            fake_steady_time += 1s;
+            lb.write("test3");
+            lb.write("test4");
+        }
+        REQUIRE("test1\ntest2\n"==files["test-0"]);
+        REQUIRE("test3\ntest4\n"==files["test-1"]);
+    }
+    TEST_CASE("No spill is disabled") {
+        REQUIRE_FALSE(lbw::no_spill::enabled);
+        REQUIRE(lbw::memory_spill::enabled);
+    }
+}
@@ -0,0 +1,46 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+#include <set>
+#include <thread>
+#include <atomic>
+
+namespace lbw = crosscode::line_based_writers;
+
+TEST_SUITE("Thread index tests") {
+    TEST_CASE("thread_indices hands out the lowest released index first") {
+        lbw::thread_indices indices;
+        REQUIRE(0u==indices.acquire());
+        REQUIRE(1u==indices.acquire());
+        REQUIRE(2u==indices.acquire());
+        indices.release(1);
+        indices.release(0);
+        REQUIRE(0u==indices.acquire());
+        REQUIRE(1u==indices.acquire());
+        REQUIRE(3u==indices.acquire());
+    }
+    TEST_CASE("thread_index is stable for a thread") {
+        REQUIRE(lbw::thread_index()==lbw::thread_index());
+    }
+    TEST_CASE("thread_index reuses the index of an exited thread") {
+        std::size_t first{};
+        std::size_t second{};
+        std::thread{[&first]{ first = lbw::thread_index(); }}.join();
+        std::thread{[&second]{ second = lbw::thread_index(); }}.join();
+        REQUIRE(first==second);
+    }
+    TEST_CASE("thread_index gives live threads different indices") {
+        constexpr std::size_t thread_count = 4;
+        std::atomic<std::size_t> started{0};
+        std::vector<std::size_t> indices(thread_count);
+        std::vector<std::thread> threads;
+        for (std::size_t i=0;i<thread_count;i++) {
+            threads.emplace_back([&started,&indices,i]{
+                indices[i] = lbw::thread_index();
+                started++;
+                while (started<thread_count) std::this_thread::yield();
+            });
+        }
+        for (auto& t : threads) t.join();
+        REQUIRE(thread_count==std::set<std::size_t>(std::begin(indices),std::end(indices)).size());
+    }
+}
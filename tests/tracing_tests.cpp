@@ -0,0 +1,137 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+#include <array>
+#include <mutex>
+#include <thread>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+
+    /// null_factory discards the lines.
+    class null_factory {
+    public:
+        void begin() {}
+
+        template<typename Tline>
+        void write(Tline &&) {}
+
+        void commit() {}
+    };
+
+    /// stages returns the stages of spans.
+    std::vector<lbw::trace_stage> stages(const std::vector<lbw::trace_span>& spans) {
+        std::vector<lbw::trace_stage> result;
+        for (const auto& span : spans) {
+            result.push_back(span.stage);
+        }
+        return result;
+    }
+
+    using traced_line_buffer = lbw::line_buffer<lbw::batch_stream_writer<null_factory,lbw::ring_tracer>,lbw::line_arena,lbw::line_count_policy,lbw::ring_tracer>;
+    using traced_line_buffer_ts = lbw::line_buffer_ts<lbw::batch_stream_writer<null_factory,lbw::ring_tracer>,lbw::line_arena,lbw::line_count_policy,lbw::ring_tracer>;
+}
+
+TEST_SUITE("Tracing tests") {
+    TEST_CASE("Line buffer traces the buffer and factory stages of a segment") {
+        std::vector<lbw::trace_span> spans;
+        {
+            traced_line_buffer lb{2u};
+            lb.write("test1");
+            lb.write("test2");
+            spans = lb.tracer().spans();
+        }
+        REQUIRE(std::vector{lbw::trace_stage::buffer,lbw::trace_stage::begin,lbw::trace_stage::write,lbw::trace_stage::commit}==stages(spans));
+        for (const auto& span : spans) {
+            REQUIRE(2==span.lines);
+            REQUIRE(span.duration>=0ns);
+        }
+        REQUIRE(spans[1].start>=spans[0].start+spans[0].duration);
+        REQUIRE(spans[2].start==spans[1].start+spans[1].duration);
+        REQUIRE(spans[3].start==spans[2].start+spans[2].duration);
+    }
+    TEST_CASE("Thread safe line buffer traces the wait for the mutex") {
+        traced_line_buffer_ts lb{1000u};
+        std::array<std::string,3> group{"test1","test2","test3"};
+        lb.write("test0");
+        lb.write(group);
+        auto spans = lb.tracer().spans();
+        REQUIRE(std::vector{lbw::trace_stage::lock_wait,lbw::trace_stage::lock_wait}==stages(spans));
+        REQUIRE(1==spans[0].lines);
+        REQUIRE(3==spans[1].lines);
+    }
+    TEST_CASE("Replacing the tracer of a line buffer replaces the tracer of the sink") {
+        traced_line_buffer_ts lb{2u};
+        auto initial = lb.tracer();
+        lbw::ring_tracer replacement{lbw::ring_options{16,{}}};
+        lb.tracer(replacement);
+        lb.write("test1");
+        lb.write("test2");
+        REQUIRE(initial.spans().empty());
+        REQUIRE(6==std::size(replacement.spans()));
+    }
+    TEST_CASE("Callback tracer passes spans to the callback") {
+        std::mutex mutex;
+        std::vector<lbw::trace_span> spans;
+        {
+            lbw::line_buffer_ts<lbw::batch_stream_writer<null_factory,lbw::callback_tracer>,lbw::line_arena,lbw::line_count_policy,lbw::callback_tracer> lb{2u};
+            lb.tracer().callback([&](const lbw::trace_span& span) {
+                std::scoped_lock lock{mutex};
+                spans.push_back(span);
+            });
+            lb.write("test1");
+            lb.write("test2");
+            std::scoped_lock lock{mutex};
+            REQUIRE(std::vector{lbw::trace_stage::lock_wait,lbw::trace_stage::lock_wait,lbw::trace_stage::buffer,lbw::trace_stage::begin,lbw::trace_stage::write,lbw::trace_stage::commit}==stages(spans));
+        }
+    }
+    TEST_CASE("Ring tracer keeps the most recent spans") {
+        lbw::ring_tracer tracer{lbw::ring_options{4,{}}};
+        for (std::size_t i=0;i<10;i++) {
+            tracer.record(lbw::trace_span{lbw::trace_stage::write,{},std::chrono::nanoseconds{i},i});
+        }
+        auto spans = tracer.spans();
+        REQUIRE(4==std::size(spans));
+        for (std::size_t i=0;i<4;i++) {
+            REQUIRE(6+i==spans[i].lines);
+            REQUIRE(std::chrono::nanoseconds{6+i}==spans[i].duration);
+        }
+        REQUIRE(0==tracer.dropped());
+    }
+    TEST_CASE("Ring tracer skips spans shorter than the minimum duration") {
+        lbw::ring_tracer tracer{lbw::ring_options{16,1ms}};
+        tracer.record(lbw::trace_span{lbw::trace_stage::lock_wait,{},10us,1});
+        tracer.record(lbw::trace_span{lbw::trace_stage::lock_wait,{},2ms,1});
+        auto spans = tracer.spans();
+        REQUIRE(1==std::size(spans));
+        REQUIRE(2ms==spans[0].duration);
+    }
+    TEST_CASE("Ring tracer can be written by multiple threads while it is read") {
+        lbw::ring_tracer tracer{lbw::ring_options{64,{}}};
+        std::vector<std::thread> threads;
+        for (std::size_t t=0;t<4;t++) {
+            threads.emplace_back([tracer,t]() mutable {
+                for (std::size_t i=0;i<10000;i++) {
+                    tracer.record(lbw::trace_span{lbw::trace_stage::write,{},std::chrono::nanoseconds{t},t});
+                }
+            });
+        }
+        for (int i=0;i<100;i++) {
+            for (const auto& span : tracer.spans()) {
+                REQUIRE(static_cast<std::size_t>(span.duration.count())==span.lines);
+            }
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        auto spans = tracer.spans();
+        REQUIRE_FALSE(spans.empty());
+        REQUIRE(std::size(spans)<=64);
+    }
+    TEST_CASE("Null tracer is disabled") {
+        REQUIRE_FALSE(lbw::null_tracer::enabled);
+        REQUIRE(lbw::ring_tracer::enabled);
+        REQUIRE(lbw::callback_tracer::enabled);
+    }
+}
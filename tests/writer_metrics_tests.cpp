@@ -0,0 +1,170 @@
+#include "doctest.h"
+#include "line_based_writers.h"
+#include <map>
+#include <thread>
+
+namespace lbw = crosscode::line_based_writers;
+using namespace std::literals;
+
+namespace {
+    std::chrono::steady_clock::time_point fake_steady_time{};
+
+    std::chrono::steady_clock::time_point fake_steady_now() {
+        return fake_steady_time;
+    }
+
+    /// slow_factory advances the fake clock in begin, write and commit.
+    class slow_factory {
+        std::string contents_;
+    public:
+        void begin() {
+            contents_.clear();
+            fake_steady_time += 1us;
+        }
+
+        template<typename Tline>
+        void write(Tline &&line) {
+            contents_ += std::string{line}+"\n";
+            fake_steady_time += 10ns;
+        }
+
+        void commit() {
+            fake_steady_time += 1ms;
+        }
+
+        const std::string& contents() const { return contents_; }
+    };
+
+    /// discarding_factory is a worker factory of parallel_batch_stream_writer that discards the lines.
+    class discarding_factory {
+    public:
+        explicit discarding_factory(const std::string*) {}
+
+        void begin() {}
+
+        template<typename Tline>
+        void write(Tline &&) {}
+
+        void commit() {}
+    };
+
+    using fake_metrics = lbw::writer_metrics_template<fake_steady_now>;
+}
+
+TEST_SUITE("Writer metrics tests") {
+    TEST_CASE("Latency histogram counts latencies in log2 buckets") {
+        lbw::latency_histogram h;
+        h.add(0ns);
+        h.add(1ns);
+        h.add(3ns);
+        h.add(1000ns);
+        h.add(100h);
+        auto s = h.snapshot();
+        REQUIRE(5==s.count);
+        REQUIRE(1==s.buckets[0]);
+        REQUIRE(1==s.buckets[1]);
+        REQUIRE(1==s.buckets[2]);
+        REQUIRE(1==s.buckets[10]);
+        REQUIRE(1==s.buckets[lbw::histogram_snapshot::bucket_count-1]);
+        REQUIRE(std::chrono::nanoseconds{100h}==s.max);
+        REQUIRE(std::chrono::nanoseconds{100h}+1004ns==s.sum);
+    }
+    TEST_CASE("Histogram snapshot returns the bucket bound of a quantile") {
+        lbw::latency_histogram h;
+        for (int i=0;i<99;i++) {
+            h.add(100ns);
+        }
+        h.add(5ms);
+        auto s = h.snapshot();
+        REQUIRE(128ns==s.quantile(0.5));
+        REQUIRE(128ns==s.quantile(0.98));
+        REQUIRE(5ms==s.quantile(1.0));
+        REQUIRE(0ns==lbw::histogram_snapshot{}.quantile(0.5));
+    }
+    TEST_CASE("Writer metrics record segments written by batch_stream_writer") {
+        fake_steady_time = std::chrono::steady_clock::time_point{};
+        lbw::batch_stream_writer<slow_factory,fake_metrics> writer;
+        std::vector<std::string> lines{"test1","test22"};
+        writer.write(std::begin(lines),std::end(lines));
+        writer.write(std::begin(lines),std::begin(lines)+1);
+        REQUIRE("test1\n"==writer.factory().contents());
+        auto s = writer.metrics().snapshot();
+        REQUIRE(2==s.segments);
+        REQUIRE(3==s.lines);
+        REQUIRE(19==s.bytes);
+        REQUIRE(0==s.segments_in_progress);
+        REQUIRE(2==s.begin_latency.count);
+        REQUIRE(1us==s.begin_latency.max);
+        REQUIRE(30ns==s.write_latency.sum);
+        REQUIRE(20ns==s.write_latency.max);
+        REQUIRE(2ms==s.commit_latency.sum);
+        REQUIRE(1ms+1us+20ns==s.segment_latency.max);
+    }
+    TEST_CASE("Writer metrics count the bytes of a line arena segment") {
+        fake_steady_time = std::chrono::steady_clock::time_point{};
+        {
+            lbw::line_buffer<lbw::batch_stream_writer<slow_factory,fake_metrics>,lbw::line_arena> lb{2u};
+            lb.write("test1");
+            lb.write("test22");
+            auto s = lb.sink().metrics().snapshot();
+            REQUIRE(1==s.segments);
+            REQUIRE(2==s.lines);
+            REQUIRE(13==s.bytes);
+        }
+    }
+    TEST_CASE("Writer metrics sum the metrics of all threads") {
+        lbw::writer_metrics metrics{4};
+        std::vector<std::thread> threads;
+        for (int t=0;t<8;t++) {
+            threads.emplace_back([&metrics]{
+                for (int i=0;i<1000;i++) {
+                    metrics.begin_segment();
+                    metrics.end_segment(lbw::segment_sample{{},2,10,1ns,2ns,3ns});
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        auto s = metrics.snapshot();
+        REQUIRE(8000==s.segments);
+        REQUIRE(16000==s.lines);
+        REQUIRE(80000==s.bytes);
+        REQUIRE(0==s.segments_in_progress);
+        REQUIRE(8000==s.segment_latency.count);
+        REQUIRE(6ns==s.segment_latency.max);
+    }
+    TEST_CASE("Metrics snapshot visits counters, gauges and histogram fields") {
+        lbw::writer_metrics metrics{1};
+        metrics.begin_segment();
+        metrics.end_segment(lbw::segment_sample{{},2,10,1ns,2ns,3ns});
+        metrics.begin_segment();
+        std::map<std::string,std::uint64_t> fields;
+        metrics.snapshot().visit([&fields](std::string_view name, std::uint64_t value) {
+            fields[std::string{name}] = value;
+        });
+        REQUIRE(24==std::size(fields));
+        REQUIRE(1==fields["segments"]);
+        REQUIRE(2==fields["lines"]);
+        REQUIRE(10==fields["bytes"]);
+        REQUIRE(1==fields["segments_in_progress"]);
+        REQUIRE(1==fields["commit_count"]);
+        REQUIRE(3==fields["commit_max_ns"]);
+        REQUIRE(6==fields["segment_p99_ns"]);
+    }
+    TEST_CASE("Parallel batch writer records the batches of all workers") {
+        lbw::parallel_batch_stream_writer<discarding_factory,lbw::file_name_generator<>,lbw::writer_metrics> writer{lbw::parallel_options{4,0},lbw::file_name_generator<>{"test-%NUM%"}};
+        for (int i=0;i<20;i++) {
+            std::vector<std::string> batch{"line"};
+            writer.write(std::begin(batch),std::end(batch));
+        }
+        writer.flush();
+        auto s = writer.metrics().snapshot();
+        REQUIRE(20==s.segments);
+        REQUIRE(100==s.bytes);
+    }
+    TEST_CASE("Null metrics are disabled") {
+        REQUIRE_FALSE(lbw::null_metrics::enabled);
+        REQUIRE(lbw::writer_metrics::enabled);
+    }
+}